@@ -31,6 +31,38 @@ public abstract class Machine {
 
   public static native void dumpHeap(String outputFile);
 
+  /**
+   * Writes the allocation profile gathered so far to the specified
+   * file in the "collapsed stack" format accepted by flame graph
+   * tools.  Each line holds the semicolon-separated frames of a
+   * sampled stack trace, outermost first, followed by the class
+   * allocated and the estimated number of bytes allocated there.
+   *
+   * Sampling is enabled by setting the
+   * avian.allocation.sampleInterval system property to the average
+   * number of bytes to allocate between samples.
+   *
+   * @throws IllegalStateException if sampling is not enabled
+   */
+  public static native void dumpAllocationProfile(String outputFile);
+
+  /**
+   * Returns the number of garbage collections performed so far.
+   */
+  public static native long gcCount();
+
+  /**
+   * Returns the longest pause, in microseconds, among the specified
+   * percentage of the shortest garbage collections performed so far,
+   * e.g. gcPauseTime(50) for the median and gcPauseTime(100) for the
+   * maximum.  Pauses are kept in a histogram whose buckets grow with
+   * pause length, so results other than the maximum are rounded up
+   * by at most an eighth.
+   *
+   * @param percentile a number from 0 to 100
+   */
+  public static native long gcPauseTime(int percentile);
+
   public static Unsafe getUnsafe() {
     return unsafe;
   }
@@ -23,6 +23,13 @@ public class VMClass {
   public byte[] sourceFile;
   public VMClass super_;
   public Object[] interfaceTable;
+  /**
+   * Implementations of the methods of the interfaces implemented by
+   * this class, indexed by a hash of their names and descriptors (see
+   * interfaceMethodTableIndex in machine.h).  Slots claimed by more
+   * than one distinct method are left empty.
+   */
+  public VMMethod[] interfaceMethodTable;
   public VMMethod[] virtualTable;
   public VMField[] fieldTable;
   /**
@@ -39,4 +46,11 @@ public class VMClass {
   public Singleton staticTable;
   public ClassLoader loader;
   public byte[] source;
+  /**
+   * This class and its superclasses, starting with java.lang.Object,
+   * so that each class's depth in the hierarchy is its index here.
+   * Null for interfaces, arrays, primitive types, and classes whose
+   * superclass had not been loaded when they were.
+   */
+  public VMClass[] primarySupers;
 }
@@ -23,7 +23,7 @@ public final class Byte extends Number implements Comparable<Byte> {
   }
 
   public static Byte valueOf(byte value) {
-    return new Byte(value);
+    return Cache.values[value + 128];
   }
 
   public boolean equals(Object o) {
@@ -77,4 +77,14 @@ public final class Byte extends Number implements Comparable<Byte> {
   public double doubleValue() {
     return (double) value;
   }
+
+  private static class Cache {
+    public static final Byte[] values = new Byte[256];
+
+    static {
+      for (int i = 0; i < values.length; ++i) {
+        values[i] = new Byte((byte) (i - 128));
+      }
+    }
+  }
 }
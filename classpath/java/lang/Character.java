@@ -23,6 +23,9 @@ public final class Character implements Comparable<Character> {
   }
 
   public static Character valueOf(char value) {
+    if (value <= 127) {
+      return Cache.values[value];
+    }
     return new Character(value);
   }
 
@@ -255,4 +258,14 @@ public final class Character implements Comparable<Character> {
     }
     return count;
   }
+
+  private static class Cache {
+    public static final Character[] values = new Character[128];
+
+    static {
+      for (int i = 0; i < values.length; ++i) {
+        values[i] = new Character((char) i);
+      }
+    }
+  }
 }
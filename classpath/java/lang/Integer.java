@@ -27,6 +27,9 @@ public final class Integer extends Number implements Comparable<Integer> {
   }
 
   public static Integer valueOf(int value) {
+    if (value >= -128 && value <= 127) {
+      return Cache.values[value + 128];
+    }
     return new Integer(value);
   }
 
@@ -139,4 +142,18 @@ public final class Integer extends Number implements Comparable<Integer> {
     }
     return new Integer(parseInt(string, 10));
   }
+
+  // Boxing conversions must yield identical objects for small
+  // values, and caching them also keeps autoboxing in loops from
+  // allocating.  The cache lives in its own class so that it is only
+  // populated once somebody asks for it.
+  private static class Cache {
+    public static final Integer[] values = new Integer[256];
+
+    static {
+      for (int i = 0; i < values.length; ++i) {
+        values[i] = new Integer(i - 128);
+      }
+    }
+  }
 }
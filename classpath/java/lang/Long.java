@@ -31,6 +31,9 @@ public final class Long extends Number implements Comparable<Long> {
   }
 
   public static Long valueOf(long value) {
+    if (value >= -128 && value <= 127) {
+      return Cache.values[(int) value + 128];
+    }
     return new Long(value);
   }
 
@@ -171,4 +174,14 @@ public final class Long extends Number implements Comparable<Long> {
 
     return number;
   }
+
+  private static class Cache {
+    public static final Long[] values = new Long[256];
+
+    static {
+      for (int i = 0; i < values.length; ++i) {
+        values[i] = new Long(i - 128);
+      }
+    }
+  }
 }
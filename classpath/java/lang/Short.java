@@ -23,6 +23,9 @@ public final class Short extends Number implements Comparable<Short> {
   }
 
   public static Short valueOf(short value) {
+    if (value >= -128 && value <= 127) {
+      return Cache.values[value + 128];
+    }
     return new Short(value);
   }
 
@@ -73,4 +76,14 @@ public final class Short extends Number implements Comparable<Short> {
   public double doubleValue() {
     return (double) value;
   }
+
+  private static class Cache {
+    public static final Short[] values = new Short[256];
+
+    static {
+      for (int i = 0; i < values.length; ++i) {
+        values[i] = new Short((short) (i - 128));
+      }
+    }
+  }
 }
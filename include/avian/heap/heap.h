@@ -47,6 +47,15 @@ class Heap : public avian::util::Allocator {
     virtual unsigned copiedSizeInWords(void*) = 0;
     virtual void copy(void*, void*) = 0;
     virtual void walk(void*, Walker*) = 0;
+
+    // used when compacting gen2: updateRoots must visit the same
+    // roots visitRoots did, including those visited after calling
+    // Heap::postVisit (they are updated once it returns), and move
+    // must move an object of the specified size to a lower, possibly
+    // overlapping address without consulting its class, which may
+    // already have been moved:
+    virtual void updateRoots(Visitor*) = 0;
+    virtual void move(void* src, void* dst, unsigned sizeInWords) = 0;
   };
 
   virtual void setClient(Client* client) = 0;
@@ -65,6 +74,8 @@ class Heap : public avian::util::Allocator {
                                       unsigned sizeInWords,
                                       bool objectMask) = 0;
   virtual void mark(void* p, unsigned offset, unsigned count) = 0;
+  // reserves space for an extra word in the next copy of the
+  // specified object; may be called concurrently by mutator threads:
   virtual void pad(void* p) = 0;
   virtual void* follow(void* p) = 0;
 
@@ -77,11 +88,35 @@ class Heap : public avian::util::Allocator {
   virtual void postVisit() = 0;
   virtual Status status(void* p) = 0;
   virtual CollectionType collectionType() = 0;
+
+  // appends a line of JSON describing each subsequent collection to
+  // the specified file:
+  virtual void setLog(const char* path) = 0;
+
+  // after each collection, the heap returns memory to the OS which it
+  // has not needed for at least the specified delay (in
+  // milliseconds), keeping enough to leave the specified percentage
+  // of each space free:
+  virtual void setUncommitPolicy(unsigned delay, unsigned minFreeRatio) = 0;
+
+  // returns the number of collections so far, and the longest pause
+  // (in microseconds, to within an eighth) among the specified
+  // percentage of the shortest of them, so pauseTime(100) is the
+  // longest pause of all, measured exactly:
+  virtual unsigned collectionCount() = 0;
+  virtual int64_t pauseTime(unsigned percentile) = 0;
   virtual void disposeFixies() = 0;
   virtual void dispose() = 0;
 };
 
-Heap* makeHeap(System* system, unsigned limit);
+// if collectorThreads is greater than one, collections are done in
+// parallel using that many threads, including the one which requests
+// the collection.  If compact is true, major collections compact gen2
+// in place where possible instead of copying it to a new segment:
+Heap* makeHeap(System* system,
+               unsigned limit,
+               unsigned collectorThreads = 1,
+               bool compact = false);
 
 }  // namespace vm
 
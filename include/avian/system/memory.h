@@ -39,6 +39,11 @@ class Memory {
   // Free a contiguous range of pages.
   static void free(util::Slice<uint8_t> pages);
 
+  // Return the physical memory backing a contiguous range of pages to
+  // the OS, leaving the range mapped.  The contents of the pages are
+  // undefined afterward.
+  static void decommit(util::Slice<uint8_t> pages);
+
   // TODO: In the future:
   // static void setPermissions(util::Slice<uint8_t> pages, Permissions perms);
 };
@@ -0,0 +1,437 @@
+/* Copyright (c) 2008-2015, Avian Contributors
+
+   Permission to use, copy, modify, and/or distribute this software
+   for any purpose with or without fee is hereby granted, provided
+   that the above copyright notice and this permission notice appear
+   in all copies.
+
+   There is NO WARRANTY for this software.  See license.txt for
+   details. */
+
+#include <math.h>
+
+#include "avian/machine.h"
+
+#include <avian/util/runtime-array.h>
+
+using namespace vm;
+
+namespace vm {
+
+// The allocation profile records a stack trace for, on average, one
+// allocation in every AllocationProfile::interval bytes.  Sampling is
+// driven by a per-thread countdown which is decremented by each
+// allocation and reset to an exponentially-distributed random value
+// after each sample, so that every byte allocated is equally likely
+// to be sampled regardless of allocation pattern.
+//
+// We can't tell the class of an object at the time it's allocated,
+// since the caller sets it afterward, so each thread keeps its latest
+// sample pending until its next sample, the next collection, or the
+// next profile dump, whichever comes first.  The trace, on the other
+// hand, is captured immediately and interned as a sequence of frame
+// names so that it need not be updated by the garbage collector.
+
+class AllocationName {
+ public:
+  AllocationName(AllocationName* next, uint32_t hash, unsigned length)
+      : next(next), hash(hash), length(length)
+  {
+  }
+
+  char* value()
+  {
+    return reinterpret_cast<char*>(this + 1);
+  }
+
+  AllocationName* next;
+  uint32_t hash;
+  unsigned length;
+};
+
+class AllocationStack {
+ public:
+  AllocationStack(AllocationStack* next, uint32_t hash, unsigned depth)
+      : next(next), hash(hash), depth(depth)
+  {
+  }
+
+  // frames, innermost first
+  AllocationName** frames()
+  {
+    return reinterpret_cast<AllocationName**>(this + 1);
+  }
+
+  AllocationStack* next;
+  uint32_t hash;
+  unsigned depth;
+};
+
+class AllocationSample {
+ public:
+  AllocationSample(AllocationSample* next,
+                   AllocationStack* stack,
+                   AllocationName* class_)
+      : next(next), stack(stack), class_(class_), count(0), bytes(0)
+  {
+  }
+
+  AllocationSample* next;
+  AllocationStack* stack;
+  AllocationName* class_;
+  uint64_t count;
+  uint64_t bytes;
+};
+
+class AllocationProfile {
+ public:
+  static const unsigned MaxDepth = 64;
+  static const unsigned BucketCount = 4096;
+
+  AllocationProfile(System* system, Alloc* allocator, unsigned interval)
+      : system(system),
+        allocator(allocator),
+        interval(interval),
+        seed(0x2545F491)
+  {
+    memset(names, 0, sizeof(names));
+    memset(stacks, 0, sizeof(stacks));
+    memset(samples, 0, sizeof(samples));
+
+    if (not system->success(system->make(&lock))) {
+      system->abort();
+    }
+  }
+
+  void dispose()
+  {
+    for (unsigned i = 0; i < BucketCount; ++i) {
+      for (AllocationName* n = names[i]; n;) {
+        AllocationName* next = n->next;
+        allocator->free(n, sizeof(AllocationName) + n->length + 1);
+        n = next;
+      }
+
+      for (AllocationStack* s = stacks[i]; s;) {
+        AllocationStack* next = s->next;
+        allocator->free(
+            s, sizeof(AllocationStack) + (s->depth * sizeof(AllocationName*)));
+        s = next;
+      }
+
+      for (AllocationSample* s = samples[i]; s;) {
+        AllocationSample* next = s->next;
+        allocator->free(s, sizeof(AllocationSample));
+        s = next;
+      }
+    }
+
+    lock->dispose();
+
+    allocator->free(this, sizeof(*this));
+  }
+
+  System* system;
+  Alloc* allocator;
+  System::Monitor* lock;
+  unsigned interval;
+  uint32_t seed;
+  AllocationName* names[BucketCount];
+  AllocationStack* stacks[BucketCount];
+  AllocationSample* samples[BucketCount];
+};
+
+}  // namespace vm
+
+namespace {
+
+namespace local {
+
+uint32_t hash(uint32_t h, const void* p, unsigned length)
+{
+  const uint8_t* s = static_cast<const uint8_t*>(p);
+  for (unsigned i = 0; i < length; ++i) {
+    h = (h * 31) + s[i];
+  }
+  return h;
+}
+
+uint32_t hash(uint32_t h, const void* p)
+{
+  return hash(h, &p, sizeof(p));
+}
+
+AllocationName* internName(AllocationProfile* p,
+                           const char* value,
+                           unsigned length)
+{
+  uint32_t h = hash(0, value, length);
+  AllocationName** bucket
+      = p->names + (h & (AllocationProfile::BucketCount - 1));
+
+  for (AllocationName* n = *bucket; n; n = n->next) {
+    if (n->hash == h and n->length == length
+        and memcmp(n->value(), value, length) == 0) {
+      return n;
+    }
+  }
+
+  AllocationName* n = new (p->allocator->allocate(sizeof(AllocationName)
+                                                  + length + 1))
+      AllocationName(*bucket, h, length);
+  memcpy(n->value(), value, length);
+  n->value()[length] = 0;
+  *bucket = n;
+  return n;
+}
+
+AllocationName* frameName(Thread* t,
+                          AllocationProfile* p,
+                          GcMethod* method,
+                          int ip)
+{
+  GcByteArray* className = method->class_()->name();
+  GcByteArray* methodName = method->name();
+  int line = t->m->processor->lineNumber(t, method, ip);
+
+  unsigned capacity = className->length() + methodName->length() + 16;
+  THREAD_RUNTIME_ARRAY(t, char, buffer, capacity);
+
+  int length;
+  if (line >= 0) {
+    length = snprintf(RUNTIME_ARRAY_BODY(buffer),
+                      capacity,
+                      "%s.%s:%d",
+                      className->body().begin(),
+                      methodName->body().begin(),
+                      line);
+  } else {
+    length = snprintf(RUNTIME_ARRAY_BODY(buffer),
+                      capacity,
+                      "%s.%s",
+                      className->body().begin(),
+                      methodName->body().begin());
+  }
+
+  return internName(p, RUNTIME_ARRAY_BODY(buffer), length);
+}
+
+AllocationStack* internStack(AllocationProfile* p,
+                             AllocationName** frames,
+                             unsigned depth)
+{
+  uint32_t h = hash(depth, frames, depth * sizeof(AllocationName*));
+  AllocationStack** bucket
+      = p->stacks + (h & (AllocationProfile::BucketCount - 1));
+
+  for (AllocationStack* s = *bucket; s; s = s->next) {
+    if (s->hash == h and s->depth == depth
+        and memcmp(s->frames(), frames, depth * sizeof(AllocationName*))
+            == 0) {
+      return s;
+    }
+  }
+
+  AllocationStack* s = new (p->allocator->allocate(
+      sizeof(AllocationStack) + (depth * sizeof(AllocationName*))))
+      AllocationStack(*bucket, h, depth);
+  memcpy(s->frames(), frames, depth * sizeof(AllocationName*));
+  *bucket = s;
+  return s;
+}
+
+AllocationSample* findSample(AllocationProfile* p,
+                             AllocationStack* stack,
+                             AllocationName* class_)
+{
+  uint32_t h = hash(hash(0, stack), class_);
+  AllocationSample** bucket
+      = p->samples + (h & (AllocationProfile::BucketCount - 1));
+
+  for (AllocationSample* s = *bucket; s; s = s->next) {
+    if (s->stack == stack and s->class_ == class_) {
+      return s;
+    }
+  }
+
+  *bucket = new (p->allocator->allocate(sizeof(AllocationSample)))
+      AllocationSample(*bucket, stack, class_);
+  return *bucket;
+}
+
+uint32_t nextSeed(uint32_t seed)
+{
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  return seed;
+}
+
+// returns the number of bytes until the next sample, chosen from an
+// exponential distribution whose mean is the sampling interval
+int sampleCountdown(uint32_t seed, unsigned interval)
+{
+  double u = (static_cast<double>(seed) + 1) / 4294967296.0;
+  double countdown = -::log(u) * interval;
+  return countdown < INT32_MAX ? static_cast<int>(countdown) : INT32_MAX;
+}
+
+int nextSampleCountdown(AllocationProfile* p)
+{
+  p->seed = nextSeed(p->seed);
+  return sampleCountdown(p->seed, p->interval);
+}
+
+void resolveSample(Thread* t, Thread* o)
+{
+  AllocationProfile* p = t->m->allocationProfile;
+
+  if (o->sampledStack) {
+    GcClass* class_ = objectClass(t, o->sampledObject);
+
+    ACQUIRE_RAW(t, p->lock);
+
+    AllocationName* name;
+    if (class_) {
+      name = internName(p,
+                        reinterpret_cast<const char*>(
+                            class_->name()->body().begin()),
+                        class_->name()->length() - 1);
+    } else {
+      name = internName(p, "?", 1);
+    }
+
+    // weight each sample by the number of bytes it represents, given
+    // that larger objects are more likely to be sampled:
+    double size = o->sampledSize;
+    AllocationSample* s = findSample(p, o->sampledStack, name);
+    ++s->count;
+    s->bytes += static_cast<uint64_t>(
+        size / (1 - ::exp(-size / p->interval)));
+
+    o->sampledObject = 0;
+    o->sampledStack = 0;
+  }
+}
+
+void resolveSamples(Thread* t, Thread* o)
+{
+  resolveSample(t, o);
+
+  for (Thread* c = o->child; c; c = c->peer) {
+    resolveSamples(t, c);
+  }
+}
+
+}  // namespace local
+
+}  // namespace
+
+namespace vm {
+
+AllocationProfile* makeAllocationProfile(System* system,
+                                         Alloc* allocator,
+                                         unsigned interval)
+{
+  return new (allocator->allocate(sizeof(AllocationProfile)))
+      AllocationProfile(system, allocator, interval);
+}
+
+void disposeAllocationProfile(AllocationProfile* p)
+{
+  p->dispose();
+}
+
+int initialSampleCountdown(AllocationProfile* p, void* thread)
+{
+  // new threads may be created without p->lock held, so rather than
+  // advance the shared seed we mix the thread's address into it
+  uint32_t seed = (p->seed ^ static_cast<uint32_t>(
+                                 reinterpret_cast<uintptr_t>(thread)))
+                  * 2654435761u;
+  return local::sampleCountdown(local::nextSeed(seed ? seed : 1),
+                                p->interval);
+}
+
+void sampleAllocation(Thread* t, object o, unsigned sizeInBytes)
+{
+  t->allocationSampleCountdown -= sizeInBytes;
+
+  if (LIKELY(t->allocationSampleCountdown > 0)
+      or (t->getFlags() & (Thread::TracingFlag | Thread::UseBackupHeapFlag))) {
+    return;
+  }
+
+  local::resolveSample(t, t);
+
+  class Visitor : public Processor::StackVisitor {
+   public:
+    Visitor() : depth(0)
+    {
+    }
+
+    virtual bool visit(Processor::StackWalker* walker)
+    {
+      methods[depth] = walker->method();
+      ips[depth] = walker->ip();
+      return ++depth < AllocationProfile::MaxDepth;
+    }
+
+    GcMethod* methods[AllocationProfile::MaxDepth];
+    int ips[AllocationProfile::MaxDepth];
+    unsigned depth;
+  } v;
+
+  t->m->processor->walkStack(t, &v);
+
+  AllocationProfile* p = t->m->allocationProfile;
+
+  ACQUIRE_RAW(t, p->lock);
+
+  AllocationName* frames[AllocationProfile::MaxDepth];
+  for (unsigned i = 0; i < v.depth; ++i) {
+    frames[i] = local::frameName(t, p, v.methods[i], v.ips[i]);
+  }
+
+  t->sampledObject = o;
+  t->sampledStack = local::internStack(p, frames, v.depth);
+  t->sampledSize = sizeInBytes;
+  t->allocationSampleCountdown = local::nextSampleCountdown(p);
+}
+
+void resolveAllocationSamples(Thread* t)
+{
+  if (t->m->allocationProfile) {
+    local::resolveSamples(t, t->m->rootThread);
+  }
+}
+
+void dumpAllocationProfile(Thread* t, FILE* out)
+{
+  AllocationProfile* p = t->m->allocationProfile;
+
+  resolveAllocationSamples(t);
+
+  ACQUIRE_RAW(t, p->lock);
+
+  // write one line per distinct trace and class in the "collapsed
+  // stack" format used by flame graph tools, outermost frame first
+  // and with the allocated class as the leaf, followed by the
+  // estimated number of bytes allocated there:
+  for (unsigned i = 0; i < AllocationProfile::BucketCount; ++i) {
+    for (AllocationSample* s = p->samples[i]; s; s = s->next) {
+      for (unsigned j = s->stack->depth; j > 0; --j) {
+        fprintf(out, "%s;", s->stack->frames()[j - 1]->value());
+      }
+
+      fprintf(out,
+              "%s %llu\n",
+              s->class_->value(),
+              static_cast<unsigned long long>(s->bytes));
+    }
+  }
+
+  fflush(out);
+}
+
+}  // namespace vm
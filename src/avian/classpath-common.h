@@ -53,7 +53,7 @@ object getTrace(Thread* t, unsigned skipCount)
   t->m->processor->walkStack(t, &v);
 
   if (v.trace == 0)
-    v.trace = makeObjectArray(t, 0);
+    v.trace = makeRawTrace(t, 0, 0);
 
   return v.trace;
 }
@@ -250,11 +250,12 @@ System::Library* loadLibrary(Thread* t,
   return lib;
 }
 
-GcStackTraceElement* makeStackTraceElement(Thread* t, GcTraceElement* e)
+GcStackTraceElement* makeStackTraceElement(Thread* t,
+                                           GcRawTrace* trace,
+                                           unsigned index)
 {
-  PROTECT(t, e);
-
-  GcMethod* method = cast<GcMethod>(t, e->method());
+  GcMethod* method = cast<GcMethod>(t, trace->method()[index]);
+  int ip = trace->ip()->body()[index];
   PROTECT(t, method);
 
   GcByteArray* class_name = method->class_()->name();
@@ -275,7 +276,7 @@ GcStackTraceElement* makeStackTraceElement(Thread* t, GcTraceElement* e)
       t, method_name, 0, method_name->length() - 1);
   PROTECT(t, method_name_string);
 
-  unsigned line = t->m->processor->lineNumber(t, method, e->ip());
+  unsigned line = t->m->processor->lineNumber(t, method, ip);
 
   GcByteArray* file = method->class_()->sourceFile();
   GcString* file_string
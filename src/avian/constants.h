@@ -221,6 +221,21 @@ enum OpCode {
   wide = 0xc4
 };
 
+// Opcodes which never appear in class files, but which the interpreter
+// substitutes for instructions it has resolved (see interpret.cpp).
+enum QuickOpCode {
+  getfield_quick_int = 0xcb,
+  getfield_quick_long = 0xcc,
+  getfield_quick_object = 0xcd,
+  putfield_quick_int = 0xce,
+  putfield_quick_long = 0xcf,
+  putfield_quick_object = 0xd0,
+  getstatic_quick_int = 0xd1,
+  getstatic_quick_long = 0xd2,
+  getstatic_quick_object = 0xd3,
+  invokevirtual_quick = 0xd4
+};
+
 enum TypeCode {
   T_BOOLEAN = 4,
   T_CHAR = 5,
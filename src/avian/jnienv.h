@@ -21,6 +21,12 @@
 #define CLASSPATH_PROPERTY "java.class.path"
 #define JAVA_HOME_PROPERTY "java.home"
 #define REENTRANT_PROPERTY "avian.reentrant"
+#define GC_THREADS_PROPERTY "avian.gc.threads"
+#define GC_COMPACT_PROPERTY "avian.gc.compact"
+#define GC_LOG_PROPERTY "avian.gc.log"
+#define GC_UNCOMMIT_DELAY_PROPERTY "avian.gc.uncommitDelay"
+#define GC_MIN_FREE_RATIO_PROPERTY "avian.gc.minFreeRatio"
+#define ALLOCATION_SAMPLE_INTERVAL_PROPERTY "avian.allocation.sampleInterval"
 #define BOOTCLASSPATH_PREPEND_OPTION "bootclasspath/p"
 #define BOOTCLASSPATH_OPTION "bootclasspath"
 #define BOOTCLASSPATH_APPEND_OPTION "bootclasspath/a"
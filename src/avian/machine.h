@@ -146,10 +146,36 @@ const unsigned ThreadBackupHeapSizeInBytes = 2 * 1024;
 const unsigned ThreadBackupHeapSizeInWords = ThreadBackupHeapSizeInBytes
                                              / BytesPerWord;
 
-const unsigned ThreadHeapPoolSize = 64;
+// thread-local heaps beyond the first are sized according to each
+// thread's allocation rate, aiming for about this many refills per
+// collection, within the following bounds:
+const unsigned ThreadHeapRefillsPerCollection = 8;
 
-const unsigned FixedFootprintThresholdInBytes = ThreadHeapPoolSize
-                                                * ThreadHeapSizeInBytes;
+const unsigned MaxThreadHeapSizeInBytes = 1024 * 1024;
+const unsigned MaxThreadHeapSizeInWords = MaxThreadHeapSizeInBytes
+                                          / BytesPerWord;
+
+// each thread-local heap allocated from the pool starts with a
+// header holding the next heap in the pool and its size in bytes:
+const unsigned ThreadHeapHeaderSizeInWords = 2;
+
+// the number of bytes which may be allocated in thread-local heaps
+// (or, separately, as fixed objects) before we force a minor
+// collection is the heap limit divided by YoungFootprintDivisor,
+// within the following bounds:
+const unsigned YoungFootprintDivisor = 8;
+
+const unsigned MinYoungFootprintInBytes = 64 * ThreadHeapSizeInBytes;
+
+const unsigned MaxYoungFootprintInBytes = 64 * MaxThreadHeapSizeInBytes;
+
+// number of recently used object monitors each thread remembers so
+// it can avoid searching the monitor map (must be a power of two):
+const unsigned MonitorCacheSize = 8;
+
+// number of slots in each class's interface method table (must be a
+// power of two):
+const unsigned InterfaceMethodTableSize = 32;
 
 // number of zombie threads which may accumulate before we force a GC
 // to clean them up:
@@ -1008,6 +1034,8 @@ class GcJreference;
 class GcArray;
 class GcThrowable;
 class GcRoots;
+class AllocationProfile;
+class AllocationStack;
 
 class Machine {
  public:
@@ -1057,10 +1085,11 @@ class Machine {
   unsigned liveCount;
   unsigned daemonCount;
   unsigned fixedFootprint;
+  unsigned internedSinceSweep;
+  unsigned youngFootprintLimit;
   unsigned stackSizeInBytes;
   System::Local* localThread;
   System::Monitor* stateLock;
-  System::Monitor* heapLock;
   System::Monitor* classLock;
   System::Monitor* referenceLock;
   System::Monitor* shutdownLock;
@@ -1081,9 +1110,10 @@ class Machine {
   bool alive;
   JavaVMVTable javaVMVTable;
   JNIEnvVTable jniEnvVTable;
-  uintptr_t* heapPool[ThreadHeapPoolSize];
-  unsigned heapPoolIndex;
+  uintptr_t* heapPool;
+  unsigned heapPoolFootprint;
   size_t bootimageSize;
+  AllocationProfile* allocationProfile;
 };
 
 void printTrace(Thread* t, GcThrowable* exception);
@@ -1117,6 +1147,7 @@ extern "C" uint64_t vmRun(uint64_t (*function)(Thread*, uintptr_t*),
 extern "C" void vmRun_returnAddress();
 
 class GcThread;
+class GcMonitor;
 class GcThrowable;
 class GcString;
 
@@ -1350,6 +1381,8 @@ class Thread {
   GcThrowable* exception;
   unsigned heapIndex;
   unsigned heapOffset;
+  unsigned heapLimit;
+  unsigned heapRefillSize;
   Protector* protector;
   ClassInitStack* classInitStack;
   LibraryLoadStack* libraryLoadStack;
@@ -1358,6 +1391,12 @@ class Thread {
   Runnable runnable;
   uintptr_t* defaultHeap;
   uintptr_t* heap;
+  object monitorCacheKeys[MonitorCacheSize];
+  GcMonitor* monitorCacheValues[MonitorCacheSize];
+  object sampledObject;
+  AllocationStack* sampledStack;
+  unsigned sampledSize;
+  int allocationSampleCountdown;
   uintptr_t backupHeap[ThreadBackupHeapSizeInWords];
   unsigned backupHeapIndex;
 
@@ -1617,7 +1656,7 @@ inline Aborter* getAborter(Thread* t)
 inline bool ensure(Thread* t, unsigned sizeInBytes)
 {
   if (t->heapIndex + ceilingDivide(sizeInBytes, BytesPerWord)
-      > ThreadHeapSizeInWords) {
+      > t->heapLimit) {
     if (sizeInBytes <= ThreadBackupHeapSizeInBytes) {
       expect(t, (t->getFlags() & Thread::UseBackupHeapFlag) == 0);
 
@@ -1640,14 +1679,21 @@ object allocate3(Thread* t,
                  unsigned sizeInBytes,
                  bool objectMask);
 
+void sampleAllocation(Thread* t, object o, unsigned sizeInBytes);
+
 inline object allocateSmall(Thread* t, unsigned sizeInBytes)
 {
   assertT(t,
           t->heapIndex + ceilingDivide(sizeInBytes, BytesPerWord)
-          <= ThreadHeapSizeInWords);
+          <= t->heapLimit);
 
   object o = reinterpret_cast<object>(t->heap + t->heapIndex);
   t->heapIndex += ceilingDivide(sizeInBytes, BytesPerWord);
+
+  if (UNLIKELY(t->m->allocationProfile)) {
+    sampleAllocation(t, o, sizeInBytes);
+  }
+
   return o;
 }
 
@@ -1656,7 +1702,7 @@ inline object allocate(Thread* t, unsigned sizeInBytes, bool objectMask)
   stress(t);
 
   if (UNLIKELY(t->heapIndex + ceilingDivide(sizeInBytes, BytesPerWord)
-               > ThreadHeapSizeInWords or t->m->exclusive)) {
+               > t->heapLimit or t->m->exclusive)) {
     return allocate2(t, sizeInBytes, objectMask);
   } else {
     assertT(t, t->criticalLevel == 0);
@@ -2148,8 +2194,10 @@ inline void markHashTaken(Thread* t, object o)
   assertT(t, not objectExtended(t, o));
   assertT(t, not objectFixed(t, o));
 
-  ACQUIRE_RAW(t, t->m->heapLock);
-
+  // no other thread modifies the mark bits of an object outside of a
+  // collection, so if we race with another thread hashing the same
+  // object, we'll both store the same value.  At worst, we'll both
+  // pad it, wasting a word of space until the next collection.
   alias(o, 0) |= HashTakenMark;
   t->m->heap->pad(o);
 }
@@ -2168,7 +2216,7 @@ inline uint32_t objectHash(Thread* t, object o)
   if (objectExtended(t, o)) {
     return extendedWord(t, o, baseSize(t, o, objectClass(t, o)));
   } else {
-    if (not objectFixed(t, o)) {
+    if (not (objectFixed(t, o) or hashTaken(t, o))) {
       markHashTaken(t, o);
     }
     return takeHash(t, o);
@@ -2567,6 +2615,22 @@ namespace vm {
 
 void dumpHeap(Thread* t, FILE* out);
 
+AllocationProfile* makeAllocationProfile(System* system,
+                                         Alloc* allocator,
+                                         unsigned interval);
+
+void disposeAllocationProfile(AllocationProfile* p);
+
+// returns the number of bytes a new thread may allocate before its
+// first allocation is sampled
+int initialSampleCountdown(AllocationProfile* p, void* thread);
+
+// record the classes of any objects sampled by sampleAllocation whose
+// classes were not yet known, which must be done before they move
+void resolveAllocationSamples(Thread* t);
+
+void dumpAllocationProfile(Thread* t, FILE* out);
+
 inline void NO_RETURN throw_(Thread* t, GcThrowable* e)
 {
   assertT(t, t->exception == 0);
@@ -2692,6 +2756,30 @@ inline GcMethod* findVirtualMethod(Thread* t, GcMethod* method, GcClass* class_)
       t, cast<GcArray>(t, class_->virtualTable())->body()[method->offset()]);
 }
 
+// returns the interface method table slot for the specified method.
+// Implementations share a selector (name and descriptor) with the
+// interface methods they implement, so we hash only the selector,
+// and only a few bytes of it, to keep this cheap enough to do on
+// every interface call.
+inline unsigned interfaceMethodTableIndex(Thread* t UNUSED, GcMethod* method)
+{
+  GcByteArray* name = method->name();
+  GcByteArray* spec = method->spec();
+
+  // both lengths include the null terminator
+  unsigned nameLength = name->length() - 1;
+  unsigned specLength = spec->length() - 1;
+
+  uint32_t h = (nameLength * 31) + specLength;
+  h = (h * 31) + name->body()[0];
+  h = (h * 31) + name->body()[nameLength / 2];
+  h = (h * 31) + name->body()[nameLength - 1];
+  h = (h * 31) + spec->body()[specLength / 2];
+  h ^= h >> 11;
+
+  return h & (InterfaceMethodTableSize - 1);
+}
+
 inline GcMethod* findInterfaceMethod(Thread* t,
                                      GcMethod* method,
                                      GcClass* class_)
@@ -2703,6 +2791,21 @@ inline GcMethod* findInterfaceMethod(Thread* t,
     resolveSystemClass(t, roots(t)->bootLoader(), class_->name());
   }
 
+  // try the interface method table first, falling back to searching
+  // the interface table if the slot is empty (e.g. because several
+  // selectors hash to it) or holds some other method.  Names and
+  // descriptors are usually interned, so methodEqual rarely needs to
+  // compare their contents:
+  GcArray* imt = cast<GcArray>(t, class_->interfaceMethodTable());
+  if (LIKELY(imt)) {
+    GcMethod* m = cast<GcMethod>(
+        t, imt->body()[interfaceMethodTableIndex(t, method)]);
+
+    if (LIKELY(m and methodEqual(t, m, method))) {
+      return m;
+    }
+  }
+
   GcClass* interface = method->class_();
   GcArray* itable = cast<GcArray>(t, class_->interfaceTable());
   for (unsigned i = 0; i < itable->length(); i += 2) {
@@ -3084,7 +3187,31 @@ class ObjectMonitorResource {
   Thread::SingleProtector protector;
 };
 
-GcMonitor* objectMonitor(Thread* t, object o, bool createNew);
+GcMonitor* objectMonitor2(Thread* t, object o, bool createNew);
+
+inline unsigned monitorCacheIndex(object o)
+{
+  return (reinterpret_cast<uintptr_t>(o) / BytesPerWord)
+         & (MonitorCacheSize - 1);
+}
+
+inline void clearMonitorCache(Thread* t)
+{
+  memset(t->monitorCacheKeys, 0, sizeof(t->monitorCacheKeys));
+}
+
+// entries in the monitor cache are only valid until the next
+// collection, since objects may move, die, or be replaced at the same
+// address; see postCollect.
+inline GcMonitor* objectMonitor(Thread* t, object o, bool createNew)
+{
+  unsigned index = monitorCacheIndex(o);
+  if (t->monitorCacheKeys[index] == o) {
+    return t->monitorCacheValues[index];
+  } else {
+    return objectMonitor2(t, o, createNew);
+  }
+}
 
 inline void acquire(Thread* t, object o)
 {
@@ -3623,7 +3750,8 @@ inline GcClassRuntimeData* getClassRuntimeData(Thread* t, GcClass* c)
     ACQUIRE(t, t->m->classLock);
 
     if (c->runtimeDataIndex() == 0) {
-      GcClassRuntimeData* runtimeData = makeClassRuntimeData(t, 0, 0, 0, 0);
+      GcClassRuntimeData* runtimeData
+          = makeClassRuntimeData(t, 0, 0, 0, 0, 0, 0);
 
       {
         GcVector* v
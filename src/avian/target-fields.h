@@ -15,44 +15,50 @@
 #if (TARGET_BYTES_PER_WORD == 8)
 
 #define TARGET_THREAD_EXCEPTION 80
-#define TARGET_THREAD_EXCEPTIONSTACKADJUSTMENT 2264
-#define TARGET_THREAD_EXCEPTIONOFFSET 2272
-#define TARGET_THREAD_EXCEPTIONHANDLER 2280
+#define TARGET_THREAD_HEAPINDEX 88
+#define TARGET_THREAD_HEAPLIMIT 96
+#define TARGET_THREAD_HEAP 168
+#define TARGET_THREAD_EXCEPTIONSTACKADJUSTMENT 2424
+#define TARGET_THREAD_EXCEPTIONOFFSET 2432
+#define TARGET_THREAD_EXCEPTIONHANDLER 2440
 
-#define TARGET_THREAD_IP 2224
-#define TARGET_THREAD_STACK 2232
-#define TARGET_THREAD_NEWSTACK 2240
-#define TARGET_THREAD_SCRATCH 2248
-#define TARGET_THREAD_CONTINUATION 2256
-#define TARGET_THREAD_TAILADDRESS 2288
-#define TARGET_THREAD_VIRTUALCALLTARGET 2296
-#define TARGET_THREAD_VIRTUALCALLINDEX 2304
-#define TARGET_THREAD_HEAPIMAGE 2312
-#define TARGET_THREAD_CODEIMAGE 2320
-#define TARGET_THREAD_THUNKTABLE 2328
-#define TARGET_THREAD_DYNAMICTABLE 2336
-#define TARGET_THREAD_STACKLIMIT 2384
+#define TARGET_THREAD_IP 2384
+#define TARGET_THREAD_STACK 2392
+#define TARGET_THREAD_NEWSTACK 2400
+#define TARGET_THREAD_SCRATCH 2408
+#define TARGET_THREAD_CONTINUATION 2416
+#define TARGET_THREAD_TAILADDRESS 2448
+#define TARGET_THREAD_VIRTUALCALLTARGET 2456
+#define TARGET_THREAD_VIRTUALCALLINDEX 2464
+#define TARGET_THREAD_HEAPIMAGE 2472
+#define TARGET_THREAD_CODEIMAGE 2480
+#define TARGET_THREAD_THUNKTABLE 2488
+#define TARGET_THREAD_DYNAMICTABLE 2496
+#define TARGET_THREAD_STACKLIMIT 2544
 
 #elif(TARGET_BYTES_PER_WORD == 4)
 
 #define TARGET_THREAD_EXCEPTION 44
-#define TARGET_THREAD_EXCEPTIONSTACKADJUSTMENT 2168
-#define TARGET_THREAD_EXCEPTIONOFFSET 2172
-#define TARGET_THREAD_EXCEPTIONHANDLER 2176
+#define TARGET_THREAD_HEAPINDEX 48
+#define TARGET_THREAD_HEAPLIMIT 56
+#define TARGET_THREAD_HEAP 96
+#define TARGET_THREAD_EXCEPTIONSTACKADJUSTMENT 2256
+#define TARGET_THREAD_EXCEPTIONOFFSET 2260
+#define TARGET_THREAD_EXCEPTIONHANDLER 2264
 
-#define TARGET_THREAD_IP 2148
-#define TARGET_THREAD_STACK 2152
-#define TARGET_THREAD_NEWSTACK 2156
-#define TARGET_THREAD_SCRATCH 2160
-#define TARGET_THREAD_CONTINUATION 2164
-#define TARGET_THREAD_TAILADDRESS 2180
-#define TARGET_THREAD_VIRTUALCALLTARGET 2184
-#define TARGET_THREAD_VIRTUALCALLINDEX 2188
-#define TARGET_THREAD_HEAPIMAGE 2192
-#define TARGET_THREAD_CODEIMAGE 2196
-#define TARGET_THREAD_THUNKTABLE 2200
-#define TARGET_THREAD_DYNAMICTABLE 2204
-#define TARGET_THREAD_STACKLIMIT 2228
+#define TARGET_THREAD_IP 2236
+#define TARGET_THREAD_STACK 2240
+#define TARGET_THREAD_NEWSTACK 2244
+#define TARGET_THREAD_SCRATCH 2248
+#define TARGET_THREAD_CONTINUATION 2252
+#define TARGET_THREAD_TAILADDRESS 2268
+#define TARGET_THREAD_VIRTUALCALLTARGET 2272
+#define TARGET_THREAD_VIRTUALCALLINDEX 2276
+#define TARGET_THREAD_HEAPIMAGE 2280
+#define TARGET_THREAD_CODEIMAGE 2284
+#define TARGET_THREAD_THUNKTABLE 2288
+#define TARGET_THREAD_DYNAMICTABLE 2292
+#define TARGET_THREAD_STACKLIMIT 2316
 
 #else
 #error
@@ -102,10 +102,19 @@ typedef int64_t target_intptr_t;
 
 const unsigned TargetClassFixedSize = 12;
 const unsigned TargetClassArrayElementSize = 14;
-const unsigned TargetClassVtable = 136;
+const unsigned TargetClassInterfaceMethodTable = 72;
+const unsigned TargetClassPrimarySupers = 136;
+const unsigned TargetClassVtable = 152;
 
 const unsigned TargetFieldOffset = 12;
 
+const unsigned TargetInlineCacheReceiver = 24;
+const unsigned TargetInlineCacheState = 40;
+
+const unsigned TargetMethodOffset = 14;
+const unsigned TargetMethodName = 24;
+const unsigned TargetMethodSpec = 32;
+
 #elif(TARGET_BYTES_PER_WORD == 4)
 
 template <class T>
@@ -119,10 +128,19 @@ typedef int32_t target_intptr_t;
 
 const unsigned TargetClassFixedSize = 8;
 const unsigned TargetClassArrayElementSize = 10;
-const unsigned TargetClassVtable = 72;
+const unsigned TargetClassInterfaceMethodTable = 40;
+const unsigned TargetClassPrimarySupers = 68;
+const unsigned TargetClassVtable = 80;
 
 const unsigned TargetFieldOffset = 8;
 
+const unsigned TargetInlineCacheReceiver = 12;
+const unsigned TargetInlineCacheState = 20;
+
+const unsigned TargetMethodOffset = 10;
+const unsigned TargetMethodName = 20;
+const unsigned TargetMethodSpec = 24;
+
 #else
 #error
 #endif
@@ -82,6 +82,13 @@ object hashMapRemove(Thread* t,
                      uint32_t (*hash)(Thread*, object),
                      bool (*equal)(Thread*, object, object));
 
+// remove all entries from the specified weak hash map whose keys have
+// been cleared by the garbage collector.  This never allocates, so
+// it is safe to call immediately after a collection; if it leaves
+// the table less than a third full, the next hashMapInsert shrinks
+// it to fit the remaining entries.
+void hashMapSweep(Thread* t, GcHashMap* map);
+
 object hashMapIterator(Thread* t, GcHashMap* map);
 
 object hashMapIteratorNext(Thread* t, object it);
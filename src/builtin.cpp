@@ -337,6 +337,58 @@ extern "C" AVIAN_EXPORT void JNICALL
   }
 }
 
+extern "C" AVIAN_EXPORT void JNICALL
+    Avian_avian_Machine_dumpAllocationProfile(Thread* t,
+                                              object,
+                                              uintptr_t* arguments)
+{
+  if (t->m->allocationProfile == 0) {
+    throwNew(t,
+             GcIllegalStateException::Type,
+             "allocation sampling is not enabled");
+  }
+
+  GcString* outputFile
+      = static_cast<GcString*>(reinterpret_cast<object>(*arguments));
+
+  unsigned length = outputFile->length(t);
+  THREAD_RUNTIME_ARRAY(t, char, n, length + 1);
+  stringChars(t, outputFile, RUNTIME_ARRAY_BODY(n));
+  FILE* out = vm::fopen(RUNTIME_ARRAY_BODY(n), "wb");
+  if (out) {
+    {
+      ENTER(t, Thread::ExclusiveState);
+      dumpAllocationProfile(t, out);
+    }
+    fclose(out);
+  } else {
+    throwNew(t,
+             GcRuntimeException::Type,
+             "file not found: %s",
+             RUNTIME_ARRAY_BODY(n));
+  }
+}
+
+extern "C" AVIAN_EXPORT int64_t JNICALL
+    Avian_avian_Machine_gcCount(Thread* t, object, uintptr_t*)
+{
+  return t->m->heap->collectionCount();
+}
+
+extern "C" AVIAN_EXPORT int64_t JNICALL
+    Avian_avian_Machine_gcPauseTime(Thread* t, object, uintptr_t* arguments)
+{
+  int percentile = arguments[0];
+  if (percentile < 0 or percentile > 100) {
+    throwNew(t,
+             GcIllegalArgumentException::Type,
+             "percentile out of range: %d",
+             percentile);
+  }
+
+  return t->m->heap->pauseTime(percentile);
+}
+
 extern "C" AVIAN_EXPORT int64_t JNICALL
     Avian_avian_Machine_tryNative(Thread* t, object, uintptr_t* arguments)
 {
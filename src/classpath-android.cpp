@@ -108,19 +108,19 @@ int64_t JNICALL mapData(Thread*, object, uintptr_t*);
 
 void JNICALL closeMemoryMappedFile(Thread*, GcMethod*, uintptr_t*);
 
-object translateStackTrace(Thread* t, object raw)
+object translateStackTrace(Thread* t, object o)
 {
+  GcRawTrace* raw = cast<GcRawTrace>(t, o);
   PROTECT(t, raw);
 
   object array = makeObjectArray(
       t,
       resolveClass(t, roots(t)->bootLoader(), "java/lang/StackTraceElement"),
-      objectArrayLength(t, raw));
+      raw->length());
   PROTECT(t, array);
 
   for (unsigned i = 0; i < objectArrayLength(t, array); ++i) {
-    GcStackTraceElement* e = makeStackTraceElement(
-        t, cast<GcTraceElement>(t, objectArrayBody(t, raw, i)));
+    GcStackTraceElement* e = makeStackTraceElement(t, raw, i);
 
     setField(t, array, ArrayBody + (i * BytesPerWord), e);
   }
@@ -1517,7 +1517,9 @@ extern "C" AVIAN_EXPORT int64_t JNICALL
                                             object,
                                             uintptr_t* arguments)
 {
-  return objectHash(t, reinterpret_cast<object>(arguments[0]));
+  object o = reinterpret_cast<object>(arguments[0]);
+
+  return o ? objectHash(t, o) : 0;
 }
 
 extern "C" AVIAN_EXPORT int64_t JNICALL
@@ -459,7 +459,7 @@ extern "C" AVIAN_EXPORT int64_t JNICALL
   if (LIKELY(o)) {
     return objectHash(t, o);
   } else {
-    throwNew(t, GcNullPointerException::Type);
+    return 0;
   }
 }
 
@@ -521,17 +521,16 @@ extern "C" AVIAN_EXPORT int64_t JNICALL
                                            object,
                                            uintptr_t* arguments)
 {
-  object trace = reinterpret_cast<object>(*arguments);
+  GcRawTrace* trace = cast<GcRawTrace>(t, reinterpret_cast<object>(*arguments));
   PROTECT(t, trace);
 
-  unsigned length = objectArrayLength(t, trace);
+  unsigned length = trace->length();
   GcClass* elementType = type(t, GcStackTraceElement::Type);
   object array = makeObjectArray(t, elementType, length);
   PROTECT(t, array);
 
   for (unsigned i = 0; i < length; ++i) {
-    GcStackTraceElement* ste = makeStackTraceElement(
-        t, cast<GcTraceElement>(t, objectArrayBody(t, trace, i)));
+    GcStackTraceElement* ste = makeStackTraceElement(t, trace, i);
     reinterpret_cast<GcArray*>(array)->setBodyElement(t, i, ste);
   }
 
@@ -3573,7 +3573,8 @@ extern "C" AVIAN_EXPORT jint JNICALL
 {
   ENTER(t, Thread::ActiveState);
 
-  return objectArrayLength(t, cast<GcThrowable>(t, *throwable)->trace());
+  return cast<GcRawTrace>(t, cast<GcThrowable>(t, *throwable)->trace())
+      ->length();
 }
 
 uint64_t jvmGetStackTraceElement(Thread* t, uintptr_t* arguments)
@@ -3585,10 +3586,8 @@ uint64_t jvmGetStackTraceElement(Thread* t, uintptr_t* arguments)
       t,
       makeStackTraceElement(
           t,
-          cast<GcTraceElement>(
-              t,
-              objectArrayBody(
-                  t, cast<GcThrowable>(t, *throwable)->trace(), index)))));
+          cast<GcRawTrace>(t, cast<GcThrowable>(t, *throwable)->trace()),
+          index)));
 }
 
 extern "C" AVIAN_EXPORT jobject JNICALL
@@ -3817,17 +3816,17 @@ uint64_t jvmDumpThreads(Thread* t, uintptr_t* arguments)
             ->peer());
 
     if (peer) {
-      object trace = t->m->processor->getStackTrace(t, peer);
+      GcRawTrace* trace
+          = cast<GcRawTrace>(t, t->m->processor->getStackTrace(t, peer));
       PROTECT(t, trace);
 
-      unsigned traceLength = objectArrayLength(t, trace);
+      unsigned traceLength = trace->length();
       object array
           = makeObjectArray(t, type(t, GcStackTraceElement::Type), traceLength);
       PROTECT(t, array);
 
       for (unsigned traceIndex = 0; traceIndex < traceLength; ++traceIndex) {
-        object ste = makeStackTraceElement(
-            t, cast<GcTraceElement>(t, objectArrayBody(t, trace, traceIndex)));
+        object ste = makeStackTraceElement(t, trace, traceIndex);
         setField(t, array, ArrayBody + (traceIndex * BytesPerWord), ste);
       }
 
@@ -3861,19 +3860,16 @@ extern "C" AVIAN_EXPORT jobject JNICALL EXPORT(JVM_CurrentClassLoader)(Thread*)
 
 uint64_t jvmGetClassContext(Thread* t, uintptr_t*)
 {
-  object trace = getTrace(t, 1);
+  GcRawTrace* trace = cast<GcRawTrace>(t, getTrace(t, 1));
   PROTECT(t, trace);
 
-  object context = makeObjectArray(
-      t, type(t, GcJclass::Type), objectArrayLength(t, trace));
+  object context
+      = makeObjectArray(t, type(t, GcJclass::Type), trace->length());
   PROTECT(t, context);
 
-  for (unsigned i = 0; i < objectArrayLength(t, trace); ++i) {
-    object c = getJClass(
-        t,
-        cast<GcMethod>(
-            t, cast<GcTraceElement>(t, objectArrayBody(t, trace, i))->method())
-            ->class_());
+  for (unsigned i = 0; i < trace->length(); ++i) {
+    object c
+        = getJClass(t, cast<GcMethod>(t, trace->method()[i])->class_());
 
     setField(t, context, ArrayBody + (i * BytesPerWord), c);
   }
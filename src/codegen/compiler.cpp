@@ -1961,6 +1961,52 @@ void updateJunctionReads(Context* c, JunctionState* state)
   }
 }
 
+// Approximates the loop nesting of each logical instruction by
+// counting the loops which span it, where a loop runs from the target
+// of one or more backward branches (its header) to the last of those
+// branches.  Several backward branches to the same header, such as
+// those from continue statements, count as a single loop.
+void computeLoopDepths(Context* c)
+{
+  // positions are logical instruction indexes plus one, leaving room
+  // for logical instruction -1
+  unsigned count = c->logicalCode.count() + 1;
+
+  // the position following the end of the loop headed at each
+  // position, or zero if no loop starts there
+  unsigned* loopEnds = static_cast<unsigned*>(
+      c->zone->allocate(sizeof(unsigned) * count));
+  memset(loopEnds, 0, sizeof(unsigned) * count);
+
+  for (Event* e = c->firstEvent; e; e = e->next) {
+    for (Link* sl = e->successors; sl; sl = sl->nextSuccessor) {
+      int from = e->logicalInstruction->index;
+      int to = sl->successor->logicalInstruction->index;
+      if (to < from and loopEnds[to + 1] < static_cast<unsigned>(from + 2)) {
+        loopEnds[to + 1] = from + 2;
+      }
+    }
+  }
+
+  // the number of loops ending just before each position
+  unsigned* loopExits = static_cast<unsigned*>(
+      c->zone->allocate(sizeof(unsigned) * (count + 1)));
+  memset(loopExits, 0, sizeof(unsigned) * (count + 1));
+
+  unsigned depth = 0;
+  for (unsigned i = 0; i < count; ++i) {
+    depth -= loopExits[i];
+    if (loopEnds[i]) {
+      ++depth;
+      ++loopExits[loopEnds[i]];
+    }
+
+    if (c->logicalCode[static_cast<int>(i) - 1]) {
+      c->logicalCode[static_cast<int>(i) - 1]->loopDepth = depth;
+    }
+  }
+}
+
 void compile(Context* c,
              uintptr_t stackOverflowHandler,
              unsigned stackLimitOffset)
@@ -1969,6 +2015,10 @@ void compile(Context* c,
     appendDummy(c);
   }
 
+  if (LoopWeightedSpillCosts) {
+    computeLoopDepths(c);
+  }
+
   Assembler* a = c->assembler;
 
   Block* firstBlock = block(c, c->firstEvent);
@@ -22,7 +22,8 @@ LogicalInstruction::LogicalInstruction(int index, Stack* stack, Local* locals)
       stack(stack),
       locals(locals),
       machineOffset(0),
-      /*subroutine(0), */ index(index)
+      /*subroutine(0), */ index(index),
+      loopDepth(0)
 {
 }
 
@@ -62,6 +62,7 @@ class LogicalInstruction {
   Local* locals;
   Promise* machineOffset;
   int index;
+  unsigned loopDepth;
 };
 
 class Block {
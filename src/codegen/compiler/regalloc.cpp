@@ -10,11 +10,15 @@
 
 #include "avian/target.h"
 
+#include <avian/util/math.h>
+
 #include "codegen/compiler/regalloc.h"
 #include "codegen/compiler/context.h"
 #include "codegen/compiler/site.h"
 #include "codegen/compiler/resource.h"
 #include "codegen/compiler/read.h"
+#include "codegen/compiler/event.h"
+#include "codegen/compiler/ir.h"
 
 namespace avian {
 namespace codegen {
@@ -29,6 +33,22 @@ RegisterAllocator::RegisterAllocator(Aborter* a,
 unsigned totalFrameSize(Context* c);
 Read* live(Context* c UNUSED, Value* v);
 
+// Evicting a value from its only site means storing it somewhere else
+// and probably reloading it at its next read, which costs more if that
+// read is inside a loop, so we add a penalty for each loop enclosing
+// it.
+unsigned loopPenalty(Context* c, Value* v)
+{
+  if (LoopWeightedSpillCosts) {
+    Read* r = live(c, v);
+    if (r and r->event) {
+      return min(r->event->logicalInstruction->loopDepth,
+                 Target::MaxLoopPenalty);
+    }
+  }
+  return 0;
+}
+
 unsigned resourceCost(Context* c,
                       Value* v,
                       Resource* r,
@@ -46,7 +66,8 @@ unsigned resourceCost(Context* c,
       if (v and r->value->isBuddyOf(v)) {
         return baseCost;
       } else if (r->value->uniqueSite(c, r->site)) {
-        return baseCost + Target::StealUniquePenalty;
+        return baseCost + Target::StealUniquePenalty
+               + loopPenalty(c, r->value);
       } else {
         return baseCost = Target::StealPenalty;
       }
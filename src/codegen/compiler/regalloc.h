@@ -33,6 +33,10 @@ class SiteMask;
 class Resource;
 class Read;
 
+// when true, the penalty for evicting a value from its only site grows
+// with the loop depth of the next read of that value
+const bool LoopWeightedSpillCosts = true;
+
 class RegisterAllocator {
  public:
   Aborter* a;
@@ -47,9 +51,11 @@ class Target {
   static const unsigned MinimumFrameCost = 1;
   static const unsigned StealPenalty = 2;
   static const unsigned StealUniquePenalty = 4;
+  static const unsigned MaxLoopPenalty = 3;
   static const unsigned IndirectMovePenalty = 4;
   static const unsigned LowRegisterPenalty = 10;
-  static const unsigned Impossible = 20;
+  // leaves headroom for MaxLoopPenalty when loop weighting is on
+  static const unsigned Impossible = LoopWeightedSpillCosts ? 24 : 20;
 
   Target() : cost(Impossible)
   {
@@ -63,10 +63,13 @@ const bool DebugNatives = false;
 const bool DebugCallTable = false;
 const bool DebugMethodTree = false;
 const bool DebugInstructions = false;
+const bool DebugInlineCaches = false;
+const bool DebugBoundsChecks = false;
 
 #ifndef AVIAN_AOT_ONLY
 const bool DebugFrameMaps = false;
 const bool CheckArrayBounds = true;
+const bool InlineGetters = true;
 const unsigned ExecutableAreaSizeInBytes = 30 * 1024 * 1024;
 #endif
 
@@ -80,6 +83,17 @@ const unsigned MaxNativeCallFootprint = TargetBytesPerWord == 8 ? 4 : 5;
 
 const unsigned InitialZoneCapacityInBytes = 64 * 1024;
 
+// number of receiver classes an inline cache remembers before going
+// megamorphic:
+const unsigned InlineCacheSize = 4;
+
+enum InlineCacheState {
+  InlineCacheEmpty,
+  InlineCacheMonomorphic,
+  InlineCachePolymorphic,
+  InlineCacheMegamorphic
+};
+
 enum ThunkIndex {
   compileMethodIndex,
   compileVirtualMethodIndex,
@@ -399,23 +413,240 @@ intptr_t compareIpToMethodBounds(Thread* t, intptr_t ip, object om)
   }
 }
 
+// Maps addresses within one executable region to the methods compiled
+// there.  Stack walking, exception unwinding, and GC stack scanning
+// all need to find the method for every frame, and this avoids
+// chasing pointers through the heap-allocated method tree each time.
+//
+// Methods are appended in address order, since code is only ever
+// allocated by bumping a pointer, and each page of the region records
+// the last method starting at or before the beginning of that page,
+// so a query is a binary search over the few methods sharing a page.
+//
+// Queries take no lock: insert fills in an entry and the page map
+// before publishing the new count, and entry arrays which have been
+// outgrown are kept until the index is disposed, since a reader may
+// still be looking at one.  The method tree is still maintained
+// alongside, since that is what we store in a boot image.
+class CodeIndex {
+ public:
+  static const unsigned PageSizeInBits = 12;
+  static const unsigned InitialCapacity = 256;
+
+  class Entry {
+   public:
+    uintptr_t start;
+    uintptr_t end;
+    GcMethod* method;
+  };
+
+  class Array {
+   public:
+    Array(Array* previous, unsigned capacity)
+        : previous(previous), capacity(capacity)
+    {
+    }
+
+    Entry* body()
+    {
+      return reinterpret_cast<Entry*>(this + 1);
+    }
+
+    Array* previous;
+    unsigned capacity;
+  };
+
+  CodeIndex()
+      : allocator(0),
+        base(0),
+        limit(0),
+        pageMap(0),
+        pageCount(0),
+        array(0),
+        count(0),
+        filledPageCount(0)
+  {
+  }
+
+  void init(Allocator* allocator, uint8_t* start, unsigned size)
+  {
+    this->allocator = allocator;
+    base = reinterpret_cast<uintptr_t>(start);
+    limit = base + size;
+    pageCount = (size >> PageSizeInBits) + 1;
+    pageMap = static_cast<int32_t*>(
+        allocator->allocate(pageCount * sizeof(int32_t)));
+  }
+
+  void dispose()
+  {
+    while (array) {
+      Array* previous = array->previous;
+      allocator->free(array, sizeof(Array) + (array->capacity * sizeof(Entry)));
+      array = previous;
+    }
+
+    if (pageMap) {
+      allocator->free(pageMap, pageCount * sizeof(int32_t));
+    }
+  }
+
+  unsigned pageOf(uintptr_t address)
+  {
+    return (address - base) >> PageSizeInBits;
+  }
+
+  // must be called with the class lock held, and in ascending
+  // address order
+  void insert(Thread* t, GcMethod* method)
+  {
+    uintptr_t start = methodCompiled(t, method);
+    uintptr_t end = start + methodCompiledSize(t, method);
+
+    assertT(t, start >= base and end <= limit);
+    assertT(t, count == 0 or start >= array->body()[count - 1].end);
+
+    if (array == 0 or count == array->capacity) {
+      unsigned capacity = array ? array->capacity * 2 : InitialCapacity;
+      Array* newArray = new (allocator->allocate(
+          sizeof(Array) + (capacity * sizeof(Entry)))) Array(array, capacity);
+
+      if (count) {
+        memcpy(newArray->body(), array->body(), count * sizeof(Entry));
+      }
+
+      storeStoreMemoryBarrier();
+
+      array = newArray;
+    }
+
+    Entry* e = array->body() + count;
+    e->start = start;
+    e->end = end;
+    e->method = method;
+
+    unsigned page = pageOf(start);
+    for (unsigned i = filledPageCount; i <= page; ++i) {
+      pageMap[i] = (i == page and start == base + (i << PageSizeInBits))
+                       ? static_cast<int32_t>(count)
+                       : static_cast<int32_t>(count) - 1;
+    }
+
+    storeStoreMemoryBarrier();
+
+    ++count;
+
+    if (filledPageCount <= page) {
+      storeStoreMemoryBarrier();
+
+      filledPageCount = page + 1;
+    }
+  }
+
+  // returns the index of the entry for the method containing the
+  // specified address, or -1 if there is none
+  int find(uintptr_t ip)
+  {
+    if (ip < base or ip >= limit) {
+      return -1;
+    }
+
+    unsigned filled = filledPageCount;
+    loadMemoryBarrier();
+
+    int n = count;
+    loadMemoryBarrier();
+
+    if (n == 0) {
+      return -1;
+    }
+
+    Entry* entries = array->body();
+
+    // find the last entry starting at or before ip, which must lie
+    // between those covering the start of this page and the next:
+    int low;
+    int high;
+    unsigned page = pageOf(ip);
+    if (page < filled) {
+      low = pageMap[page];
+      high = page + 1 < filled ? pageMap[page + 1] : n - 1;
+
+      if (low < 0) {
+        low = 0;
+      }
+
+      if (high > n - 1) {
+        high = n - 1;
+      }
+    } else {
+      low = high = n - 1;
+    }
+
+    while (low < high) {
+      int middle = (low + high + 1) / 2;
+      if (entries[middle].start <= ip) {
+        low = middle;
+      } else {
+        high = middle - 1;
+      }
+    }
+
+    if (ip >= entries[low].start and ip < entries[low].end) {
+      return low;
+    } else {
+      return -1;
+    }
+  }
+
+  GcMethod* query(uintptr_t ip)
+  {
+    int index = find(ip);
+    return index >= 0 ? array->body()[index].method : 0;
+  }
+
+  // replaces the method previously inserted at the same address
+  void update(Thread* t, GcMethod* method)
+  {
+    int index = find(methodCompiled(t, method));
+    assertT(t, index >= 0);
+
+    array->body()[index].method = method;
+  }
+
+  void visit(Heap::Visitor* v)
+  {
+    for (unsigned i = 0; i < count; ++i) {
+      v->visit(&(array->body()[i].method));
+    }
+  }
+
+  Allocator* allocator;
+  uintptr_t base;
+  uintptr_t limit;
+  int32_t* pageMap;
+  unsigned pageCount;
+  Array* array;
+  unsigned count;
+  unsigned filledPageCount;
+};
+
+CodeIndex* codeIndex(MyThread* t);
+
+CodeIndex* bootCodeIndex(MyThread* t);
+
 GcMethod* methodForIp(MyThread* t, void* ip)
 {
   if (DebugMethodTree) {
     fprintf(stderr, "query for method containing %p\n", ip);
   }
 
-  // we must use a version of the method tree at least as recent as the
-  // compiled form of the method containing the specified address (see
-  // compile(MyThread*, FixedAllocator*, BootContext*, object)):
-  loadMemoryBarrier();
+  GcMethod* method = codeIndex(t)->query(reinterpret_cast<uintptr_t>(ip));
+  if (method == 0) {
+    method = bootCodeIndex(t)->query(reinterpret_cast<uintptr_t>(ip));
+  }
 
-  return cast<GcMethod>(t,
-                        treeQuery(t,
-                                  compileRoots(t)->methodTree(),
-                                  reinterpret_cast<intptr_t>(ip),
-                                  compileRoots(t)->methodTreeSentinal(),
-                                  compareIpToMethodBounds));
+  return method;
 }
 
 unsigned localSize(MyThread* t UNUSED, GcMethod* method)
@@ -834,6 +1065,26 @@ class TraceElement : public avian::codegen::TraceHandler {
   uintptr_t map[0];
 };
 
+// A call site compiled with an inline cache and a patchable direct
+// call (see compileCachedInvoke).
+class InlineCacheSite {
+ public:
+  InlineCacheSite(GcInlineCache* cache,
+                  TraceElement* trace,
+                  bool interface,
+                  InlineCacheSite* next)
+      : cache(cache), trace(trace), interface(interface), next(next)
+  {
+  }
+
+  GcInlineCache* cache;
+  // the direct call, whose return address the cache records once the
+  // code is written (see finish):
+  TraceElement* trace;
+  bool interface;
+  InlineCacheSite* next;
+};
+
 class TraceElementPromise : public avian::codegen::Promise {
  public:
   TraceElementPromise(System* s, TraceElement* trace) : s(s), trace(trace)
@@ -965,6 +1216,10 @@ class Context {
       for (TraceElement* p = c->traceLog; p; p = p->next) {
         v->visit(&(p->target));
       }
+
+      for (InlineCacheSite* p = c->inlineCacheSites; p; p = p->next) {
+        v->visit(&(p->cache));
+      }
     }
 
     Context* c;
@@ -1173,12 +1428,16 @@ class Context {
         objectPool(0),
         subroutineCount(0),
         traceLog(0),
+        inlineCacheSites(0),
         visitTable(
             Slice<uint16_t>::allocAndSet(&zone, method->code()->length(), 0)),
         rootTable(Slice<uintptr_t>::allocAndSet(
             &zone,
             method->code()->length() * frameMapSizeInWords(t, method),
             ~(uintptr_t)0)),
+        inBoundsTable(
+            Slice<bool>::allocAndSet(&zone, method->code()->length(), false)),
+        slowPathIps(0, 0),
         executableAllocator(0),
         executableStart(0),
         executableSize(0),
@@ -1186,6 +1445,7 @@ class Context {
         traceLogCount(0),
         dirtyRoots(false),
         leaf(true),
+        fastPaths(false),
         eventLog(t->m->system, t->m->heap, 1024),
         protector(this),
         resource(this),
@@ -1206,8 +1466,11 @@ class Context {
         objectPool(0),
         subroutineCount(0),
         traceLog(0),
+        inlineCacheSites(0),
         visitTable(0, 0),
         rootTable(0, 0),
+        inBoundsTable(0, 0),
+        slowPathIps(0, 0),
         executableAllocator(0),
         executableStart(0),
         executableSize(0),
@@ -1215,6 +1478,7 @@ class Context {
         traceLogCount(0),
         dirtyRoots(false),
         leaf(true),
+        fastPaths(false),
         eventLog(t->m->system, t->m->heap, 0),
         protector(this),
         resource(this),
@@ -1258,6 +1522,20 @@ class Context {
         ~(uintptr_t)0);
   }
 
+  // Allocates a logical instruction for the out-of-line slow path of
+  // the instruction at the specified bytecode ip.  Slow paths are
+  // numbered from the end of the bytecode, so this may only be used
+  // when there are no subroutine copies (see Context::fastPaths).
+  unsigned addSlowPath(unsigned ip)
+  {
+    assertT(thread, subroutineCount == 0);
+
+    unsigned logicalIp = visitTable.count;
+    extendLogicalCode(1);
+    slowPathIps = slowPathIps.cloneAndSet(&zone, slowPathIps.count + 1, ip);
+    return logicalIp;
+  }
+
   MyThread* thread;
   Zone zone;
   avian::codegen::Assembler* assembler;
@@ -1268,8 +1546,11 @@ class Context {
   PoolElement* objectPool;
   unsigned subroutineCount;
   TraceElement* traceLog;
+  InlineCacheSite* inlineCacheSites;
   Slice<uint16_t> visitTable;
   Slice<uintptr_t> rootTable;
+  Slice<bool> inBoundsTable;
+  Slice<unsigned> slowPathIps;
   Alloc* executableAllocator;
   void* executableStart;
   unsigned executableSize;
@@ -1277,6 +1558,7 @@ class Context {
   unsigned traceLogCount;
   bool dirtyRoots;
   bool leaf;
+  bool fastPaths;
   Vector eventLog;
   MyProtector protector;
   MyResource resource;
@@ -2070,6 +2352,8 @@ class Frame {
                    context->method->code()->length(),
                    this->subroutine);
 
+    assertT(t, context->slowPathIps.count == 0);
+
     context->extendLogicalCode(context->method->code()->length());
 
     this->subroutine = subroutine;
@@ -2120,17 +2404,25 @@ void* findExceptionHandler(Thread* t, GcMethod* method, void* ip)
       GcIntArray* index = cast<GcIntArray>(t, table->body()[0]);
 
       uint8_t* compiled = reinterpret_cast<uint8_t*>(methodCompiled(t, method));
+      unsigned key = difference(ip, compiled) - 1;
+
+      // most frames we unwind through are not inside any of their
+      // method's try blocks, so check the range covered by all of
+      // them before looking at each one:
+      if (key < static_cast<unsigned>(index->body()[0])
+          or key >= static_cast<unsigned>(index->body()[1])) {
+        return 0;
+      }
 
       for (unsigned i = 0; i < table->length() - 1; ++i) {
-        unsigned start = index->body()[i * 3];
-        unsigned end = index->body()[(i * 3) + 1];
-        unsigned key = difference(ip, compiled) - 1;
+        unsigned start = index->body()[2 + (i * 3)];
+        unsigned end = index->body()[2 + (i * 3) + 1];
 
         if (key >= start and key < end) {
           GcClass* catchType = cast<GcClass>(t, table->body()[i + 1]);
 
           if (exceptionMatch(t, catchType, t->exception)) {
-            return compiled + index->body()[(i * 3) + 2];
+            return compiled + index->body()[2 + (i * 3) + 2];
           }
         }
       }
@@ -2461,29 +2753,6 @@ int64_t prepareMethodForCall(MyThread* t, GcMethod* target)
   }
 }
 
-int64_t findInterfaceMethodFromInstance(MyThread* t,
-                                        GcMethod* method,
-                                        object instance)
-{
-  if (instance) {
-    return prepareMethodForCall(
-        t, findInterfaceMethod(t, method, objectClass(t, instance)));
-  } else {
-    throwNew(t, GcNullPointerException::Type);
-  }
-}
-
-int64_t findInterfaceMethodFromInstanceAndReference(MyThread* t,
-                                                    GcPair* pair,
-                                                    object instance)
-{
-  PROTECT(t, instance);
-
-  GcMethod* method = resolveMethod(t, pair);
-
-  return findInterfaceMethodFromInstance(t, method, instance);
-}
-
 void checkMethod(Thread* t, GcMethod* method, bool shouldBeStatic)
 {
   if (((method->flags() & ACC_STATIC) == 0) == shouldBeStatic) {
@@ -2522,6 +2791,29 @@ int64_t findStaticMethodFromReference(MyThread* t, GcPair* pair)
   return prepareMethodForCall(t, target);
 }
 
+int64_t findInterfaceMethodFromInstance(MyThread* t,
+                                        GcMethod* method,
+                                        object instance)
+{
+  if (instance) {
+    return prepareMethodForCall(
+        t, findInterfaceMethod(t, method, objectClass(t, instance)));
+  } else {
+    throwNew(t, GcNullPointerException::Type);
+  }
+}
+
+int64_t findInterfaceMethodFromInstanceAndReference(MyThread* t,
+                                                    GcPair* pair,
+                                                    object instance)
+{
+  PROTECT(t, instance);
+
+  GcMethod* method = resolveMethod(t, pair);
+
+  return findInterfaceMethodFromInstance(t, method, instance);
+}
+
 int64_t findVirtualMethodFromReference(MyThread* t,
                                        GcPair* pair,
                                        object instance)
@@ -2537,6 +2829,248 @@ int64_t findVirtualMethodFromReference(MyThread* t,
   return prepareMethodForCall(t, target);
 }
 
+bool useLongJump(MyThread* t, uintptr_t target);
+
+void updateCall(MyThread* t,
+                avian::codegen::lir::UnaryOperation op,
+                void* returnAddress,
+                void* target);
+
+GcInlineCache* makeInlineCache(MyThread* t, GcMethod* caller, object target)
+{
+  return makeInlineCache(t, caller, target, 0, 0, 0, 0, 0, InlineCacheSize * 2);
+}
+
+const char* inlineCacheStateName(unsigned state)
+{
+  const char* const names[]
+      = {"empty", "monomorphic", "polymorphic", "megamorphic"};
+
+  return names[state];
+}
+
+void logInlineCacheTransition(MyThread* t,
+                              GcInlineCache* cache,
+                              unsigned from,
+                              unsigned to)
+{
+  GcMethod* caller = cache->caller();
+  GcMethod* target = cast<GcMethod>(t, cache->target());
+
+  fprintf(stderr,
+          "inline cache in %s.%s%s for %s.%s%s went from %s to %s "
+          "(%d hits, %d misses)\n",
+          caller->class_()->name()->body().begin(),
+          caller->name()->body().begin(),
+          caller->spec()->body().begin(),
+          target->class_()->name()->body().begin(),
+          target->name()->body().begin(),
+          target->spec()->body().begin(),
+          inlineCacheStateName(from),
+          inlineCacheStateName(to),
+          cache->hitCount(),
+          cache->missCount());
+}
+
+// Moves the specified cache to the specified state unless it is
+// already there or beyond.  States only ever advance, so a thread
+// which loses a race to update one may simply leave it be.
+void advanceInlineCache(MyThread* t, GcInlineCache* cache, unsigned state)
+{
+  for (uint32_t old = cache->state(); old < state; old = cache->state()) {
+    if (atomicCompareAndSwap32(&(cache->state()), old, state)) {
+      if (DebugInlineCaches) {
+        logInlineCacheTransition(t, cache, old, state);
+      }
+      return;
+    }
+  }
+}
+
+// Binds a call site compiled by compileCachedInvoke to the specified
+// receiver class by patching its direct call to call the specified
+// implementation.  Only the thread which moves the cache out of the
+// empty state binds it; any other receiver class, including one
+// which races with the binding, goes to the site's stub, which
+// dispatches through the class's vtable or interface method table.
+// The class is published only after the call is patched, so no
+// thread passes the site's guard before then.
+void bindInlineCache(MyThread* t,
+                     GcInlineCache* cache,
+                     GcClass* class_,
+                     GcMethod* target)
+{
+  if (not atomicCompareAndSwap32(
+          &(cache->state()), InlineCacheEmpty, InlineCacheMonomorphic)) {
+    return;
+  }
+
+  if (DebugInlineCaches) {
+    logInlineCacheTransition(
+        t, cache, InlineCacheEmpty, InlineCacheMonomorphic);
+  }
+
+  // native methods are reached through a thunk which needs a call
+  // node naming them, so we leave those to the stub:
+  if (methodAbstract(t, target) or (target->flags() & ACC_NATIVE)) {
+    advanceInlineCache(t, cache, InlineCacheMegamorphic);
+    return;
+  }
+
+  if (unresolved(t, methodAddress(t, target))) {
+    PROTECT(t, cache);
+    PROTECT(t, class_);
+    PROTECT(t, target);
+
+    compile(t, codeAllocator(t), 0, target);
+  }
+
+  uintptr_t address = methodAddress(t, target);
+  if (useLongJump(t, address)) {
+    advanceInlineCache(t, cache, InlineCacheMegamorphic);
+    return;
+  }
+
+  updateCall(t,
+             avian::codegen::lir::AlignedCall,
+             reinterpret_cast<void*>(cache->returnAddress()),
+             reinterpret_cast<void*>(address));
+
+  storeStoreMemoryBarrier();
+
+  cache->setReceiver(t, class_);
+}
+
+// Find the implementation of the call site's target for the class of
+// the specified instance.
+//
+// A site compiled with a direct call (i.e. one with a return address)
+// only comes here from its stub, either to be bound or because the
+// receiver's tables couldn't answer; see compileCachedInvoke.
+//
+// Any other site comes here on every call, and its cache holds
+// (receiver class, implementation) pairs for up to InlineCacheSize
+// classes, searched before the tables.  Once it overflows, the site is
+// considered megamorphic and the cache isn't updated further.
+GcMethod* findMethodFromInlineCache(MyThread* t,
+                                    GcInlineCache* cache,
+                                    object instance,
+                                    bool interface)
+{
+  if (UNLIKELY(instance == 0)) {
+    throwNew(t, GcNullPointerException::Type);
+  }
+
+  GcClass* class_ = objectClass(t, instance);
+
+  if (cache->returnAddress()) {
+    PROTECT(t, cache);
+    PROTECT(t, class_);
+
+    GcMethod* method = cast<GcMethod>(t, cache->target());
+    GcMethod* target = interface ? findInterfaceMethod(t, method, class_)
+                                 : findVirtualMethod(t, method, class_);
+
+    if (cache->state() == InlineCacheEmpty) {
+      PROTECT(t, target);
+
+      bindInlineCache(t, cache, class_, target);
+    }
+
+    return target;
+  }
+
+  // entries are only ever added, each by the thread which claimed its
+  // class slot, which stores the implementation afterwards, so we may
+  // search without a lock and treat a missing implementation as a
+  // miss:
+  for (unsigned i = 0; i < cache->length(); i += 2) {
+    object c = cache->entries()[i];
+    if (c == class_) {
+      object m = cache->entries()[i + 1];
+      if (m) {
+        if (DebugInlineCaches) {
+          ++cache->hitCount();
+        }
+
+        return cast<GcMethod>(t, m);
+      }
+      break;
+    } else if (c == 0) {
+      break;
+    }
+  }
+
+  PROTECT(t, cache);
+  PROTECT(t, class_);
+
+  if (DebugInlineCaches) {
+    ++cache->missCount();
+  }
+
+  if (UNLIKELY(objectClass(t, cache->target()) == type(t, GcPair::Type))) {
+    // the target was unresolved at compile time
+    GcMethod* method = resolveMethod(t, cast<GcPair>(t, cache->target()));
+
+    if (not interface) {
+      checkMethod(t, method, false);
+    }
+
+    cache->setTarget(t, method);
+  }
+
+  GcMethod* method = cast<GcMethod>(t, cache->target());
+  GcMethod* target = interface ? findInterfaceMethod(t, method, class_)
+                               : findVirtualMethod(t, method, class_);
+
+  if (cache->state() != InlineCacheMegamorphic) {
+    unsigned i = 0;
+    while (i < cache->length()) {
+      object c = cache->entries()[i];
+      if (c == class_) {
+        // another thread got here first
+        break;
+      } else if (c) {
+        i += 2;
+      } else if (atomicCompareAndSwapObject(
+                     t, cache, InlineCacheEntries + (i * BytesPerWord), 0,
+                     class_)) {
+        cache->setEntriesElement(t, i + 1, target);
+
+        advanceInlineCache(
+            t, cache, i ? InlineCachePolymorphic : InlineCacheMonomorphic);
+        break;
+      }
+      // otherwise another thread claimed this slot, so look again
+    }
+
+    if (i == cache->length()) {
+      advanceInlineCache(t, cache, InlineCacheMegamorphic);
+    }
+  }
+
+  return target;
+}
+
+int64_t findInterfaceMethodFromCache(MyThread* t,
+                                     GcInlineCache* cache,
+                                     object instance)
+{
+  return prepareMethodForCall(
+      t, findMethodFromInlineCache(t, cache, instance, true));
+}
+
+int64_t findVirtualMethodFromCache(MyThread* t,
+                                   GcInlineCache* cache,
+                                   object instance)
+{
+  GcMethod* target = findMethodFromInlineCache(t, cache, instance, false);
+
+  checkMethod(t, target, false);
+
+  return prepareMethodForCall(t, target);
+}
+
 int64_t getMethodAddress(MyThread* t, GcMethod* target)
 {
   return prepareMethodForCall(t, target);
@@ -2570,9 +3104,10 @@ unsigned traceSize(Thread* t)
 
   t->m->processor->walkStack(t, &counter);
 
-  return pad(GcArray::FixedSize)
-         + (counter.count * pad(ArrayElementSizeOfArray))
-         + (counter.count * pad(GcTraceElement::FixedSize));
+  return pad(GcRawTrace::FixedSize)
+         + pad(counter.count * ArrayElementSizeOfRawTrace)
+         + pad(GcIntArray::FixedSize)
+         + pad(counter.count * ArrayElementSizeOfIntArray);
 }
 
 void NO_RETURN throwArithmetic(MyThread* t)
@@ -3087,7 +3622,36 @@ uint64_t makeNew64(Thread* t, GcClass* class_)
   return reinterpret_cast<uintptr_t>(makeNew(t, class_));
 }
 
-uint64_t makeNewFromReference(Thread* t, GcPair* pair)
+// returns true if neither the specified class nor any of its
+// superclasses needs to be initialized before it can be instantiated.
+// Note that we deliberately ignore whether the current thread is the
+// one initializing the class, since the code we generate may run on
+// any thread.
+bool classInitialized(Thread*, GcClass* c)
+{
+  for (; c; c = c->super()) {
+    if (c->vmFlags() & NeedInitFlag) {
+      return false;
+    }
+  }
+  return true;
+}
+
+uint64_t makeNewInitialized64(Thread* t, GcClass* class_)
+{
+  // the compiler only calls this for classes which (along with their
+  // superclasses) are known to be initialized, so all we need to do
+  // here is bump the thread-local heap pointer, leaving the slow path
+  // to allocate2 on overflow:
+  return reinterpret_cast<uintptr_t>(makeNew(t, class_));
+}
+
+uint64_t identityHash64(Thread* t, object o)
+{
+  return o ? objectHash(t, o) : 0;
+}
+
+uint64_t makeNewFromReference(Thread* t, GcPair* pair)
 {
   GcClass* class_
       = resolveClass(t,
@@ -3144,12 +3708,6 @@ void logCompile(MyThread* t,
                 const char* name,
                 const char* spec);
 
-unsigned simpleFrameMapTableSize(MyThread* t, GcMethod* method, GcIntArray* map)
-{
-  int size = frameMapSizeInBits(t, method);
-  return ceilingDivide(map->length() * size, 32 + size);
-}
-
 #ifndef AVIAN_AOT_ONLY
 unsigned resultSize(MyThread* t, unsigned code)
 {
@@ -3212,6 +3770,94 @@ void compileSafePoint(MyThread* t, Compiler* c, Frame* frame)
       args(c->threadRegister()));
 }
 
+bool inlineAllocation(MyThread* t, Context* context)
+{
+#ifdef VM_STRESS
+  // allocate must see every allocation so it can force collections
+  return false;
+#else
+  // allocations bumped inline aren't sampled by allocateSmall, and a
+  // boot image is compiled before we know whether they will be:
+  return context->fastPaths and context->bootContext == 0
+         and t->m->allocationProfile == 0;
+#endif
+}
+
+// Emits the part of allocateSmall which remains once the caller has
+// checked that the thread-local heap has room: it stores the new heap
+// index, computes the address of the object, and gives it its class.
+ir::Value* allocateInline(Frame* frame,
+                          ir::Value* index,
+                          ir::Value* newIndex,
+                          ir::Value* class_)
+{
+  avian::codegen::Compiler* c = frame->c;
+
+  c->store(newIndex,
+           c->memory(
+               c->threadRegister(), ir::Type::i4(), TARGET_THREAD_HEAPINDEX));
+
+  ir::Value* heap = c->load(
+      ir::ExtendMode::Signed,
+      c->memory(c->threadRegister(), ir::Type::iptr(), TARGET_THREAD_HEAP),
+      ir::Type::iptr());
+
+  ir::Value* offset = c->binaryOp(
+      lir::ShiftLeft,
+      ir::Type::iptr(),
+      c->constant(TargetBytesPerWord == 8 ? 3 : 2, ir::Type::i4()),
+      c->truncateThenExtend(
+          ir::ExtendMode::Signed, ir::Type::iptr(), ir::Type::i4(), index));
+
+  ir::Value* instance
+      = c->binaryOp(lir::Add, ir::Type::object(), offset, heap);
+
+  // the thread-local heap is zeroed when it is handed out, so we need
+  // only store the class:
+  c->store(class_, c->memory(instance, ir::Type::object(), 0));
+
+  return instance;
+}
+
+ir::Value* loadThreadInt(avian::codegen::Compiler* c, unsigned offset)
+{
+  return c->load(ir::ExtendMode::Signed,
+                 c->memory(c->threadRegister(), ir::Type::i4(), offset),
+                 ir::Type::i4());
+}
+
+GcClass* primitiveArrayClass(MyThread* t, unsigned code, unsigned* shift)
+{
+  switch (code) {
+  case T_BOOLEAN:
+    *shift = 0;
+    return type(t, GcBooleanArray::Type);
+  case T_CHAR:
+    *shift = 1;
+    return type(t, GcCharArray::Type);
+  case T_FLOAT:
+    *shift = 2;
+    return type(t, GcFloatArray::Type);
+  case T_DOUBLE:
+    *shift = 3;
+    return type(t, GcDoubleArray::Type);
+  case T_BYTE:
+    *shift = 0;
+    return type(t, GcByteArray::Type);
+  case T_SHORT:
+    *shift = 1;
+    return type(t, GcShortArray::Type);
+  case T_INT:
+    *shift = 2;
+    return type(t, GcIntArray::Type);
+  case T_LONG:
+    *shift = 3;
+    return type(t, GcLongArray::Type);
+  default:
+    abort(t);
+  }
+}
+
 void compileDirectInvoke(MyThread* t,
                          Frame* frame,
                          GcMethod* target,
@@ -3282,6 +3928,8 @@ void compileDirectInvoke(MyThread* t,
   }
 }
 
+bool compileInlinedGetter(MyThread* t, Frame* frame, GcMethod* target);
+
 bool compileDirectInvoke(MyThread* t,
                          Frame* frame,
                          GcMethod* target,
@@ -3292,6 +3940,8 @@ bool compileDirectInvoke(MyThread* t,
   if (emptyMethod(t, target) and (not classNeedsInit(t, target->class_()))) {
     frame->popFootprint(target->parameterFootprint());
     tailCall = false;
+  } else if (compileInlinedGetter(t, frame, target)) {
+    tailCall = false;
   } else {
     BootContext* bc = frame->context->bootContext;
     if (bc) {
@@ -3710,7 +4360,24 @@ ir::Value* popLongAddress(Frame* frame)
                               ir::Type::iptr());
 }
 
-bool intrinsic(MyThread* t UNUSED, Frame* frame, GcMethod* target)
+// identity hash codes don't need any of the native method call
+// machinery, so we call objectHash directly via a thunk:
+void compileIdentityHash(MyThread* t, Frame* frame)
+{
+  avian::codegen::Compiler* c = frame->c;
+
+  ir::Value* instance = frame->pop(ir::Type::object());
+
+  frame->push(ir::Type::i4(),
+              c->nativeCall(c->constant(getThunk(t, identityHash64Thunk),
+                                        ir::Type::iptr()),
+                            0,
+                            frame->trace(0, 0),
+                            ir::Type::i4(),
+                            args(c->threadRegister(), instance)));
+}
+
+bool intrinsic(MyThread* t, Frame* frame, GcMethod* target)
 {
 #define MATCH(name, constant)         \
   (name->length() == sizeof(constant) \
@@ -3740,6 +4407,12 @@ bool intrinsic(MyThread* t UNUSED, Frame* frame, GcMethod* target)
         return true;
       }
     }
+  } else if (UNLIKELY(MATCH(className, "java/lang/System"))) {
+    if (MATCH(target->name(), "identityHashCode")
+        and MATCH(target->spec(), "(Ljava/lang/Object;)I")) {
+      compileIdentityHash(t, frame);
+      return true;
+    }
   } else if (UNLIKELY(MATCH(className, "sun/misc/Unsafe"))) {
     avian::codegen::Compiler* c = frame->c;
     if (MATCH(target->name(), "getByte") and MATCH(target->spec(), "(J)B")) {
@@ -3844,6 +4517,19 @@ bool intrinsic(MyThread* t UNUSED, Frame* frame, GcMethod* target)
   return false;
 }
 
+// like intrinsic, but for methods invoked non-virtually via
+// invokespecial, i.e. super.hashCode()
+bool specialIntrinsic(MyThread* t, Frame* frame, GcMethod* target)
+{
+  GcByteArray* className = target->class_()->name();
+  if (UNLIKELY(MATCH(className, "java/lang/Object"))
+      and MATCH(target->name(), "hashCode") and MATCH(target->spec(), "()I")) {
+    compileIdentityHash(t, frame);
+    return true;
+  }
+  return false;
+}
+
 unsigned targetFieldOffset(Context* context, GcField* field)
 {
   if (context->bootContext) {
@@ -3853,6 +4539,170 @@ unsigned targetFieldOffset(Context* context, GcField* field)
   }
 }
 
+void compileGetField(MyThread* t,
+                     Frame* frame,
+                     ir::Value* table,
+                     GcField* field)
+{
+  avian::codegen::Compiler* c = frame->c;
+  Context* context = frame->context;
+
+  switch (field->code()) {
+  case ByteField:
+  case BooleanField:
+    frame->push(ir::Type::i4(),
+                c->load(ir::ExtendMode::Signed,
+                        c->memory(table,
+                                  ir::Type::i1(),
+                                  targetFieldOffset(context, field)),
+                        ir::Type::i4()));
+    break;
+
+  case CharField:
+    frame->push(ir::Type::i4(),
+                c->load(ir::ExtendMode::Unsigned,
+                        c->memory(table,
+                                  ir::Type::i2(),
+                                  targetFieldOffset(context, field)),
+                        ir::Type::i4()));
+    break;
+
+  case ShortField:
+    frame->push(ir::Type::i4(),
+                c->load(ir::ExtendMode::Signed,
+                        c->memory(table,
+                                  ir::Type::i2(),
+                                  targetFieldOffset(context, field)),
+                        ir::Type::i4()));
+    break;
+
+  case FloatField:
+    frame->push(ir::Type::f4(),
+                c->load(ir::ExtendMode::Signed,
+                        c->memory(table,
+                                  ir::Type::f4(),
+                                  targetFieldOffset(context, field)),
+                        ir::Type::f4()));
+    break;
+
+  case IntField:
+    frame->push(ir::Type::i4(),
+                c->load(ir::ExtendMode::Signed,
+                        c->memory(table,
+                                  ir::Type::i4(),
+                                  targetFieldOffset(context, field)),
+                        ir::Type::i4()));
+    break;
+
+  case DoubleField:
+    frame->pushLarge(ir::Type::f8(),
+                     c->load(ir::ExtendMode::Signed,
+                             c->memory(table,
+                                       ir::Type::f8(),
+                                       targetFieldOffset(context, field)),
+                             ir::Type::f8()));
+    break;
+
+  case LongField:
+    frame->pushLarge(ir::Type::i8(),
+                     c->load(ir::ExtendMode::Signed,
+                             c->memory(table,
+                                       ir::Type::i8(),
+                                       targetFieldOffset(context, field)),
+                             ir::Type::i8()));
+    break;
+
+  case ObjectField:
+    frame->push(ir::Type::object(),
+                c->load(ir::ExtendMode::Signed,
+                        c->memory(table,
+                                  ir::Type::object(),
+                                  targetFieldOffset(context, field)),
+                        ir::Type::object()));
+    break;
+
+  default:
+    abort(t);
+  }
+}
+
+// If the specified method does nothing but load and return a field
+// (i.e. it's a simple getter), compile the load in place of a call to
+// it and return true.  The receiver's implicit null check is
+// preserved, although a NullPointerException thrown there will
+// appear to come from the caller rather than the getter.
+bool compileInlinedGetter(MyThread* t, Frame* frame, GcMethod* target)
+{
+  if ((not InlineGetters)
+      or (target->flags() & (ACC_NATIVE | ACC_SYNCHRONIZED))) {
+    return false;
+  }
+
+  GcCode* code = target->code();
+  if (code == 0) {
+    return false;
+  }
+
+  bool isStatic = (target->flags() & ACC_STATIC) != 0;
+
+  unsigned ip;
+  if (isStatic) {
+    if (code->length() != 4 or code->body()[0] != getstatic) {
+      return false;
+    }
+    ip = 1;
+  } else {
+    if (code->length() != 5 or code->body()[0] != aload_0
+        or code->body()[1] != getfield) {
+      return false;
+    }
+    ip = 2;
+  }
+
+  switch (code->body()[ip + 2]) {
+  case ireturn:
+  case lreturn:
+  case freturn:
+  case dreturn:
+  case areturn:
+    break;
+
+  default:
+    return false;
+  }
+
+  uint16_t index = codeReadInt16(t, code, ip);
+
+  PROTECT(t, target);
+
+  GcField* field = resolveField(t, target, index - 1, false);
+  if (field == 0 or ((field->flags() & ACC_STATIC) != 0) != isStatic
+      or (field->flags() & ACC_VOLATILE)) {
+    return false;
+  }
+
+  ir::Value* table;
+  if (isStatic) {
+    if (classNeedsInit(t, target->class_())
+        or classNeedsInit(t, field->class_())) {
+      return false;
+    }
+
+    table = frame->append(field->class_()->staticTable());
+  } else {
+    table = frame->pop(ir::Type::object());
+
+    if (inTryBlock(t, frame->context->method->code(), frame->ip)) {
+      frame->c->saveLocals();
+      frame->trace(0, 0);
+    }
+  }
+
+  compileGetField(t, frame, table, field);
+
+  return true;
+}
+
 class Stack {
  public:
   class MyResource : public Thread::AutoResource {
@@ -3957,120 +4807,616 @@ class SwitchState {
   unsigned index;
 };
 
-lir::TernaryOperation toCompilerBinaryOp(MyThread* t, unsigned instruction)
-{
-  switch (instruction) {
-  case iadd:
-  case ladd:
-    return lir::Add;
-  case ior:
-  case lor:
-    return lir::Or;
-  case ishl:
-  case lshl:
-    return lir::ShiftLeft;
-  case ishr:
-  case lshr:
-    return lir::ShiftRight;
-  case iushr:
-  case lushr:
-    return lir::UnsignedShiftRight;
-  case fadd:
-  case dadd:
-    return lir::FloatAdd;
-  case fsub:
-  case dsub:
-    return lir::FloatSubtract;
-  case fmul:
-  case dmul:
-    return lir::FloatMultiply;
-  case fdiv:
-  case ddiv:
-    return lir::FloatDivide;
-  case frem:
-  case vm::drem:
-    return lir::FloatRemainder;
-  case iand:
-  case land:
-    return lir::And;
-  case isub:
-  case lsub:
-    return lir::Subtract;
-  case ixor:
-  case lxor:
-    return lir::Xor;
-  case imul:
-  case lmul:
-    return lir::Multiply;
-  default:
-    abort(t);
+const unsigned MaxSlowPathArguments = 3;
+
+// An instruction compiled as an inline fast path plus a call to a
+// thunk which handles everything else.  The call is compiled out of
+// line once the fast path and everything reachable from it are done,
+// and rejoins the fast path at nextIp.
+class SlowPathState {
+ public:
+  SlowPathState(unsigned logicalIp,
+                unsigned nextIp,
+                Thunk thunk,
+                ir::Type resultType,
+                Slice<ir::Value*> arguments)
+      : branches(0),
+        skips(0),
+        logicalIp(logicalIp),
+        nextIp(nextIp),
+        thunk(thunk),
+        resultType(resultType),
+        argumentCount(arguments.count),
+        callFootprint(0),
+        callReturnCode(VoidField),
+        cacheSite(0)
+  {
+    for (unsigned i = 0; i < argumentCount; ++i) {
+      this->arguments[i] = arguments[i];
+    }
   }
-}
 
-uintptr_t aioobThunk(MyThread* t);
+  Frame* frame()
+  {
+    return reinterpret_cast<Frame*>(reinterpret_cast<uint8_t*>(this)
+                                    - pad(sizeof(Frame)));
+  }
+
+  // states at the branches to the slow path:
+  List<Compiler::State*>* branches;
+  // states at branches which bypass both paths and go straight to
+  // nextIp:
+  List<Compiler::State*>* skips;
+  unsigned logicalIp;
+  unsigned nextIp;
+  Thunk thunk;
+  ir::Type resultType;
+  unsigned argumentCount;
+  ir::Value* arguments[MaxSlowPathArguments];
+  // if non-zero, the thunk returns the address of a method taking
+  // this many words of arguments from the operand stack, which the
+  // slow path calls (see callFromSlowPath):
+  unsigned callFootprint;
+  unsigned callReturnCode;
+  // if non-zero, the slow path is the stub of this site (see
+  // compileInlineCacheStub):
+  InlineCacheSite* cacheSite;
+};
 
-uintptr_t stackOverflowThunk(MyThread* t);
+// Starts compiling the current instruction as a fast path whose
+// failures branch (via branchToSlowPath) to a call to the specified
+// thunk, passing the thread followed by the specified arguments.
+// Returns the frame in which to compile the fast path, which is
+// popped when it is done, at which point the compile loop sees the
+// specified tag and emits the slow path in the original frame.
+Frame* startFastPath(MyThread* t,
+                     Stack* stack,
+                     Frame* frame,
+                     uintptr_t tag,
+                     unsigned nextIp,
+                     Thunk thunk,
+                     ir::Type resultType,
+                     Slice<ir::Value*> arguments,
+                     SlowPathState** slowPath)
+{
+  Context* context = frame->context;
 
-void checkField(Thread* t, GcField* field, bool shouldBeStatic)
+  assertT(t, context->fastPaths);
+  assertT(t, arguments.count <= MaxSlowPathArguments);
+
+  *slowPath = new (stack->push(sizeof(SlowPathState))) SlowPathState(
+      context->addSlowPath(frame->ip), nextIp, thunk, resultType, arguments);
+
+  stack->pushValue(tag);
+
+  ir::Type* stackMap = static_cast<ir::Type*>(
+      stack->push(frame->stackSize() * sizeof(ir::Type)));
+  return new (stack->push(sizeof(Frame))) Frame(frame, stackMap);
+}
+
+// Branches to the slow path if "b op a" holds.  Every branch must be
+// made before the fast path pushes or pops anything, so the slow path
+// sees the same operand stack whichever branch it was entered by.
+void branchToSlowPath(Frame* frame,
+                      SlowPathState* s,
+                      lir::TernaryOperation op,
+                      ir::Value* a,
+                      ir::Value* b)
 {
-  if (((field->flags() & ACC_STATIC) == 0) == shouldBeStatic) {
-    throwNew(t,
-             GcIncompatibleClassChangeError::Type,
-             "expected %s.%s to be %s",
-             field->class_()->name()->body().begin(),
-             field->name()->body().begin(),
-             shouldBeStatic ? "static" : "non-static");
+  avian::codegen::Compiler* c = frame->c;
+
+  c->condJump(
+      op, a, b, c->promiseConstant(c->machineIp(s->logicalIp), ir::Type::iptr()));
+
+  for (unsigned i = 0; i < s->argumentCount; ++i) {
+    c->save(s->arguments[i]->type, s->arguments[i]);
   }
+
+  s->branches = new (&(frame->context->zone))
+      List<Compiler::State*>(c->saveState(), s->branches);
 }
 
-bool isLambda(Thread* t,
-              GcClassLoader* loader,
-              GcCharArray* bootstrapArray,
-              GcInvocation* invocation)
+// Makes the slow path call the method whose address its thunk
+// returns, as an invokevirtual or invokeinterface of the specified
+// target would, so that both paths rejoin after the call.
+void callFromSlowPath(SlowPathState* s, GcMethod* target)
 {
-  GcMethod* bootstrap = cast<GcMethod>(t,
-                                       resolve(t,
-                                               loader,
-                                               invocation->pool(),
-                                               bootstrapArray->body()[0],
-                                               findMethodInClass,
-                                               GcNoSuchMethodError::Type));
-  PROTECT(t, bootstrap);
-
-  return vm::strcmp(reinterpret_cast<const int8_t*>(
-                        "java/lang/invoke/LambdaMetafactory"),
-                    bootstrap->class_()->name()->body().begin()) == 0
-         and vm::strcmp(reinterpret_cast<const int8_t*>("metafactory"),
-                        bootstrap->name()->body().begin()) == 0
-         and vm::strcmp(
-                 reinterpret_cast<const int8_t*>(
-                     "(Ljava/lang/invoke/MethodHandles$Lookup;Ljava/lang/"
-                     "String;Ljava/lang/invoke/MethodType;Ljava/lang/invoke/"
-                     "MethodType;Ljava/lang/invoke/MethodHandle;Ljava/lang/"
-                     "invoke/MethodType;)Ljava/lang/invoke/CallSite;"),
-                 bootstrap->spec()->body().begin()) == 0;
+  s->callFootprint = target->parameterFootprint();
+  s->callReturnCode = target->returnCode();
 }
 
-void compile(MyThread* t,
-             Frame* initialFrame,
-             unsigned initialIp,
-             int exceptionHandlerStart = -1)
+// Branches straight to the next instruction if "b op a" holds.  Only
+// instructions which leave the operand stack as they found it may do
+// this, subject to the same restriction as branchToSlowPath.
+void branchPastSlowPath(Frame* frame,
+                        SlowPathState* s,
+                        lir::TernaryOperation op,
+                        ir::Value* a,
+                        ir::Value* b)
 {
-  enum { Return, Unbranch, Unsubroutine, Untable0, Untable1, Unswitch };
+  assertT(frame->t, s->resultType == ir::Type::void_());
 
-  Frame* frame = initialFrame;
-  avian::codegen::Compiler* c = frame->c;
-  Context* context = frame->context;
-  unsigned stackSize = context->method->code()->maxStack();
-  Stack stack(t);
-  unsigned ip = initialIp;
-  unsigned newIp;
-  stack.pushValue(Return);
+  frame->c->condJump(op, a, b, frame->machineIpValue(s->nextIp));
 
-start:
-  ir::Type* stackMap
-      = static_cast<ir::Type*>(stack.push(stackSize * sizeof(ir::Type)));
-  frame = new (stack.push(sizeof(Frame))) Frame(frame, stackMap);
+  s->skips = new (&(frame->context->zone))
+      List<Compiler::State*>(frame->c->saveState(), s->skips);
+}
+
+// Emits a lookup of the specified interface method's implementation
+// in the interface method table of the specified class (see
+// VMClass.interfaceMethodTable), branching to the slow path if the
+// class has no table or the slot is empty or holds a method with some
+// other selector.  Names and descriptors are usually interned, so we
+// compare only their addresses and leave any which aren't to the slow
+// path.  Returns the class's vtable entry for the
+// implementation, so a method which has not been compiled yet is
+// compiled on first use just as for invokevirtual.
+ir::Value* lookupInterfaceMethodTable(Frame* frame,
+                                      SlowPathState* s,
+                                      ir::Value* class_,
+                                      GcMethod* target)
+{
+  MyThread* t = frame->t;
+  avian::codegen::Compiler* c = frame->c;
+
+  ir::Value* imt = c->load(
+      ir::ExtendMode::Signed,
+      c->memory(class_, ir::Type::object(), TargetClassInterfaceMethodTable),
+      ir::Type::object());
+
+  branchToSlowPath(
+      frame, s, lir::JumpIfEqual, c->constant(0, ir::Type::object()), imt);
+
+  ir::Value* method = c->load(
+      ir::ExtendMode::Signed,
+      c->memory(imt,
+                ir::Type::object(),
+                TargetArrayBody + (interfaceMethodTableIndex(t, target)
+                                   * TargetBytesPerWord)),
+      ir::Type::object());
+
+  branchToSlowPath(
+      frame, s, lir::JumpIfEqual, c->constant(0, ir::Type::object()), method);
+
+  branchToSlowPath(
+      frame,
+      s,
+      lir::JumpIfNotEqual,
+      frame->append(target->name()),
+      c->load(ir::ExtendMode::Signed,
+              c->memory(method, ir::Type::object(), TargetMethodName),
+              ir::Type::object()));
+
+  branchToSlowPath(
+      frame,
+      s,
+      lir::JumpIfNotEqual,
+      frame->append(target->spec()),
+      c->load(ir::ExtendMode::Signed,
+              c->memory(method, ir::Type::object(), TargetMethodSpec),
+              ir::Type::object()));
+
+  return c->memory(class_,
+                   ir::Type::iptr(),
+                   TargetClassVtable,
+                   c->load(ir::ExtendMode::Signed,
+                           c->memory(method, ir::Type::i2(), TargetMethodOffset),
+                           ir::Type::i4()));
+}
+
+// Calls the method at the specified address as the instruction the
+// specified slow path belongs to would (see callFromSlowPath).
+void slowPathCall(Frame* frame, SlowPathState* s, ir::Value* address)
+{
+  ir::Value* result = frame->c->stackCall(
+      address,
+      0,
+      frame->trace(0, 0),
+      operandTypeForFieldCode(frame->t, s->callReturnCode),
+      frame->peekMethodArguments(s->callFootprint));
+
+  frame->popFootprint(s->callFootprint);
+
+  if (s->callReturnCode != VoidField) {
+    frame->pushReturnValue(s->callReturnCode, result);
+  }
+}
+
+// Emits the specified slow path in the frame of the instruction it
+// belongs to, linking each branch to it and each branch past it.
+void compileSlowPath(MyThread* t, Frame* frame, SlowPathState* s)
+{
+  Context* context = frame->context;
+  avian::codegen::Compiler* c = frame->c;
+
+  List<Compiler::State*>* b = s->branches;
+  assertT(t, b);
+
+  c->restoreState(b->item);
+  c->startLogicalIp(s->logicalIp);
+
+  ir::Value* arguments[MaxSlowPathArguments + 1];
+  arguments[0] = c->threadRegister();
+  for (unsigned i = 0; i < s->argumentCount; ++i) {
+    arguments[i + 1] = s->arguments[i];
+  }
+
+  ir::Value* result = c->nativeCall(
+      c->constant(getThunk(t, s->thunk), ir::Type::iptr()),
+      0,
+      frame->trace(0, 0),
+      s->resultType,
+      Slice<ir::Value*>(arguments, s->argumentCount + 1));
+
+  if (s->callFootprint) {
+    slowPathCall(frame, s, result);
+  } else if (s->resultType != ir::Type::void_()) {
+    frame->push(s->resultType, result);
+  }
+
+  c->jmp(frame->machineIpValue(s->nextIp));
+
+  // the fast path has already compiled whatever follows:
+  assertT(t, context->visitTable[s->nextIp]);
+  ++context->visitTable[s->nextIp];
+  frame->visitLogicalIp(s->nextIp);
+
+  for (b = b->next; b; b = b->next) {
+    c->restoreState(b->item);
+    c->visitLogicalIp(s->logicalIp);
+  }
+
+  for (List<Compiler::State*>* k = s->skips; k; k = k->next) {
+    c->restoreState(k->item);
+    ++context->visitTable[s->nextIp];
+    frame->visitLogicalIp(s->nextIp);
+  }
+}
+
+// Emits the stub of a call site compiled by compileCachedInvoke, which
+// the site branches to whenever the receiver's class isn't the one
+// its direct call is bound to.  Until the site is bound, the stub
+// calls the thunk, which binds it (see bindInlineCache).  After that,
+// any other class means the site is polymorphic, and the stub
+// dispatches through the receiver's vtable, or for an interface
+// method through its interface method table, without leaving
+// compiled code.  Only when the latter can't answer (see
+// lookupInterfaceMethodTable) does it call the thunk, which then
+// finds the implementation the slow way.
+void compileInlineCacheStub(MyThread* t, Frame* frame, SlowPathState* s)
+{
+  Context* context = frame->context;
+  avian::codegen::Compiler* c = frame->c;
+
+  // the guard is the only branch here, so there is nothing to link:
+  assertT(t, s->branches and s->branches->next == 0 and s->skips == 0);
+
+  c->restoreState(s->branches->item);
+  c->startLogicalIp(s->logicalIp);
+
+  SlowPathState* thunkPath = new (&context->zone)
+      SlowPathState(context->addSlowPath(frame->ip),
+                    s->nextIp,
+                    s->thunk,
+                    s->resultType,
+                    Slice<ir::Value*>(s->arguments, s->argumentCount));
+
+  thunkPath->callFootprint = s->callFootprint;
+  thunkPath->callReturnCode = s->callReturnCode;
+
+  ir::Value* cache = s->arguments[0];
+  ir::Value* instance = s->arguments[1];
+
+  // dispatch in a frame of its own, so the thunk path starts from the
+  // operand stack as the instruction found it:
+  ir::Type* stackMap = static_cast<ir::Type*>(
+      context->zone.allocate(frame->stackSize() * sizeof(ir::Type)));
+  Frame dispatchFrame(frame, stackMap);
+
+  branchToSlowPath(&dispatchFrame,
+                   thunkPath,
+                   lir::JumpIfEqual,
+                   c->constant(InlineCacheEmpty, ir::Type::i4()),
+                   c->load(ir::ExtendMode::Unsigned,
+                           c->memory(cache,
+                                     ir::Type::i4(),
+                                     TargetInlineCacheState),
+                           ir::Type::i4()));
+
+  ir::Value* class_
+      = c->binaryOp(lir::And,
+                    ir::Type::iptr(),
+                    c->constant(TargetPointerMask, ir::Type::iptr()),
+                    c->memory(instance, ir::Type::object()));
+
+  GcMethod* target = cast<GcMethod>(t, s->cacheSite->cache->target());
+
+  ir::Value* address;
+  if (s->cacheSite->interface) {
+    address = lookupInterfaceMethodTable(
+        &dispatchFrame, thunkPath, class_, target);
+  } else {
+    address = c->memory(
+        class_,
+        ir::Type::iptr(),
+        TargetClassVtable + (target->offset() * TargetBytesPerWord));
+  }
+
+  slowPathCall(&dispatchFrame, s, address);
+
+  c->jmp(dispatchFrame.machineIpValue(s->nextIp));
+
+  ++context->visitTable[s->nextIp];
+  dispatchFrame.visitLogicalIp(s->nextIp);
+  dispatchFrame.dispose();
+
+  compileSlowPath(t, frame, thunkPath);
+}
+
+// Compiles an invokevirtual or invokeinterface of the specified
+// resolved method through an inline cache.  The site compares the
+// receiver's class with the one the cache is bound to and, if they
+// match, makes a direct call, which bindInlineCache patches to call
+// that class's implementation.  Any other receiver branches to an
+// out-of-line stub (see compileInlineCacheStub) which is emitted with
+// the other slow paths.  Returns the frame of the fast path, as
+// startFastPath does.
+Frame* compileCachedInvoke(MyThread* t,
+                           Stack* stack,
+                           Frame* frame,
+                           uintptr_t tag,
+                           unsigned nextIp,
+                           GcMethod* target,
+                           bool interface)
+{
+  Context* context = frame->context;
+  avian::codegen::Compiler* c = frame->c;
+
+  assertT(t, context->bootContext == 0);
+
+  PROTECT(t, target);
+
+  // the cache of a site with a direct call has no entries, since its
+  // stub goes to the receiver's tables instead:
+  GcInlineCache* cache
+      = makeInlineCache(t, context->method, target, 0, 0, 0, 0, 0, 0);
+
+  ir::Value* cacheValue = frame->append(cache);
+  ir::Value* instance = c->peek(1, target->parameterFootprint() - 1);
+
+  SlowPathState* slowPath;
+  frame = startFastPath(t,
+                        stack,
+                        frame,
+                        tag,
+                        nextIp,
+                        interface ? findInterfaceMethodFromCacheThunk
+                                  : findVirtualMethodFromCacheThunk,
+                        ir::Type::iptr(),
+                        args(cacheValue, instance),
+                        &slowPath);
+
+  callFromSlowPath(slowPath, target);
+
+  branchToSlowPath(
+      frame,
+      slowPath,
+      lir::JumpIfNotEqual,
+      c->binaryOp(lir::And,
+                  ir::Type::iptr(),
+                  c->constant(TargetPointerMask, ir::Type::iptr()),
+                  c->memory(instance, ir::Type::object())),
+      c->load(
+          ir::ExtendMode::Signed,
+          c->memory(cacheValue, ir::Type::iptr(), TargetInlineCacheReceiver),
+          ir::Type::iptr()));
+
+  // the call node this trace produces is only used if the call is made
+  // while it is being patched (see compileMethod2):
+  TraceElement* trace = frame->trace(target, TraceElement::VirtualCall);
+
+  frame->stackCall(c->constant(defaultThunk(t), ir::Type::iptr()),
+                   target,
+                   Compiler::Aligned,
+                   trace);
+
+  slowPath->cacheSite = context->inlineCacheSites = new (&context->zone)
+      InlineCacheSite(cache, trace, interface, context->inlineCacheSites);
+
+  return frame;
+}
+
+// Returns the depth of the specified class in the class hierarchy if
+// checkcast and instanceof may test against its supertype display
+// inline, or -1 if they must leave it to a thunk.  Interfaces and
+// array classes have no display.
+int inlineTypeCheckDepth(MyThread* t, Context* context, GcClass* class_)
+{
+  if (not context->fastPaths) {
+    return -1;
+  }
+
+  GcArray* supers = cast<GcArray>(t, class_->primarySupers());
+  return supers ? supers->length() - 1 : -1;
+}
+
+// Loads the entry at the specified depth in the supertype display of
+// the specified object's class, as a word-sized integer, branching to
+// the slow path if that class has no display.  If the display is too
+// short to reach the depth, which means the class can't be a subclass
+// of any class at that depth, java.lang.Object's entry is loaded
+// instead, so no further branch is needed.
+ir::Value* loadDisplayEntry(Frame* frame,
+                            SlowPathState* s,
+                            ir::Value* instance,
+                            unsigned depth)
+{
+  avian::codegen::Compiler* c = frame->c;
+
+  ir::Value* supers = c->load(
+      ir::ExtendMode::Signed,
+      c->memory(
+          c->binaryOp(lir::And,
+                      ir::Type::iptr(),
+                      c->constant(TargetPointerMask, ir::Type::iptr()),
+                      c->memory(instance, ir::Type::object())),
+          ir::Type::object(),
+          TargetClassPrimarySupers),
+      ir::Type::object());
+
+  branchToSlowPath(
+      frame, s, lir::JumpIfEqual, c->constant(0, ir::Type::object()), supers);
+
+  ir::Value* length
+      = c->load(ir::ExtendMode::Signed,
+                c->memory(supers, ir::Type::iptr(), TargetArrayLength),
+                ir::Type::i4());
+
+  // (depth - length) >> 31 is all ones if the display is long enough
+  // and zero otherwise:
+  ir::Value* index = c->binaryOp(
+      lir::And,
+      ir::Type::i4(),
+      c->constant(depth, ir::Type::i4()),
+      c->binaryOp(
+          lir::ShiftRight,
+          ir::Type::i4(),
+          c->constant(31, ir::Type::i4()),
+          c->binaryOp(lir::Subtract,
+                      ir::Type::i4(),
+                      length,
+                      c->constant(depth, ir::Type::i4()))));
+
+  ir::Type wordType
+      = TargetBytesPerWord == 8 ? ir::Type::i8() : ir::Type::i4();
+
+  return c->load(ir::ExtendMode::Signed,
+                 c->memory(supers, wordType, TargetArrayBody, index),
+                 wordType);
+}
+
+lir::TernaryOperation toCompilerBinaryOp(MyThread* t, unsigned instruction)
+{
+  switch (instruction) {
+  case iadd:
+  case ladd:
+    return lir::Add;
+  case ior:
+  case lor:
+    return lir::Or;
+  case ishl:
+  case lshl:
+    return lir::ShiftLeft;
+  case ishr:
+  case lshr:
+    return lir::ShiftRight;
+  case iushr:
+  case lushr:
+    return lir::UnsignedShiftRight;
+  case fadd:
+  case dadd:
+    return lir::FloatAdd;
+  case fsub:
+  case dsub:
+    return lir::FloatSubtract;
+  case fmul:
+  case dmul:
+    return lir::FloatMultiply;
+  case fdiv:
+  case ddiv:
+    return lir::FloatDivide;
+  case frem:
+  case vm::drem:
+    return lir::FloatRemainder;
+  case iand:
+  case land:
+    return lir::And;
+  case isub:
+  case lsub:
+    return lir::Subtract;
+  case ixor:
+  case lxor:
+    return lir::Xor;
+  case imul:
+  case lmul:
+    return lir::Multiply;
+  default:
+    abort(t);
+  }
+}
+
+uintptr_t aioobThunk(MyThread* t);
+
+uintptr_t stackOverflowThunk(MyThread* t);
+
+void checkField(Thread* t, GcField* field, bool shouldBeStatic)
+{
+  if (((field->flags() & ACC_STATIC) == 0) == shouldBeStatic) {
+    throwNew(t,
+             GcIncompatibleClassChangeError::Type,
+             "expected %s.%s to be %s",
+             field->class_()->name()->body().begin(),
+             field->name()->body().begin(),
+             shouldBeStatic ? "static" : "non-static");
+  }
+}
+
+bool isLambda(Thread* t,
+              GcClassLoader* loader,
+              GcCharArray* bootstrapArray,
+              GcInvocation* invocation)
+{
+  GcMethod* bootstrap = cast<GcMethod>(t,
+                                       resolve(t,
+                                               loader,
+                                               invocation->pool(),
+                                               bootstrapArray->body()[0],
+                                               findMethodInClass,
+                                               GcNoSuchMethodError::Type));
+  PROTECT(t, bootstrap);
+
+  return vm::strcmp(reinterpret_cast<const int8_t*>(
+                        "java/lang/invoke/LambdaMetafactory"),
+                    bootstrap->class_()->name()->body().begin()) == 0
+         and vm::strcmp(reinterpret_cast<const int8_t*>("metafactory"),
+                        bootstrap->name()->body().begin()) == 0
+         and vm::strcmp(
+                 reinterpret_cast<const int8_t*>(
+                     "(Ljava/lang/invoke/MethodHandles$Lookup;Ljava/lang/"
+                     "String;Ljava/lang/invoke/MethodType;Ljava/lang/invoke/"
+                     "MethodType;Ljava/lang/invoke/MethodHandle;Ljava/lang/"
+                     "invoke/MethodType;)Ljava/lang/invoke/CallSite;"),
+                 bootstrap->spec()->body().begin()) == 0;
+}
+
+void compile(MyThread* t,
+             Frame* initialFrame,
+             unsigned initialIp,
+             int exceptionHandlerStart = -1)
+{
+  enum {
+    Return,
+    Unbranch,
+    Unsubroutine,
+    Untable0,
+    Untable1,
+    Unswitch,
+    Unslow
+  };
+
+  Frame* frame = initialFrame;
+  avian::codegen::Compiler* c = frame->c;
+  Context* context = frame->context;
+  unsigned stackSize = context->method->code()->maxStack();
+  Stack stack(t);
+  unsigned ip = initialIp;
+  unsigned newIp;
+  stack.pushValue(Return);
+
+start:
+  ir::Type* stackMap
+      = static_cast<ir::Type*>(stack.push(stackSize * sizeof(ir::Type)));
+  frame = new (stack.push(sizeof(Frame))) Frame(frame, stackMap);
 
 loop:
   GcCode* code = context->method->code();
@@ -4144,7 +5490,7 @@ loop:
         frame->trace(0, 0);
       }
 
-      if (CheckArrayBounds) {
+      if (CheckArrayBounds and not context->inBoundsTable[ip - 1]) {
         c->checkBounds(array, TargetArrayLength, index, aioobThunk(t));
       }
 
@@ -4245,7 +5591,7 @@ loop:
         frame->trace(0, 0);
       }
 
-      if (CheckArrayBounds) {
+      if (CheckArrayBounds and not context->inBoundsTable[ip - 1]) {
         c->checkBounds(array, TargetArrayLength, index, aioobThunk(t));
       }
 
@@ -4435,6 +5781,37 @@ loop:
 
       ir::Value* instance = c->peek(1, 0);
 
+      int depth = class_ ? inlineTypeCheckDepth(t, context, class_) : -1;
+      if (depth >= 0) {
+        ir::Value* classValue = frame->append(argument);
+
+        SlowPathState* slowPath;
+        frame = startFastPath(t,
+                              &stack,
+                              frame,
+                              Unslow,
+                              ip,
+                              thunk,
+                              ir::Type::void_(),
+                              args(classValue, instance),
+                              &slowPath);
+
+        branchPastSlowPath(frame,
+                           slowPath,
+                           lir::JumpIfEqual,
+                           c->constant(0, ir::Type::object()),
+                           instance);
+
+        // anything but an exact match is left to the thunk, which
+        // throws if the cast really does fail:
+        branchToSlowPath(frame,
+                         slowPath,
+                         lir::JumpIfNotEqual,
+                         classValue,
+                         loadDisplayEntry(frame, slowPath, instance, depth));
+        break;
+      }
+
       c->nativeCall(
           c->constant(getThunk(t, thunk), ir::Type::iptr()),
           0,
@@ -4681,83 +6058,7 @@ loop:
           }
         }
 
-        switch (field->code()) {
-        case ByteField:
-        case BooleanField:
-          frame->push(ir::Type::i4(),
-                      c->load(ir::ExtendMode::Signed,
-                              c->memory(table,
-                                        ir::Type::i1(),
-                                        targetFieldOffset(context, field)),
-                              ir::Type::i4()));
-          break;
-
-        case CharField:
-          frame->push(ir::Type::i4(),
-                      c->load(ir::ExtendMode::Unsigned,
-                              c->memory(table,
-                                        ir::Type::i2(),
-                                        targetFieldOffset(context, field)),
-                              ir::Type::i4()));
-          break;
-
-        case ShortField:
-          frame->push(ir::Type::i4(),
-                      c->load(ir::ExtendMode::Signed,
-                              c->memory(table,
-                                        ir::Type::i2(),
-                                        targetFieldOffset(context, field)),
-                              ir::Type::i4()));
-          break;
-
-        case FloatField:
-          frame->push(ir::Type::f4(),
-                      c->load(ir::ExtendMode::Signed,
-                              c->memory(table,
-                                        ir::Type::f4(),
-                                        targetFieldOffset(context, field)),
-                              ir::Type::f4()));
-          break;
-
-        case IntField:
-          frame->push(ir::Type::i4(),
-                      c->load(ir::ExtendMode::Signed,
-                              c->memory(table,
-                                        ir::Type::i4(),
-                                        targetFieldOffset(context, field)),
-                              ir::Type::i4()));
-          break;
-
-        case DoubleField:
-          frame->pushLarge(ir::Type::f8(),
-                           c->load(ir::ExtendMode::Signed,
-                                   c->memory(table,
-                                             ir::Type::f8(),
-                                             targetFieldOffset(context, field)),
-                                   ir::Type::f8()));
-          break;
-
-        case LongField:
-          frame->pushLarge(ir::Type::i8(),
-                           c->load(ir::ExtendMode::Signed,
-                                   c->memory(table,
-                                             ir::Type::i8(),
-                                             targetFieldOffset(context, field)),
-                                   ir::Type::i8()));
-          break;
-
-        case ObjectField:
-          frame->push(ir::Type::object(),
-                      c->load(ir::ExtendMode::Signed,
-                              c->memory(table,
-                                        ir::Type::object(),
-                                        targetFieldOffset(context, field)),
-                              ir::Type::object()));
-          break;
-
-        default:
-          abort(t);
-        }
+        compileGetField(t, frame, table, field);
 
         if (field->flags() & ACC_VOLATILE) {
           if (TargetBytesPerWord == 4 and (field->code() == DoubleField
@@ -5090,6 +6391,57 @@ loop:
         thunk = instanceOfFromReferenceThunk;
       }
 
+      int depth = class_ ? inlineTypeCheckDepth(t, context, class_) : -1;
+      if (depth >= 0) {
+        ir::Value* classValue = frame->append(argument);
+
+        SlowPathState* slowPath;
+        frame = startFastPath(t,
+                              &stack,
+                              frame,
+                              Unslow,
+                              ip,
+                              thunk,
+                              ir::Type::i4(),
+                              args(classValue, instance),
+                              &slowPath);
+
+        branchToSlowPath(frame,
+                         slowPath,
+                         lir::JumpIfEqual,
+                         c->constant(0, ir::Type::object()),
+                         instance);
+
+        ir::Type wordType
+            = TargetBytesPerWord == 8 ? ir::Type::i8() : ir::Type::i4();
+
+        // x is zero exactly when the display entry is the class we're
+        // looking for, in which case (x | -x) is the only value here
+        // without its sign bit set:
+        ir::Value* x
+            = c->binaryOp(lir::Xor,
+                          wordType,
+                          classValue,
+                          loadDisplayEntry(frame, slowPath, instance, depth));
+
+        ir::Value* sign = c->binaryOp(
+            lir::UnsignedShiftRight,
+            wordType,
+            c->constant(TargetBitsPerWord - 1, ir::Type::i4()),
+            c->binaryOp(lir::Or, wordType, c->unaryOp(lir::Negate, x), x));
+
+        if (TargetBytesPerWord == 8) {
+          sign = c->truncate(ir::Type::i4(), sign);
+        }
+
+        frame->push(ir::Type::i4(),
+                    c->binaryOp(lir::Xor,
+                                ir::Type::i4(),
+                                c->constant(1, ir::Type::i4()),
+                                sign));
+        break;
+      }
+
       frame->push(
           ir::Type::i4(),
           c->nativeCall(
@@ -5293,7 +6645,6 @@ loop:
       GcMethod* target = resolveMethod(t, context->method, index - 1, false);
 
       object argument;
-      Thunk thunk;
       unsigned parameterFootprint;
       int returnCode;
       bool tailCall;
@@ -5301,7 +6652,6 @@ loop:
         checkMethod(t, target, false);
 
         argument = target;
-        thunk = findInterfaceMethodFromInstanceThunk;
         parameterFootprint = target->parameterFootprint();
         returnCode = target->returnCode();
         tailCall = isTailCall(t, code, ip, context->method, target);
@@ -5309,19 +6659,67 @@ loop:
         GcReference* ref = cast<GcReference>(t, reference);
         PROTECT(t, ref);
         argument = makePair(t, context->method, reference);
-        thunk = findInterfaceMethodFromInstanceAndReferenceThunk;
         parameterFootprint = methodReferenceParameterFootprint(t, ref, false);
         returnCode = methodReferenceReturnCode(t, ref);
         tailCall = isReferenceTailCall(t, code, ip, context->method, ref);
       }
 
-      unsigned rSize = resultSize(t, returnCode);
+      if (target and context->fastPaths and not tailCall
+          and context->bootContext == 0) {
+        frame = compileCachedInvoke(t, &stack, frame, Unslow, ip, target, true);
+        break;
+      }
 
-      ir::Value* result = c->stackCall(
-          c->nativeCall(c->constant(getThunk(t, thunk), ir::Type::iptr()),
-                        0,
-                        frame->trace(0, 0),
-                        ir::Type::iptr(),
+      Thunk thunk;
+      if (context->bootContext) {
+        // inline caches are updated at runtime, which we can't do for
+        // objects in a boot image's heap, so we dispatch without one:
+        thunk = target ? findInterfaceMethodFromInstanceThunk
+                       : findInterfaceMethodFromInstanceAndReferenceThunk;
+      } else {
+        argument = makeInlineCache(t, context->method, argument);
+        thunk = findInterfaceMethodFromCacheThunk;
+      }
+
+      if (target and context->fastPaths and not tailCall) {
+        // without an inline cache, we still try the receiver's
+        // interface method table before the thunk:
+        ir::Value* argumentValue = frame->append(argument);
+        ir::Value* instance = c->peek(1, parameterFootprint - 1);
+        ir::Value* classValue = c->binaryOp(
+            lir::And,
+            ir::Type::iptr(),
+            c->constant(TargetPointerMask, ir::Type::iptr()),
+            c->memory(instance, ir::Type::object()));
+
+        SlowPathState* slowPath;
+        frame = startFastPath(t,
+                              &stack,
+                              frame,
+                              Unslow,
+                              ip,
+                              thunk,
+                              ir::Type::iptr(),
+                              args(argumentValue, instance),
+                              &slowPath);
+
+        callFromSlowPath(slowPath, target);
+
+        frame->stackCall(
+            lookupInterfaceMethodTable(frame, slowPath, classValue, target),
+            target,
+            0,
+            frame->trace(0, 0));
+        break;
+      }
+
+      unsigned rSize = resultSize(t, returnCode);
+
+      ir::Value* result = c->stackCall(
+          c->nativeCall(c->constant(getThunk(t, thunk), ir::Type::iptr()),
+                        0,
+                        frame->trace(0, 0),
+                        ir::Type::iptr(),
                         args(c->threadRegister(),
                              frame->append(argument),
                              c->peek(1, parameterFootprint - 1))),
@@ -5362,7 +6760,7 @@ loop:
         if (UNLIKELY(methodAbstract(t, target))) {
           compileDirectAbstractInvoke(
               t, frame, getMethodAddressThunk, target, tailCall);
-        } else {
+        } else if (not specialIntrinsic(t, frame, target)) {
           compileDirectInvoke(t, frame, target, tailCall);
         }
       } else {
@@ -5428,7 +6826,18 @@ loop:
         if (not intrinsic(t, frame, target)) {
           bool tailCall = isTailCall(t, code, ip, context->method, target);
 
-          if (LIKELY(methodVirtual(t, target))) {
+          if (((target->flags() & ACC_FINAL)
+               or (target->class_()->flags() & ACC_FINAL))
+              and compileInlinedGetter(t, frame, target)) {
+            // a final getter can't be overridden, so we've inlined it
+          } else if (LIKELY(methodVirtual(t, target))) {
+            if (context->fastPaths and not tailCall
+                and context->bootContext == 0) {
+              frame = compileCachedInvoke(
+                  t, &stack, frame, Unslow, ip, target, false);
+              break;
+            }
+
             unsigned parameterFootprint = target->parameterFootprint();
 
             unsigned offset = TargetClassVtable
@@ -5460,18 +6869,27 @@ loop:
         PROTECT(t, reference);
         PROTECT(t, ref);
 
-        GcPair* pair = makePair(t, context->method, reference);
+        object argument = makePair(t, context->method, reference);
+
+        Thunk thunk;
+        if (context->bootContext) {
+          // see invokeinterface for why we don't use an inline cache
+          // here
+          thunk = findVirtualMethodFromReferenceThunk;
+        } else {
+          argument = makeInlineCache(t, context->method, argument);
+          thunk = findVirtualMethodFromCacheThunk;
+        }
 
         compileReferenceInvoke(
             frame,
             c->nativeCall(
-                c->constant(getThunk(t, findVirtualMethodFromReferenceThunk),
-                            ir::Type::iptr()),
+                c->constant(getThunk(t, thunk), ir::Type::iptr()),
                 0,
                 frame->trace(0, 0),
                 ir::Type::iptr(),
                 args(c->threadRegister(),
-                     frame->append(pair),
+                     frame->append(argument),
                      c->peek(1,
                              methodReferenceParameterFootprint(t, ref, false)
                              - 1))),
@@ -5960,6 +7378,8 @@ loop:
         argument = class_;
         if (class_->vmFlags() & (WeakReferenceFlag | HasFinalizerFlag)) {
           thunk = makeNewGeneral64Thunk;
+        } else if (classInitialized(t, class_)) {
+          thunk = makeNewInitialized64Thunk;
         } else {
           thunk = makeNew64Thunk;
         }
@@ -5968,6 +7388,41 @@ loop:
         thunk = makeNewFromReferenceThunk;
       }
 
+      if (thunk == makeNewInitialized64Thunk and inlineAllocation(t, context)) {
+        ir::Value* instanceClass = frame->append(argument);
+        ir::Value* index = loadThreadInt(c, TARGET_THREAD_HEAPINDEX);
+        ir::Value* newIndex = c->binaryOp(
+            lir::Add,
+            ir::Type::i4(),
+            c->constant(ceilingDivide(class_->fixedSize(), TargetBytesPerWord),
+                        ir::Type::i4()),
+            index);
+
+        c->save(ir::Type::i4(), index);
+        c->save(ir::Type::i4(), newIndex);
+
+        SlowPathState* slowPath;
+        frame = startFastPath(t,
+                              &stack,
+                              frame,
+                              Unslow,
+                              ip,
+                              thunk,
+                              ir::Type::object(),
+                              args(instanceClass),
+                              &slowPath);
+
+        branchToSlowPath(frame,
+                         slowPath,
+                         lir::JumpIfGreater,
+                         loadThreadInt(c, TARGET_THREAD_HEAPLIMIT),
+                         newIndex);
+
+        frame->push(ir::Type::object(),
+                    allocateInline(frame, index, newIndex, instanceClass));
+        break;
+      }
+
       frame->push(
           ir::Type::object(),
           c->nativeCall(c->constant(getThunk(t, thunk), ir::Type::iptr()),
@@ -5982,6 +7437,78 @@ loop:
 
       ir::Value* length = frame->pop(ir::Type::i4());
 
+      if (inlineAllocation(t, context)) {
+        unsigned shift;
+        ir::Value* arrayClass
+            = frame->append(primitiveArrayClass(t, type, &shift));
+
+        // lengths outside [0, 2^16) are left to the thunk, which
+        // throws if the length is negative.  Anything smaller can't
+        // overflow the size computation below:
+        SlowPathState* slowPath;
+        frame = startFastPath(t,
+                              &stack,
+                              frame,
+                              Unslow,
+                              ip,
+                              makeBlankArrayThunk,
+                              ir::Type::object(),
+                              args(c->constant(type, ir::Type::i4()), length),
+                              &slowPath);
+
+        branchToSlowPath(frame,
+                         slowPath,
+                         lir::JumpIfNotEqual,
+                         c->constant(0, ir::Type::i4()),
+                         c->binaryOp(lir::UnsignedShiftRight,
+                                     ir::Type::i4(),
+                                     c->constant(16, ir::Type::i4()),
+                                     length));
+
+        ir::Value* bytes
+            = shift ? c->binaryOp(lir::ShiftLeft,
+                                  ir::Type::i4(),
+                                  c->constant(shift, ir::Type::i4()),
+                                  length)
+                    : length;
+
+        ir::Value* index = loadThreadInt(c, TARGET_THREAD_HEAPINDEX);
+        ir::Value* newIndex = c->binaryOp(
+            lir::Add,
+            ir::Type::i4(),
+            c->binaryOp(
+                lir::ShiftRight,
+                ir::Type::i4(),
+                c->constant(TargetBytesPerWord == 8 ? 3 : 2, ir::Type::i4()),
+                c->binaryOp(lir::Add,
+                            ir::Type::i4(),
+                            c->constant(TargetArrayBody + TargetBytesPerWord
+                                        - 1,
+                                        ir::Type::i4()),
+                            bytes)),
+            index);
+
+        c->save(ir::Type::i4(), index);
+        c->save(ir::Type::i4(), newIndex);
+
+        branchToSlowPath(frame,
+                         slowPath,
+                         lir::JumpIfGreater,
+                         loadThreadInt(c, TARGET_THREAD_HEAPLIMIT),
+                         newIndex);
+
+        ir::Value* array = allocateInline(frame, index, newIndex, arrayClass);
+
+        c->store(c->truncateThenExtend(ir::ExtendMode::Signed,
+                                       ir::Type::iptr(),
+                                       ir::Type::i4(),
+                                       length),
+                 c->memory(array, ir::Type::iptr(), TargetArrayLength));
+
+        frame->push(ir::Type::object(), array);
+        break;
+      }
+
       frame->push(ir::Type::object(),
                   c->nativeCall(c->constant(getThunk(t, makeBlankArrayThunk),
                                             ir::Type::iptr()),
@@ -6479,6 +8006,25 @@ next:
   }
     goto switchloop;
 
+  case Unslow: {
+    if (DebugInstructions) {
+      fprintf(stderr, "Unslow\n");
+    }
+    SlowPathState* s
+        = static_cast<SlowPathState*>(stack.peek(sizeof(SlowPathState)));
+
+    frame = s->frame();
+
+    if (s->cacheSite) {
+      compileInlineCacheStub(t, frame, s);
+    } else {
+      compileSlowPath(t, frame, s);
+    }
+
+    stack.pop(sizeof(SlowPathState));
+  }
+    goto next;
+
   case Unsubroutine: {
     if (DebugInstructions) {
       fprintf(stderr, "Unsubroutine\n");
@@ -6602,6 +8148,33 @@ GcLineNumberTable* truncateLineNumberTable(Thread* t,
   return newTable;
 }
 
+object exceptionHandlerClass(MyThread* t, Context* context, uint64_t handler)
+{
+  if (exceptionHandlerCatchType(handler)) {
+    return resolveClassInPool(
+        t, context->method, exceptionHandlerCatchType(handler) - 1);
+  } else {
+    return 0;
+  }
+}
+
+bool exceptionHandlerCovers(uint64_t handler, unsigned ip)
+{
+  return ip >= exceptionHandlerStart(handler)
+         and ip < exceptionHandlerEnd(handler);
+}
+
+// Returns the machine code offset at which the out-of-line slow path
+// with the specified index ends.
+intptr_t slowPathEnd(Context* context, unsigned index, intptr_t end)
+{
+  return index + 1 < context->slowPathIps.count
+             ? context->compiler->machineIp(
+                                    context->method->code()->length() + index
+                                    + 1)->value()
+             : end;
+}
+
 GcArray* translateExceptionHandlerTable(MyThread* t,
                                         Context* context,
                                         intptr_t start,
@@ -6616,18 +8189,43 @@ GcArray* translateExceptionHandlerTable(MyThread* t,
     PROTECT(t, oldTable);
 
     unsigned length = oldTable->length();
+    unsigned codeLength = context->method->code()->length();
+
+    // out-of-line slow paths follow the bytecode in the machine code,
+    // so each gets its own entry for each handler covering the
+    // instruction it belongs to:
+    unsigned slowPathEntries = 0;
+    for (unsigned si = 0; si < context->slowPathIps.count; ++si) {
+      for (unsigned oi = 0; oi < length; ++oi) {
+        if (exceptionHandlerCovers(oldTable->body()[oi],
+                                   context->slowPathIps[si])) {
+          ++slowPathEntries;
+        }
+      }
+    }
 
-    GcIntArray* newIndex
-        = makeIntArray(t, length * (context->subroutineCount + 1) * 3);
+    intptr_t codeEnd = context->slowPathIps.count
+                           ? c->machineIp(codeLength)->value()
+                           : end;
+
+    unsigned capacity = (length * (context->subroutineCount + 1))
+                        + slowPathEntries;
+
+    // the index starts with the lowest start and highest end offset of
+    // all the handlers, followed by the start, end, and handler
+    // offsets of each one (see findExceptionHandler):
+    GcIntArray* newIndex = makeIntArray(t, 2 + (capacity * 3));
     PROTECT(t, newIndex);
 
-    GcArray* newTable
-        = makeArray(t, length * (context->subroutineCount + 1) + 1);
+    unsigned lowest = ~static_cast<unsigned>(0);
+    unsigned highest = 0;
+
+    GcArray* newTable = makeArray(t, capacity + 1);
     PROTECT(t, newTable);
 
     unsigned ni = 0;
     for (unsigned subI = 0; subI <= context->subroutineCount; ++subI) {
-      unsigned duplicatedBaseIp = subI * context->method->code()->length();
+      unsigned duplicatedBaseIp = subI * codeLength;
 
       for (unsigned oi = 0; oi < length; ++oi) {
         uint64_t oldHandler = oldTable->body()[oi];
@@ -6640,7 +8238,7 @@ GcArray* translateExceptionHandlerTable(MyThread* t,
         if (LIKELY(handlerStart >= 0)) {
           assertT(t,
                   handlerStart
-                  < static_cast<int>(context->method->code()->length()
+                  < static_cast<int>(codeLength
                                      * (context->subroutineCount + 1)));
 
           int handlerEnd = resolveIpBackwards(
@@ -6649,30 +8247,52 @@ GcArray* translateExceptionHandlerTable(MyThread* t,
               duplicatedBaseIp + exceptionHandlerStart(oldHandler));
 
           assertT(t, handlerEnd >= 0);
-          assertT(
-              t,
-              handlerEnd <= static_cast<int>(context->method->code()->length()
-                                             * (context->subroutineCount + 1)));
+          assertT(t,
+                  handlerEnd <= static_cast<int>(
+                                    codeLength
+                                    * (context->subroutineCount + 1)));
 
-          newIndex->body()[ni * 3] = c->machineIp(handlerStart)->value()
-                                     - start;
+          unsigned machineStart = c->machineIp(handlerStart)->value() - start;
 
-          newIndex->body()[(ni * 3) + 1]
-              = (handlerEnd
-                     == static_cast<int>(context->method->code()->length())
-                     ? end
+          unsigned machineEnd
+              = (handlerEnd == static_cast<int>(codeLength)
+                     ? codeEnd
                      : c->machineIp(handlerEnd)->value()) - start;
 
-          newIndex->body()[(ni * 3) + 2]
+          newIndex->body()[2 + (ni * 3)] = machineStart;
+          newIndex->body()[2 + (ni * 3) + 1] = machineEnd;
+          newIndex->body()[2 + (ni * 3) + 2]
               = c->machineIp(exceptionHandlerIp(oldHandler))->value() - start;
 
-          object type;
-          if (exceptionHandlerCatchType(oldHandler)) {
-            type = resolveClassInPool(
-                t, context->method, exceptionHandlerCatchType(oldHandler) - 1);
-          } else {
-            type = 0;
-          }
+          lowest = avian::util::min(lowest, machineStart);
+          highest = avian::util::max(highest, machineEnd);
+
+          object type = exceptionHandlerClass(t, context, oldHandler);
+
+          newTable->setBodyElement(t, ni + 1, type);
+
+          ++ni;
+        }
+      }
+    }
+
+    for (unsigned si = 0; si < context->slowPathIps.count; ++si) {
+      unsigned machineStart = c->machineIp(codeLength + si)->value() - start;
+      unsigned machineEnd = slowPathEnd(context, si, end) - start;
+
+      for (unsigned oi = 0; oi < length; ++oi) {
+        uint64_t oldHandler = oldTable->body()[oi];
+
+        if (exceptionHandlerCovers(oldHandler, context->slowPathIps[si])) {
+          newIndex->body()[2 + (ni * 3)] = machineStart;
+          newIndex->body()[2 + (ni * 3) + 1] = machineEnd;
+          newIndex->body()[2 + (ni * 3) + 2]
+              = c->machineIp(exceptionHandlerIp(oldHandler))->value() - start;
+
+          lowest = avian::util::min(lowest, machineStart);
+          highest = avian::util::max(highest, machineEnd);
+
+          object type = exceptionHandlerClass(t, context, oldHandler);
 
           newTable->setBodyElement(t, ni + 1, type);
 
@@ -6681,11 +8301,14 @@ GcArray* translateExceptionHandlerTable(MyThread* t,
       }
     }
 
-    if (UNLIKELY(ni < length)) {
-      newIndex = truncateIntArray(t, newIndex, ni * 3);
+    if (UNLIKELY(ni < capacity)) {
+      newIndex = truncateIntArray(t, newIndex, 2 + (ni * 3));
       newTable = truncateArray(t, newTable, ni + 1);
     }
 
+    newIndex->body()[0] = lowest;
+    newIndex->body()[1] = highest;
+
     newTable->setBodyElement(t, 0, newIndex);
 
     return newTable;
@@ -6703,7 +8326,8 @@ GcLineNumberTable* translateLineNumberTable(MyThread* t,
     PROTECT(t, oldTable);
 
     unsigned length = oldTable->length();
-    GcLineNumberTable* newTable = makeLineNumberTable(t, length);
+    unsigned capacity = length + context->slowPathIps.count;
+    GcLineNumberTable* newTable = makeLineNumberTable(t, capacity);
     unsigned ni = 0;
     for (unsigned oi = 0; oi < length; ++oi) {
       uint64_t oldLine = oldTable->body()[oi];
@@ -6721,7 +8345,24 @@ GcLineNumberTable* translateLineNumberTable(MyThread* t,
       }
     }
 
-    if (UNLIKELY(ni < length)) {
+    // give each out-of-line slow path the line of the instruction it
+    // belongs to:
+    for (unsigned si = 0; si < context->slowPathIps.count; ++si) {
+      unsigned ip = context->slowPathIps[si];
+      unsigned oi = 0;
+      while (oi + 1 < length and lineNumberIp(oldTable->body()[oi + 1]) <= ip) {
+        ++oi;
+      }
+
+      if (length and lineNumberIp(oldTable->body()[oi]) <= ip) {
+        newTable->body()[ni++] = lineNumber(
+            context->compiler->machineIp(context->method->code()->length()
+                                         + si)->value() - start,
+            lineNumberLine(oldTable->body()[oi]));
+      }
+    }
+
+    if (UNLIKELY(ni < capacity)) {
       newTable = truncateLineNumberTable(t, newTable, ni);
     }
 
@@ -6951,19 +8592,6 @@ exit:
   return eventIndex;
 }
 
-int compareTraceElementPointers(const void* va, const void* vb)
-{
-  TraceElement* a = *static_cast<TraceElement* const*>(va);
-  TraceElement* b = *static_cast<TraceElement* const*>(vb);
-  if (a->address->value() > b->address->value()) {
-    return 1;
-  } else if (a->address->value() < b->address->value()) {
-    return -1;
-  } else {
-    return 0;
-  }
-}
-
 uint8_t* finish(MyThread* t,
                 FixedAllocator* allocator,
                 avian::codegen::Assembler* a,
@@ -7024,241 +8652,1115 @@ void copyFrameMap(int32_t* dst,
   }
 }
 
-class FrameMapTableHeader {
- public:
-  FrameMapTableHeader(unsigned indexCount) : indexCount(indexCount)
-  {
+unsigned frameMapBucket(int32_t offset, unsigned bucketCount)
+{
+  return (static_cast<uint32_t>(offset) * 2654435761U) & (bucketCount - 1);
+}
+
+// A frame map table has the following layout, in 32-bit words:
+//
+//   the number of buckets, b, a power of two
+//   b pairs of (machine code offset of a call site, index of its map),
+//     open-addressed by frameMapBucket, with an offset of -1 marking
+//     an empty bucket
+//   the maps, each padded to a whole number of words
+//
+// The stack visitor finds a call site's map by hashing its return
+// address offset rather than searching a sorted list of offsets.
+// Call sites sharing the same set of live references share a single
+// map, and since each map starts on a word boundary, the stack
+// visitor can skip over words with no live references at all.
+GcIntArray* makeFrameMapTable(MyThread* t,
+                              Context* context,
+                              uint8_t* start,
+                              TraceElement** elements,
+                              unsigned elementCount)
+{
+  unsigned mapSize = frameMapSizeInBits(t, context->method);
+  unsigned mapSizeInWords = ceilingDivide(mapSize, 32);
+
+  int32_t* maps = static_cast<int32_t*>(context->zone.allocate(
+      elementCount * mapSizeInWords * sizeof(int32_t)));
+  uint32_t* hashes = static_cast<uint32_t*>(
+      context->zone.allocate(elementCount * sizeof(uint32_t)));
+
+  // open-addressed table of distinct maps keyed by hash, holding each
+  // map's index plus one so that zero marks an empty bucket
+  unsigned bucketCount = nextPowerOfTwo(elementCount * 2);
+  unsigned* buckets = static_cast<unsigned*>(
+      context->zone.allocate(bucketCount * sizeof(unsigned)));
+  memset(buckets, 0, bucketCount * sizeof(unsigned));
+
+  unsigned* mapIndexes = static_cast<unsigned*>(
+      context->zone.allocate(elementCount * sizeof(unsigned)));
+  unsigned mapCount = 0;
+
+  for (unsigned i = 0; i < elementCount; ++i) {
+    TraceElement* p = elements[i];
+
+    int32_t* map = maps + (mapCount * mapSizeInWords);
+    memset(map, 0, mapSizeInWords * sizeof(int32_t));
+
+    if (mapSize) {
+      copyFrameMap(map, p->map, mapSize, 0, p);
+    }
+
+    uint32_t hash = 0;
+    for (unsigned j = 0; j < mapSizeInWords; ++j) {
+      hash = (hash * 31) + map[j];
+    }
+
+    unsigned bucket = hash & (bucketCount - 1);
+    while (buckets[bucket]
+           and (hashes[buckets[bucket] - 1] != hash
+                or memcmp(maps + ((buckets[bucket] - 1) * mapSizeInWords),
+                          map,
+                          mapSizeInWords * sizeof(int32_t)) != 0)) {
+      bucket = (bucket + 1) & (bucketCount - 1);
+    }
+
+    if (buckets[bucket] == 0) {
+      hashes[mapCount++] = hash;
+      buckets[bucket] = mapCount;
+    }
+
+    mapIndexes[i] = buckets[bucket] - 1;
   }
 
-  unsigned indexCount;
-};
+  // at most half full, so that a lookup usually probes one bucket:
+  unsigned siteBucketCount = nextPowerOfTwo(elementCount * 2);
 
-class FrameMapTableIndexElement {
- public:
-  FrameMapTableIndexElement(int offset, unsigned base, unsigned path)
-      : offset(offset), base(base), path(path)
-  {
+  GcIntArray* table = makeIntArray(
+      t, 1 + (siteBucketCount * 2) + (mapCount * mapSizeInWords));
+
+  table->body()[0] = siteBucketCount;
+
+  int32_t* sites = &table->body()[1];
+  for (unsigned i = 0; i < siteBucketCount; ++i) {
+    sites[i * 2] = -1;
   }
 
-  int offset;
-  unsigned base;
-  unsigned path;
-};
+  for (unsigned i = 0; i < elementCount; ++i) {
+    int32_t offset = static_cast<intptr_t>(elements[i]->address->value())
+                     - reinterpret_cast<intptr_t>(start);
+
+    unsigned bucket = frameMapBucket(offset, siteBucketCount);
+    while (sites[bucket * 2] != -1) {
+      bucket = (bucket + 1) & (siteBucketCount - 1);
+    }
+
+    sites[bucket * 2] = offset;
+    sites[(bucket * 2) + 1] = mapIndexes[i];
+  }
+
+  if (mapCount * mapSizeInWords) {
+    memcpy(&table->body()[1 + (siteBucketCount * 2)],
+           maps,
+           mapCount * mapSizeInWords * sizeof(int32_t));
+  }
+
+  return table;
+}
+
+void insertCallNode(MyThread* t, GcCallNode* node);
+
+void finish(MyThread* t, FixedAllocator* allocator, Context* context)
+{
+  avian::codegen::Compiler* c = context->compiler;
+
+  if (false) {
+    logCompile(
+        t,
+        0,
+        0,
+        reinterpret_cast<const char*>(
+            context->method->class_()->name()->body().begin()),
+        reinterpret_cast<const char*>(context->method->name()->body().begin()),
+        reinterpret_cast<const char*>(context->method->spec()->body().begin()));
+  }
+
+  // for debugging:
+  if (false
+      and ::strcmp(reinterpret_cast<const char*>(
+                       context->method->class_()->name()->body().begin()),
+                   "java/lang/System") == 0
+      and ::strcmp(reinterpret_cast<const char*>(
+                       context->method->name()->body().begin()),
+                   "<clinit>") == 0) {
+    trap();
+  }
+
+  // the caller must hold the class lock from here on, since we're
+  // about to allocate from the shared executable area and update the
+  // global call and object pool tables.  Code generation proper
+  // (Compiler::compile) has already been done without it.
+
+  unsigned codeSize = c->resolve(allocator->memory.begin() + allocator->offset);
+
+  unsigned total = pad(codeSize, TargetBytesPerWord)
+                   + pad(c->poolSize(), TargetBytesPerWord);
+
+  target_uintptr_t* code = static_cast<target_uintptr_t*>(
+      allocator->allocate(total, TargetBytesPerWord));
+  uint8_t* start = reinterpret_cast<uint8_t*>(code);
+
+  context->executableAllocator = allocator;
+  context->executableStart = code;
+  context->executableSize = total;
+
+  if (context->objectPool) {
+    object pool = allocate3(
+        t,
+        allocator,
+        Machine::ImmortalAllocation,
+        GcArray::FixedSize + ((context->objectPoolCount + 1) * BytesPerWord),
+        true);
+
+    context->executableSize = (allocator->memory.begin() + allocator->offset)
+                              - static_cast<uint8_t*>(context->executableStart);
+
+    initArray(
+        t, reinterpret_cast<GcArray*>(pool), context->objectPoolCount + 1);
+    mark(t, pool, 0);
+
+    setField(t, pool, ArrayBody, compileRoots(t)->objectPools());
+    compileRoots(t)->setObjectPools(t, pool);
+
+    unsigned i = 1;
+    for (PoolElement* p = context->objectPool; p; p = p->next) {
+      unsigned offset = ArrayBody + ((i++) * BytesPerWord);
+
+      p->address = reinterpret_cast<uintptr_t>(pool) + offset;
+
+      setField(t, pool, offset, p->target);
+    }
+  }
+
+  c->write();
+
+  BootContext* bc = context->bootContext;
+  if (bc) {
+    for (avian::codegen::DelayedPromise* p = bc->addresses;
+         p != bc->addressSentinal;
+         p = p->next) {
+      p->basis = new (bc->zone)
+          avian::codegen::ResolvedPromise(p->basis->value());
+    }
+  }
 
-class FrameMapTablePath {
- public:
-  FrameMapTablePath(unsigned stackIndex, unsigned elementCount, unsigned next)
-      : stackIndex(stackIndex), elementCount(elementCount), next(next)
   {
+    GcArray* newExceptionHandlerTable = translateExceptionHandlerTable(
+        t,
+        context,
+        reinterpret_cast<intptr_t>(start),
+        reinterpret_cast<intptr_t>(start) + codeSize);
+
+    PROTECT(t, newExceptionHandlerTable);
+
+    GcLineNumberTable* newLineNumberTable = translateLineNumberTable(
+        t, context, reinterpret_cast<intptr_t>(start));
+
+    GcCode* code = context->method->code();
+
+    code = makeCode(t,
+                    0,
+                    0,
+                    newExceptionHandlerTable,
+                    newLineNumberTable,
+                    0,
+                    reinterpret_cast<uintptr_t>(start),
+                    codeSize,
+                    code->maxStack(),
+                    code->maxLocals(),
+                    0);
+
+    context->method->setCode(t, code);
   }
 
-  unsigned stackIndex;
-  unsigned elementCount;
-  unsigned next;
-  int32_t elements[0];
-};
+  if (context->traceLogCount) {
+    THREAD_RUNTIME_ARRAY(t, TraceElement*, elements, context->traceLogCount);
+    unsigned index = 0;
+    // unsigned pathFootprint = 0;
+    // unsigned mapCount = 0;
+    for (TraceElement* p = context->traceLog; p; p = p->next) {
+      assertT(t, index < context->traceLogCount);
 
-GcIntArray* makeSimpleFrameMapTable(MyThread* t,
-                                    Context* context,
-                                    uint8_t* start,
-                                    TraceElement** elements,
-                                    unsigned elementCount)
+      if (p->address) {
+        RUNTIME_ARRAY_BODY(elements)[index++] = p;
+
+        if (p->target) {
+          insertCallNode(
+              t, makeCallNode(t, p->address->value(), p->target, p->flags, 0));
+        }
+      }
+    }
+
+    GcIntArray* map = makeFrameMapTable(
+        t, context, start, RUNTIME_ARRAY_BODY(elements), index);
+
+    context->method->code()->setStackMap(t, map);
+  }
+
+  for (InlineCacheSite* s = context->inlineCacheSites; s; s = s->next) {
+    if (s->trace->address) {
+      s->cache->returnAddress() = s->trace->address->value();
+    }
+  }
+
+  logCompile(
+      t,
+      start,
+      codeSize,
+      reinterpret_cast<const char*>(
+          context->method->class_()->name()->body().begin()),
+      reinterpret_cast<const char*>(context->method->name()->body().begin()),
+      reinterpret_cast<const char*>(context->method->spec()->body().begin()));
+
+  // for debugging:
+  if (false
+      and ::strcmp(reinterpret_cast<const char*>(
+                       context->method->class_()->name()->body().begin()),
+                   "java/lang/System") == 0
+      and ::strcmp(reinterpret_cast<const char*>(
+                       context->method->name()->body().begin()),
+                   "<clinit>") == 0) {
+    trap();
+  }
+  syncInstructionCache(start, codeSize);
+}
+
+// Bounds check elimination
+//
+// The following finds counted loops of the shape javac generates for
+//
+//   for (int i = <non-negative constant>; i < a.length; ++i) { ... }
+//
+// where neither i nor a is assigned in the body except by the final
+// increment, and the loop can only be entered from the top.  Each
+// iteration starts by loading a.length (which also null-checks a) and
+// comparing it to i, and i starts non-negative and only counts up, so
+// every a[i] in the body is in bounds.  We record the ips of those
+// accesses in Context::inBoundsTable and compile them without checks.
+//
+// To find the accesses, we track which operand stack slots hold a and
+// i through a simple abstract interpretation of the loop body,
+// forgetting what we know at each branch target.  Anything we don't
+// understand makes us give up on that loop, leaving its checks alone.
+
+enum StackOrigin { OtherOrigin, ArrayOrigin, IndexOrigin };
+
+unsigned instructionLength(Thread* t, GcCode* code, unsigned ip)
 {
-  unsigned mapSize = frameMapSizeInBits(t, context->method);
-  GcIntArray* table = makeIntArray(
-      t, elementCount + ceilingDivide(elementCount * mapSize, 32));
+  switch (code->body()[ip]) {
+  case aload:
+  case astore:
+  case bipush:
+  case dload:
+  case dstore:
+  case fload:
+  case fstore:
+  case iload:
+  case istore:
+  case ldc:
+  case lload:
+  case lstore:
+  case newarray:
+  case ret:
+    return 2;
+
+  case anewarray:
+  case checkcast:
+  case getfield:
+  case getstatic:
+  case goto_:
+  case if_acmpeq:
+  case if_acmpne:
+  case if_icmpeq:
+  case if_icmpne:
+  case if_icmplt:
+  case if_icmpge:
+  case if_icmpgt:
+  case if_icmple:
+  case ifeq:
+  case ifne:
+  case iflt:
+  case ifge:
+  case ifgt:
+  case ifle:
+  case ifnonnull:
+  case ifnull:
+  case iinc:
+  case instanceof:
+  case invokespecial:
+  case invokestatic:
+  case invokevirtual:
+  case jsr:
+  case ldc_w:
+  case ldc2_w:
+  case new_:
+  case putfield:
+  case putstatic:
+  case sipush:
+    return 3;
+
+  case multianewarray:
+    return 4;
+
+  case goto_w:
+  case invokedynamic:
+  case invokeinterface:
+  case jsr_w:
+    return 5;
+
+  case wide:
+    return code->body()[ip + 1] == iinc ? 6 : 4;
+
+  case tableswitch: {
+    unsigned p = ((ip + 4) & ~3) + 4;
+    int32_t bottom = codeReadInt32(t, code, p);
+    int32_t top = codeReadInt32(t, code, p);
+    return p + ((top - bottom + 1) * 4) - ip;
+  }
+
+  case lookupswitch: {
+    unsigned p = ((ip + 4) & ~3) + 4;
+    int32_t pairCount = codeReadInt32(t, code, p);
+    return p + (pairCount * 8) - ip;
+  }
+
+  default:
+    return 1;
+  }
+}
+
+// stores the targets of the instruction at ip in targets and returns
+// how many there are, which is zero unless it is a branch
+unsigned branchTargets(Thread* t, GcCode* code, unsigned ip, unsigned* targets)
+{
+  unsigned p = ip + 1;
+  switch (code->body()[ip]) {
+  case goto_:
+  case if_acmpeq:
+  case if_acmpne:
+  case if_icmpeq:
+  case if_icmpne:
+  case if_icmplt:
+  case if_icmpge:
+  case if_icmpgt:
+  case if_icmple:
+  case ifeq:
+  case ifne:
+  case iflt:
+  case ifge:
+  case ifgt:
+  case ifle:
+  case ifnonnull:
+  case ifnull:
+  case jsr:
+    targets[0] = ip + codeReadInt16(t, code, p);
+    return 1;
+
+  case goto_w:
+  case jsr_w:
+    targets[0] = ip + codeReadInt32(t, code, p);
+    return 1;
+
+  case tableswitch: {
+    p = (ip + 4) & ~3;
+    targets[0] = ip + codeReadInt32(t, code, p);
+    int32_t bottom = codeReadInt32(t, code, p);
+    int32_t top = codeReadInt32(t, code, p);
+    unsigned count = top - bottom + 1;
+    for (unsigned i = 0; i < count; ++i) {
+      targets[i + 1] = ip + codeReadInt32(t, code, p);
+    }
+    return count + 1;
+  }
+
+  case lookupswitch: {
+    p = (ip + 4) & ~3;
+    targets[0] = ip + codeReadInt32(t, code, p);
+    unsigned count = codeReadInt32(t, code, p);
+    for (unsigned i = 0; i < count; ++i) {
+      p += 4;  // skip the key
+      targets[i + 1] = ip + codeReadInt32(t, code, p);
+    }
+    return count + 1;
+  }
+
+  default:
+    return 0;
+  }
+}
+
+bool fallsThrough(unsigned instruction)
+{
+  switch (instruction) {
+  case areturn:
+  case athrow:
+  case dreturn:
+  case freturn:
+  case goto_:
+  case goto_w:
+  case ireturn:
+  case lookupswitch:
+  case lreturn:
+  case ret:
+  case return_:
+  case tableswitch:
+    return false;
+
+  default:
+    return true;
+  }
+}
+
+// if the instruction at ip is a short (starting at op0), normal, or
+// wide form of the local variable instruction op, stores the variable
+// index in index and returns true
+bool localInstruction(GcCode* code,
+                      unsigned ip,
+                      unsigned op,
+                      unsigned op0,
+                      unsigned* index)
+{
+  uint8_t* body = code->body().begin();
+  if (body[ip] == op) {
+    *index = body[ip + 1];
+    return true;
+  } else if (body[ip] >= op0 and body[ip] <= op0 + 3) {
+    *index = body[ip] - op0;
+    return true;
+  } else if (body[ip] == wide and body[ip + 1] == op) {
+    *index = (body[ip + 2] << 8) | body[ip + 3];
+    return true;
+  } else {
+    return false;
+  }
+}
+
+// returns the number of operand stack slots a value of the specified
+// field code occupies
+unsigned slotCount(unsigned code)
+{
+  switch (code) {
+  case VoidField:
+    return 0;
+
+  case LongField:
+  case DoubleField:
+    return 2;
+
+  default:
+    return 1;
+  }
+}
+
+unsigned fieldReferenceSize(Thread* t, GcCode* code, unsigned index)
+{
+  object o = singletonObject(t, code->pool(), index - 1);
+  if (objectClass(t, o) == type(t, GcField::Type)) {
+    return slotCount(cast<GcField>(t, o)->code());
+  } else {
+    return slotCount(
+        vm::fieldCode(t, cast<GcReference>(t, o)->spec()->body()[0]));
+  }
+}
+
+// inserts copies of the top count stack slots skip slots further down
+// the stack, as the dup family of instructions do
+bool duplicateOrigins(uint8_t* origins,
+                      unsigned capacity,
+                      unsigned* depth,
+                      unsigned count,
+                      unsigned skip)
+{
+  if (*depth < count + skip or *depth + count > capacity) {
+    return false;
+  }
+
+  for (unsigned i = *depth; i > *depth - count - skip; --i) {
+    origins[i - 1 + count] = origins[i - 1];
+  }
+
+  for (unsigned i = 0; i < count; ++i) {
+    origins[*depth - count - skip + i] = origins[*depth + i];
+  }
+
+  *depth += count;
+  return true;
+}
+
+// returns the number of array accesses proven in bounds in the loop
+// whose header starts at header and which ends with a goto at backedge
+unsigned analyzeCountedLoop(MyThread* t,
+                            Context* context,
+                            unsigned header,
+                            unsigned backedge,
+                            Slice<unsigned> firstSource,
+                            Slice<unsigned> lastSource,
+                            Slice<unsigned> previous,
+                            unsigned* targets)
+{
+  GcCode* code = context->method->code();
+  uint8_t* body = code->body().begin();
+  unsigned length = code->length();
+
+  // the header must be "iload i; aload a; arraylength; if_icmpge exit"
+  // where exit is outside the loop:
+  unsigned index;
+  unsigned array;
+  unsigned ip = header;
+  if (not localInstruction(code, ip, iload, iload_0, &index)) {
+    return 0;
+  }
+  ip += instructionLength(t, code, ip);
+
+  if (not localInstruction(code, ip, aload, aload_0, &array)) {
+    return 0;
+  }
+  ip += instructionLength(t, code, ip);
+
+  if (body[ip] != arraylength or body[ip + 1] != if_icmpge) {
+    return 0;
+  }
+
+  unsigned p = ip + 2;
+  if (ip + 1 + codeReadInt16(t, code, p) <= backedge) {
+    return 0;
+  }
+
+  unsigned bodyStart = ip + 4;
+
+  // it must be preceded by "<non-negative constant>; istore i":
+  unsigned store = previous[header];
+  unsigned local;
+  if (store >= length
+      or not localInstruction(code, store, istore, istore_0, &local)
+      or local != index or firstSource[store] != length) {
+    return 0;
+  }
+
+  unsigned constant = previous[store];
+  if (constant >= length) {
+    return 0;
+  }
+
+  switch (body[constant]) {
+  case iconst_0:
+  case iconst_1:
+  case iconst_2:
+  case iconst_3:
+  case iconst_4:
+  case iconst_5:
+    break;
+
+  case bipush:
+    if (static_cast<int8_t>(body[constant + 1]) < 0) {
+      return 0;
+    }
+    break;
+
+  case sipush:
+    p = constant + 1;
+    if (codeReadInt16(t, code, p) < 0) {
+      return 0;
+    }
+    break;
+
+  default:
+    return 0;
+  }
+
+  // the body must end with "iinc i 1":
+  unsigned increment = previous[backedge];
+  if (increment < bodyStart or body[increment] != iinc
+      or body[increment + 1] != index
+      or static_cast<int8_t>(body[increment + 2]) != 1) {
+    return 0;
+  }
+
+  // nothing outside the loop may branch into it:
+  for (unsigned i = header; i <= backedge; ++i) {
+    if (firstSource[i] != length
+        and (firstSource[i] < header or lastSource[i] > backedge)) {
+      return 0;
+    }
+  }
+
+  unsigned capacity = code->maxStack();
+  uint8_t* origins = Slice<uint8_t>::alloc(&(context->zone), capacity).begin();
+  Slice<int> depths = Slice<int>::allocAndSet(
+      &(context->zone), backedge + 1 - header, -1);
+  unsigned* accesses
+      = Slice<unsigned>::alloc(&(context->zone), backedge - bodyStart).begin();
+  unsigned accessCount = 0;
+  unsigned depth = 0;
+  bool live = true;
+
+  for (ip = bodyStart; ip < backedge; ip += instructionLength(t, code, ip)) {
+    int& recorded = depths[ip - header];
+    if (firstSource[ip] != length) {
+      if (not live) {
+        if (recorded < 0) {
+          return 0;
+        }
+        depth = recorded;
+      } else if (recorded >= 0 and static_cast<unsigned>(recorded) != depth) {
+        return 0;
+      }
+
+      for (unsigned i = 0; i < depth; ++i) {
+        origins[i] = OtherOrigin;
+      }
+    } else if (not live) {
+      return 0;
+    }
+
+    recorded = depth;
+
+    unsigned instruction = body[ip];
+    live = fallsThrough(instruction);
+
+    unsigned pop = 0;
+    unsigned push = 0;
+    StackOrigin origin = OtherOrigin;
+
+    if (localInstruction(code, ip, iload, iload_0, &local)) {
+      push = 1;
+      origin = local == index ? IndexOrigin : OtherOrigin;
+    } else if (localInstruction(code, ip, aload, aload_0, &local)) {
+      push = 1;
+      origin = local == array ? ArrayOrigin : OtherOrigin;
+    } else if (localInstruction(code, ip, fload, fload_0, &local)) {
+      push = 1;
+    } else if (localInstruction(code, ip, lload, lload_0, &local)
+               or localInstruction(code, ip, dload, dload_0, &local)) {
+      push = 2;
+    } else if (localInstruction(code, ip, istore, istore_0, &local)
+               or localInstruction(code, ip, fstore, fstore_0, &local)
+               or localInstruction(code, ip, astore, astore_0, &local)) {
+      if (local == index or local == array) {
+        return 0;
+      }
+      pop = 1;
+    } else if (localInstruction(code, ip, lstore, lstore_0, &local)
+               or localInstruction(code, ip, dstore, dstore_0, &local)) {
+      if (local == index or local == array or local + 1 == index
+          or local + 1 == array) {
+        return 0;
+      }
+      pop = 2;
+    } else if (instruction == iinc) {
+      if (body[ip + 1] == index and ip != increment) {
+        return 0;
+      }
+    } else if (instruction == wide) {
+      // a wide iinc; the other wide forms are covered above
+      if (((body[ip + 2] << 8) | body[ip + 3]) == index) {
+        return 0;
+      }
+    } else {
+      switch (instruction) {
+      case areturn:
+      case athrow:
+      case dreturn:
+      case freturn:
+      case goto_:
+      case goto_w:
+      case ireturn:
+      case lreturn:
+      case nop:
+      case return_:
+        break;
 
-  assertT(t,
-          table->length()
-          == elementCount + simpleFrameMapTableSize(t, context->method, table));
+      case aconst_null:
+      case bipush:
+      case fconst_0:
+      case fconst_1:
+      case fconst_2:
+      case iconst_m1:
+      case iconst_0:
+      case iconst_1:
+      case iconst_2:
+      case iconst_3:
+      case iconst_4:
+      case iconst_5:
+      case ldc:
+      case ldc_w:
+      case new_:
+      case sipush:
+        push = 1;
+        break;
 
-  for (unsigned i = 0; i < elementCount; ++i) {
-    TraceElement* p = elements[i];
+      case dconst_0:
+      case dconst_1:
+      case lconst_0:
+      case lconst_1:
+      case ldc2_w:
+        push = 2;
+        break;
 
-    table->body()[i] = static_cast<intptr_t>(p->address->value())
-                       - reinterpret_cast<intptr_t>(start);
+      case aaload:
+      case baload:
+      case caload:
+      case daload:
+      case faload:
+      case iaload:
+      case laload:
+      case saload:
+        if (depth >= 2 and origins[depth - 2] == ArrayOrigin
+            and origins[depth - 1] == IndexOrigin) {
+          accesses[accessCount++] = ip;
+        }
+        pop = 2;
+        push = (instruction == daload or instruction == laload) ? 2 : 1;
+        break;
 
-    assertT(
-        t,
-        elementCount + ceilingDivide((i + 1) * mapSize, 32) <= table->length());
+      case aastore:
+      case bastore:
+      case castore:
+      case fastore:
+      case iastore:
+      case sastore:
+        if (depth >= 3 and origins[depth - 3] == ArrayOrigin
+            and origins[depth - 2] == IndexOrigin) {
+          accesses[accessCount++] = ip;
+        }
+        pop = 3;
+        break;
 
-    if (mapSize) {
-      copyFrameMap(
-          &table->body()[elementCount], p->map, mapSize, i * mapSize, p);
-    }
-  }
+      case dastore:
+      case lastore:
+        if (depth >= 4 and origins[depth - 4] == ArrayOrigin
+            and origins[depth - 3] == IndexOrigin) {
+          accesses[accessCount++] = ip;
+        }
+        pop = 4;
+        break;
 
-  return table;
-}
+      case pop_:
+      case monitorenter:
+      case monitorexit:
+      case ifeq:
+      case ifne:
+      case iflt:
+      case ifge:
+      case ifgt:
+      case ifle:
+      case ifnonnull:
+      case ifnull:
+      case lookupswitch:
+      case tableswitch:
+        pop = 1;
+        break;
 
-void insertCallNode(MyThread* t, GcCallNode* node);
+      case pop2:
+      case if_acmpeq:
+      case if_acmpne:
+      case if_icmpeq:
+      case if_icmpne:
+      case if_icmplt:
+      case if_icmpge:
+      case if_icmpgt:
+      case if_icmple:
+        pop = 2;
+        break;
 
-void finish(MyThread* t, FixedAllocator* allocator, Context* context)
-{
-  avian::codegen::Compiler* c = context->compiler;
+      case vm::dup:
+      case dup_x1:
+      case dup_x2:
+      case vm::dup2:
+      case dup2_x1:
+      case dup2_x2: {
+        unsigned count = instruction >= vm::dup2 ? 2 : 1;
+        unsigned skip
+            = instruction - (instruction >= vm::dup2 ? vm::dup2 : vm::dup);
+        if (not duplicateOrigins(origins, capacity, &depth, count, skip)) {
+          return 0;
+        }
+      } break;
 
-  if (false) {
-    logCompile(
-        t,
-        0,
-        0,
-        reinterpret_cast<const char*>(
-            context->method->class_()->name()->body().begin()),
-        reinterpret_cast<const char*>(context->method->name()->body().begin()),
-        reinterpret_cast<const char*>(context->method->spec()->body().begin()));
-  }
+      case swap: {
+        if (depth < 2) {
+          return 0;
+        }
+        uint8_t top = origins[depth - 1];
+        origins[depth - 1] = origins[depth - 2];
+        origins[depth - 2] = top;
+      } break;
 
-  // for debugging:
-  if (false
-      and ::strcmp(reinterpret_cast<const char*>(
-                       context->method->class_()->name()->body().begin()),
-                   "java/lang/System") == 0
-      and ::strcmp(reinterpret_cast<const char*>(
-                       context->method->name()->body().begin()),
-                   "<clinit>") == 0) {
-    trap();
-  }
+      case anewarray:
+      case arraylength:
+      case checkcast:
+      case f2i:
+      case fneg:
+      case i2b:
+      case i2c:
+      case i2f:
+      case i2s:
+      case ineg:
+      case instanceof:
+      case newarray:
+        pop = 1;
+        push = 1;
+        break;
 
-  // todo: this is a CPU-intensive operation, so consider doing it
-  // earlier before we've acquired the global class lock to improve
-  // parallelism (the downside being that it may end up being a waste
-  // of cycles if another thread compiles the same method in parallel,
-  // which might be mitigated by fine-grained, per-method locking):
-  c->compile(context->leaf ? 0 : stackOverflowThunk(t),
-             TARGET_THREAD_STACKLIMIT);
+      case fadd:
+      case fcmpg:
+      case fcmpl:
+      case fdiv:
+      case fmul:
+      case frem:
+      case fsub:
+      case iadd:
+      case iand:
+      case idiv:
+      case imul:
+      case ior:
+      case irem:
+      case ishl:
+      case ishr:
+      case isub:
+      case iushr:
+      case ixor:
+      case l2i:
+      case l2f:
+      case d2i:
+      case d2f:
+        pop = 2;
+        push = 1;
+        break;
 
-  // we must acquire the class lock here at the latest
+      case d2l:
+      case dneg:
+      case l2d:
+      case lneg:
+        pop = 2;
+        push = 2;
+        break;
 
-  unsigned codeSize = c->resolve(allocator->memory.begin() + allocator->offset);
+      case f2d:
+      case f2l:
+      case i2d:
+      case i2l:
+        pop = 1;
+        push = 2;
+        break;
 
-  unsigned total = pad(codeSize, TargetBytesPerWord)
-                   + pad(c->poolSize(), TargetBytesPerWord);
+      case lshl:
+      case lshr:
+      case lushr:
+        pop = 3;
+        push = 2;
+        break;
 
-  target_uintptr_t* code = static_cast<target_uintptr_t*>(
-      allocator->allocate(total, TargetBytesPerWord));
-  uint8_t* start = reinterpret_cast<uint8_t*>(code);
+      case dcmpg:
+      case dcmpl:
+      case lcmp:
+        pop = 4;
+        push = 1;
+        break;
 
-  context->executableAllocator = allocator;
-  context->executableStart = code;
-  context->executableSize = total;
+      case dadd:
+      case ddiv:
+      case dmul:
+      case drem:
+      case dsub:
+      case ladd:
+      case land:
+      case ldiv_:
+      case lmul:
+      case lor:
+      case lrem:
+      case lsub:
+      case lxor:
+        pop = 4;
+        push = 2;
+        break;
 
-  if (context->objectPool) {
-    object pool = allocate3(
-        t,
-        allocator,
-        Machine::ImmortalAllocation,
-        GcArray::FixedSize + ((context->objectPoolCount + 1) * BytesPerWord),
-        true);
+      case getstatic:
+      case putstatic:
+      case getfield:
+      case putfield: {
+        p = ip + 1;
+        unsigned size = fieldReferenceSize(t, code, codeReadInt16(t, code, p));
+        switch (instruction) {
+        case getstatic:
+          push = size;
+          break;
 
-    context->executableSize = (allocator->memory.begin() + allocator->offset)
-                              - static_cast<uint8_t*>(context->executableStart);
+        case putstatic:
+          pop = size;
+          break;
 
-    initArray(
-        t, reinterpret_cast<GcArray*>(pool), context->objectPoolCount + 1);
-    mark(t, pool, 0);
+        case getfield:
+          pop = 1;
+          push = size;
+          break;
 
-    setField(t, pool, ArrayBody, compileRoots(t)->objectPools());
-    compileRoots(t)->setObjectPools(t, pool);
+        case putfield:
+          pop = 1 + size;
+          break;
+        }
+      } break;
 
-    unsigned i = 1;
-    for (PoolElement* p = context->objectPool; p; p = p->next) {
-      unsigned offset = ArrayBody + ((i++) * BytesPerWord);
+      case invokeinterface:
+      case invokespecial:
+      case invokestatic:
+      case invokevirtual: {
+        p = ip + 1;
+        object reference
+            = singletonObject(t, code->pool(), codeReadInt16(t, code, p) - 1);
+
+        if (objectClass(t, reference) == type(t, GcMethod::Type)) {
+          GcMethod* method = cast<GcMethod>(t, reference);
+          pop = method->parameterFootprint();
+          push = slotCount(method->returnCode());
+        } else {
+          GcReference* ref = cast<GcReference>(t, reference);
+          pop = methodReferenceParameterFootprint(
+              t, ref, instruction == invokestatic);
+          push = slotCount(methodReferenceReturnCode(t, ref));
+        }
+      } break;
 
-      p->address = reinterpret_cast<uintptr_t>(pool) + offset;
+      case multianewarray:
+        pop = body[ip + 3];
+        push = 1;
+        break;
 
-      setField(t, pool, offset, p->target);
+      default:
+        return 0;
+      }
     }
-  }
 
-  c->write();
+    if (depth < pop or depth - pop + push > capacity) {
+      return 0;
+    }
 
-  BootContext* bc = context->bootContext;
-  if (bc) {
-    for (avian::codegen::DelayedPromise* p = bc->addresses;
-         p != bc->addressSentinal;
-         p = p->next) {
-      p->basis = new (bc->zone)
-          avian::codegen::ResolvedPromise(p->basis->value());
+    depth -= pop;
+    for (unsigned i = 0; i < push; ++i) {
+      origins[depth++] = push == 1 ? origin : OtherOrigin;
     }
-  }
 
-  {
-    GcArray* newExceptionHandlerTable = translateExceptionHandlerTable(
-        t,
-        context,
-        reinterpret_cast<intptr_t>(start),
-        reinterpret_cast<intptr_t>(start) + codeSize);
+    unsigned count = branchTargets(t, code, ip, targets);
+    for (unsigned i = 0; i < count; ++i) {
+      unsigned target = targets[i];
+      if (target < header or target > backedge) {
+        // leaving the loop
+      } else if (target > ip) {
+        int& r = depths[target - header];
+        if (r >= 0 and static_cast<unsigned>(r) != depth) {
+          return 0;
+        }
+        r = depth;
+      } else if (target < bodyStart) {
+        if (target != header or depth != 0) {
+          return 0;
+        }
+      } else if (static_cast<unsigned>(depths[target - header]) != depth) {
+        return 0;
+      }
+    }
+  }
 
-    PROTECT(t, newExceptionHandlerTable);
+  for (unsigned i = 0; i < accessCount; ++i) {
+    context->inBoundsTable[accesses[i]] = true;
+  }
 
-    GcLineNumberTable* newLineNumberTable = translateLineNumberTable(
-        t, context, reinterpret_cast<intptr_t>(start));
+  return accessCount;
+}
 
-    GcCode* code = context->method->code();
+bool usesSubroutines(MyThread* t, GcCode* code)
+{
+  for (unsigned ip = 0; ip < code->length();
+       ip += instructionLength(t, code, ip)) {
+    unsigned instruction = code->body()[ip];
+    if (instruction == jsr or instruction == jsr_w or instruction == ret
+        or (instruction == wide and code->body()[ip + 1] == ret)) {
+      return true;
+    }
+  }
+  return false;
+}
 
-    code = makeCode(t,
-                    0,
-                    0,
-                    newExceptionHandlerTable,
-                    newLineNumberTable,
-                    reinterpret_cast<uintptr_t>(start),
-                    codeSize,
-                    code->maxStack(),
-                    code->maxLocals(),
-                    0);
+void findInBoundsAccesses(MyThread* t, Context* context)
+{
+  GcCode* code = context->method->code();
+  unsigned length = code->length();
+  Zone* zone = &(context->zone);
 
-    context->method->setCode(t, code);
+  if (usesSubroutines(t, code)) {
+    // subroutines are compiled once per caller, and the analysis
+    // below isn't prepared for that
+    return;
   }
 
-  if (context->traceLogCount) {
-    THREAD_RUNTIME_ARRAY(t, TraceElement*, elements, context->traceLogCount);
-    unsigned index = 0;
-    // unsigned pathFootprint = 0;
-    // unsigned mapCount = 0;
-    for (TraceElement* p = context->traceLog; p; p = p->next) {
-      assertT(t, index < context->traceLogCount);
-
-      if (p->address) {
-        RUNTIME_ARRAY_BODY(elements)[index++] = p;
+  // for each ip, the lowest and highest ips of the instructions which
+  // branch to it, or (length, 0) if there are none:
+  Slice<unsigned> firstSource
+      = Slice<unsigned>::allocAndSet(zone, length, length);
+  Slice<unsigned> lastSource = Slice<unsigned>::allocAndSet(zone, length, 0);
 
-        if (p->target) {
-          insertCallNode(
-              t, makeCallNode(t, p->address->value(), p->target, p->flags, 0));
-        }
-      }
-    }
+  // for each instruction, the ip of the one before it:
+  Slice<unsigned> previous = Slice<unsigned>::allocAndSet(zone, length, length);
 
-    qsort(RUNTIME_ARRAY_BODY(elements),
-          index,
-          sizeof(TraceElement*),
-          compareTraceElementPointers);
+  unsigned* targets = Slice<unsigned>::alloc(zone, length + 1).begin();
 
-    GcIntArray* map = makeSimpleFrameMapTable(
-        t, context, start, RUNTIME_ARRAY_BODY(elements), index);
+  unsigned last = length;
+  for (unsigned ip = 0; ip < length; ip += instructionLength(t, code, ip)) {
+    previous[ip] = last;
+    last = ip;
 
-    context->method->code()->setStackMap(t, map);
+    unsigned count = branchTargets(t, code, ip, targets);
+    for (unsigned i = 0; i < count; ++i) {
+      if (ip < firstSource[targets[i]]) {
+        firstSource[targets[i]] = ip;
+      }
+      if (ip > lastSource[targets[i]]) {
+        lastSource[targets[i]] = ip;
+      }
+    }
   }
 
-  logCompile(
-      t,
-      start,
-      codeSize,
-      reinterpret_cast<const char*>(
-          context->method->class_()->name()->body().begin()),
-      reinterpret_cast<const char*>(context->method->name()->body().begin()),
-      reinterpret_cast<const char*>(context->method->spec()->body().begin()));
+  // treat exception handlers as entered from outside any loop:
+  GcExceptionHandlerTable* eht
+      = cast<GcExceptionHandlerTable>(t, code->exceptionHandlerTable());
+  if (eht) {
+    for (unsigned i = 0; i < eht->length(); ++i) {
+      unsigned handler = exceptionHandlerIp(eht->body()[i]);
+      firstSource[handler] = 0;
+      lastSource[handler] = length;
+    }
+  }
+
+  unsigned total = 0;
+  for (unsigned ip = 0; ip < length; ip += instructionLength(t, code, ip)) {
+    if (code->body()[ip] == goto_) {
+      unsigned p = ip + 1;
+      int16_t offset = codeReadInt16(t, code, p);
+      if (offset < 0) {
+        total += analyzeCountedLoop(t,
+                                    context,
+                                    ip + offset,
+                                    ip,
+                                    firstSource,
+                                    lastSource,
+                                    previous,
+                                    targets);
+      }
+    }
+  }
 
-  // for debugging:
-  if (false
-      and ::strcmp(reinterpret_cast<const char*>(
-                       context->method->class_()->name()->body().begin()),
-                   "java/lang/System") == 0
-      and ::strcmp(reinterpret_cast<const char*>(
-                       context->method->name()->body().begin()),
-                   "<clinit>") == 0) {
-    trap();
+  if (DebugBoundsChecks and total) {
+    fprintf(stderr,
+            "eliminated %d bounds checks in %s.%s%s\n",
+            total,
+            context->method->class_()->name()->body().begin(),
+            context->method->name()->body().begin(),
+            context->method->spec()->body().begin());
   }
-  syncInstructionCache(start, codeSize);
 }
 
 void compile(MyThread* t, Context* context)
@@ -7325,6 +9827,14 @@ void compile(MyThread* t, Context* context)
     }
   }
 
+  if (CheckArrayBounds) {
+    findInBoundsAccesses(t, context);
+  }
+
+  // out-of-line slow paths are numbered after the bytecode, which
+  // would collide with the copies made for each subroutine call:
+  context->fastPaths = not usesSubroutines(t, context->method->code());
+
   handleEntrance(t, &frame);
 
   Compiler::State* state = c->saveState();
@@ -7765,48 +10275,31 @@ uint64_t invokeNative(MyThread* t)
   return result;
 }
 
-void findFrameMapInSimpleTable(MyThread* t,
-                               GcMethod* method,
-                               GcIntArray* table,
-                               int32_t offset,
-                               int32_t** map,
-                               unsigned* start)
+// returns the map of live references for the call site at the
+// specified offset (see makeFrameMapTable)
+int32_t* findFrameMap(MyThread* t,
+                      void* stack UNUSED,
+                      GcMethod* method,
+                      int32_t offset)
 {
-  unsigned tableSize = simpleFrameMapTableSize(t, method, table);
-  unsigned indexSize = table->length() - tableSize;
+  GcIntArray* table = method->code()->stackMap();
+  unsigned bucketCount = table->body()[0];
+  int32_t* sites = &table->body()[1];
 
-  *map = &table->body()[indexSize];
-
-  unsigned bottom = 0;
-  unsigned top = indexSize;
-  for (unsigned span = top - bottom; span; span = top - bottom) {
-    unsigned middle = bottom + (span / 2);
-    int32_t v = table->body()[middle];
-
-    if (offset == v) {
-      *start = frameMapSizeInBits(t, method) * middle;
-      return;
-    } else if (offset < v) {
-      top = middle;
-    } else {
-      bottom = middle + 1;
+  for (unsigned bucket = frameMapBucket(offset, bucketCount);
+       sites[bucket * 2] != -1;
+       bucket = (bucket + 1) & (bucketCount - 1)) {
+    if (sites[bucket * 2] == offset) {
+      return &table->body()[1 + (bucketCount * 2)
+                            + (sites[(bucket * 2) + 1]
+                               * ceilingDivide(frameMapSizeInBits(t, method),
+                                               32))];
     }
   }
 
   abort(t);
 }
 
-void findFrameMap(MyThread* t,
-                  void* stack UNUSED,
-                  GcMethod* method,
-                  int32_t offset,
-                  int32_t** map,
-                  unsigned* start)
-{
-  findFrameMapInSimpleTable(
-      t, method, method->code()->stackMap(), offset, map, start);
-}
-
 void visitStackAndLocals(MyThread* t,
                          Heap::Visitor* v,
                          void* frame,
@@ -7818,20 +10311,17 @@ void visitStackAndLocals(MyThread* t,
   if (count) {
     void* stack = stackForFrame(t, frame, method);
 
-    int32_t* map;
-    unsigned offset;
-    findFrameMap(
+    int32_t* map = findFrameMap(
         t,
         stack,
         method,
-        difference(ip, reinterpret_cast<void*>(methodAddress(t, method))),
-        &map,
-        &offset);
+        difference(ip, reinterpret_cast<void*>(methodAddress(t, method))));
 
-    for (unsigned i = 0; i < count; ++i) {
-      int j = offset + i;
-      if (map[j / 32] & (static_cast<int32_t>(1) << (j % 32))) {
-        v->visit(localObject(t, stack, method, i));
+    for (unsigned word = 0; word < ceilingDivide(count, 32); ++word) {
+      for (uint32_t bits = map[word], i = word * 32; bits; bits >>= 1, ++i) {
+        if (bits & 1) {
+          v->visit(localObject(t, stack, method, i));
+        }
       }
     }
   }
@@ -7942,19 +10432,15 @@ void walkContinuationBody(MyThread* t,
       count -= start - first;
     }
 
-    int32_t* map;
-    unsigned offset;
-    findFrameMap(t,
-                 reinterpret_cast<uintptr_t*>(c) + stack,
-                 method,
-                 difference(c->address(),
-                            reinterpret_cast<void*>(methodAddress(t, method))),
-                 &map,
-                 &offset);
+    int32_t* map = findFrameMap(
+        t,
+        reinterpret_cast<uintptr_t*>(c) + stack,
+        method,
+        difference(c->address(),
+                   reinterpret_cast<void*>(methodAddress(t, method))));
 
     for (int i = count - 1; i >= 0; --i) {
-      int j = offset + i;
-      if (map[j / 32] & (static_cast<int32_t>(1) << (j % 32))) {
+      if (map[i / 32] & (static_cast<int32_t>(1) << (i % 32))) {
         if (not w->visit(stack + localOffsetFromStack(t, i, method))) {
           return;
         }
@@ -8780,6 +11266,16 @@ class MyProcessor : public Processor {
                         TARGET_THREAD_EXCEPTION,
                         &Thread::exception,
                         "TARGET_THREAD_EXCEPTION")
+          + checkConstant(t,
+                          TARGET_THREAD_HEAPINDEX,
+                          &Thread::heapIndex,
+                          "TARGET_THREAD_HEAPINDEX")
+          + checkConstant(t,
+                          TARGET_THREAD_HEAPLIMIT,
+                          &Thread::heapLimit,
+                          "TARGET_THREAD_HEAPLIMIT")
+          + checkConstant(
+                t, TARGET_THREAD_HEAP, &Thread::heap, "TARGET_THREAD_HEAP")
           + checkConstant(t,
                           TARGET_THREAD_EXCEPTIONSTACKADJUSTMENT,
                           &MyThread::exceptionStackAdjustment,
@@ -8840,7 +11336,14 @@ class MyProcessor : public Processor {
 
     expect(t, TargetClassArrayElementSize == ClassArrayElementSize);
     expect(t, TargetClassFixedSize == ClassFixedSize);
+    expect(t, TargetClassInterfaceMethodTable == ClassInterfaceMethodTable);
+    expect(t, TargetClassPrimarySupers == ClassPrimarySupers);
     expect(t, TargetClassVtable == ClassVtable);
+    expect(t, TargetInlineCacheReceiver == InlineCacheReceiver);
+    expect(t, TargetInlineCacheState == vm::InlineCacheState);
+    expect(t, TargetMethodOffset == MethodOffset);
+    expect(t, TargetMethodName == MethodName);
+    expect(t, TargetMethodSpec == MethodSpec);
 
 #endif
 
@@ -8915,6 +11418,7 @@ class MyProcessor : public Processor {
                          sourceFile,
                          super,
                          interfaceTable,
+                         0,
                          virtualTable,
                          fieldTable,
                          methodTable,
@@ -8922,6 +11426,7 @@ class MyProcessor : public Processor {
                          staticTable,
                          loader,
                          0,
+                         0,
                          vtableLength);
   }
 
@@ -8941,6 +11446,10 @@ class MyProcessor : public Processor {
 
     if (t == t->m->rootThread) {
       v->visit(&roots);
+
+      // methods in the boot image are immortal, so only the JIT
+      // index needs visiting:
+      codeIndex.visit(v);
     }
 
     for (MyThread::CallTrace* trace = t->trace; trace; trace = trace->next) {
@@ -9198,6 +11707,9 @@ class MyProcessor : public Processor {
 
   virtual void dispose()
   {
+    codeIndex.dispose();
+    bootCodeIndex.dispose();
+
     if (codeAllocator.memory.begin()) {
 #ifndef AVIAN_AOT_ONLY
       Memory::free(codeAllocator.memory);
@@ -9304,7 +11816,7 @@ class MyProcessor : public Processor {
       collect(t, Heap::MinorCollection);
     }
 
-    return visitor.trace ? visitor.trace : makeObjectArray(t, 0);
+    return visitor.trace ? visitor.trace : makeRawTrace(t, 0, 0);
   }
 
   virtual void initialize(BootImage* image, Slice<uint8_t> code)
@@ -9395,6 +11907,11 @@ class MyProcessor : public Processor {
     }
 #endif
 
+    if (codeAllocator.memory.begin()) {
+      codeIndex.init(
+          allocator, codeAllocator.memory.begin(), codeAllocator.memory.count);
+    }
+
     if (image and code) {
       local::boot(static_cast<MyThread*>(t), image, code);
     } else {
@@ -9498,6 +12015,8 @@ class MyProcessor : public Processor {
   SignalHandler segFaultHandler;
   SignalHandler divideByZeroHandler;
   FixedAllocator codeAllocator;
+  CodeIndex codeIndex;
+  CodeIndex bootCodeIndex;
   ThunkCollection thunks;
   ThunkCollection bootThunks;
   unsigned callTableSize;
@@ -9589,6 +12108,16 @@ void* compileMethod2(MyThread* t, void* ip)
   GcMethod* target = node->target();
 
   PROTECT(t, node);
+
+  bool virtualCall = node->flags() & TraceElement::VirtualCall;
+  if (virtualCall) {
+    // a direct call from a site with an inline cache, which another
+    // thread bound just before we made it (see bindInlineCache), so we
+    // still see the original target.  The call is already patched, so
+    // we need only dispatch this one:
+    target = resolveTarget(t, t->stack, target);
+  }
+
   PROTECT(t, target);
 
   t->trace->targetMethod = target;
@@ -9601,8 +12130,9 @@ void* compileMethod2(MyThread* t, void* ip)
 
   MyProcessor* p = processor(t);
 
-  bool updateCaller = updateIp < p->codeImage
-                      or updateIp >= p->codeImage + p->codeImageSize;
+  bool updateCaller = (not virtualCall)
+                      and (updateIp < p->codeImage
+                           or updateIp >= p->codeImage + p->codeImageSize);
 
   uintptr_t address;
   if (target->flags() & ACC_NATIVE) {
@@ -10040,6 +12570,18 @@ void fixupVirtualThunks(MyThread* t, uint8_t* code)
   }
 }
 
+void indexMethodTree(MyThread* t,
+                     CodeIndex* index,
+                     GcTreeNode* node,
+                     GcTreeNode* sentinal)
+{
+  if (node != sentinal) {
+    indexMethodTree(t, index, node->left(), sentinal);
+    index->insert(t, cast<GcMethod>(t, node->value()));
+    indexMethodTree(t, index, node->right(), sentinal);
+  }
+}
+
 void boot(MyThread* t, BootImage* image, uint8_t* code)
 {
   assertT(t, image->magic == BootImage::Magic);
@@ -10175,6 +12717,12 @@ void boot(MyThread* t, BootImage* image, uint8_t* code)
 
   image->initialized = true;
 
+  p->bootCodeIndex.init(p->allocator, code, image->codeSize);
+  indexMethodTree(t,
+                  &(p->bootCodeIndex),
+                  compileRoots(t)->methodTree(),
+                  compileRoots(t)->methodTreeSentinal());
+
   GcHashMap* map = makeHashMap(t, 0, 0);
   // sequence point, for gc (don't recombine statements)
   roots(t)->setBootstrapClassMap(t, map);
@@ -10634,6 +13182,20 @@ void compile(MyThread* t,
     }
   }
 
+  if (methodAddress(t, method) != defaultThunk(t)) {
+    return;
+  }
+
+  // Register allocation and instruction selection are the most
+  // CPU-intensive part of compilation, but they only touch the
+  // context's private zone, so we do them before acquiring the class
+  // lock.  That way threads warming up in parallel only serialize on
+  // the comparatively cheap work of placing and publishing the code.
+  // The downside is that two threads racing to compile the same
+  // method may both do this work, but only one result is installed.
+  context.compiler->compile(context.leaf ? 0 : stackOverflowThunk(t),
+                            TARGET_THREAD_STACKLIMIT);
+
   ACQUIRE(t, t->m->classLock);
 
   if (methodAddress(t, method) != defaultThunk(t)) {
@@ -10668,6 +13230,8 @@ void compile(MyThread* t,
   // sequence point, for gc (don't recombine statements)
   compileRoots(t)->setMethodTree(t, newTree);
 
+  codeIndex(t)->insert(t, clone);
+
   storeStoreMemoryBarrier();
 
   method->setCode(t, clone->code());
@@ -10688,6 +13252,8 @@ void compile(MyThread* t,
              method,
              compileRoots(t)->methodTreeSentinal(),
              compareIpToMethodBounds);
+
+  codeIndex(t)->update(t, method);
 #endif // not AVIAN_AOT_ONLY
 }
 
@@ -10701,6 +13267,16 @@ avian::util::FixedAllocator* codeAllocator(MyThread* t)
   return &(processor(t)->codeAllocator);
 }
 
+CodeIndex* codeIndex(MyThread* t)
+{
+  return &(processor(t)->codeIndex);
+}
+
+CodeIndex* bootCodeIndex(MyThread* t)
+{
+  return &(processor(t)->bootCodeIndex);
+}
+
 Allocator* allocator(MyThread* t)
 {
   return processor(t)->allocator;
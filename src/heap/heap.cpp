@@ -10,6 +10,7 @@
 
 #include <avian/heap/heap.h>
 #include <avian/system/system.h>
+#include <avian/system/memory.h>
 #include "avian/common.h"
 #include "avian/arch.h"
 
@@ -17,6 +18,7 @@
 
 using namespace vm;
 using namespace avian::util;
+using avian::system::Memory;
 
 namespace {
 
@@ -27,6 +29,35 @@ const unsigned Top = ~static_cast<unsigned>(0);
 const unsigned InitialGen2CapacityInBytes = 4 * 1024 * 1024;
 const unsigned InitialTenuredFixieCeilingInBytes = 4 * 1024 * 1024;
 
+// fixies which fit in a slot of at most MaxFixieSlotSizeInBytes are
+// allocated from arenas of equally-sized slots (see FixieArena below):
+const unsigned FixieArenaSizeInBytes = 64 * 1024;
+const unsigned MinFixieSlotSizeInBytes = 64;
+const unsigned MaxFixieSlotSizeInBytes = 4 * 1024;
+const unsigned FixieSizeClassCount = 7;
+
+// pause times, in microseconds, are recorded in a histogram whose
+// buckets are exact below PauseSubBuckets and thereafter split each
+// power of two into PauseSubBuckets equal parts, so a pause is known
+// to within 1/PauseSubBuckets of its length (see pauseBucket):
+const unsigned PauseSubBuckets = 8;
+const unsigned PauseHistogramSize = 64 * PauseSubBuckets;
+
+// free blocks at least this big have their pages returned to the OS
+// rather than left for the system allocator to hold on to:
+const unsigned MinUncommitSizeInBytes = 256 * 1024;
+
+// defaults for the uncommit policy (see Heap::setUncommitPolicy):
+const unsigned DefaultUncommitDelay = 0;
+const unsigned DefaultMinFreeRatio = 50;
+
+// parallel collection parameters (see Worker below):
+const unsigned MaxCollectorThreads = 64;
+const unsigned CopyBufferSizeInWords = 2048;
+const unsigned MaxCopyBufferWasteInWords = 32;
+const unsigned ClaimStripeCount = 1024;
+const unsigned InitialGrayStackCapacity = 1024;
+
 const bool Verbose = false;
 const bool Verbose2 = false;
 const bool Debug = false;
@@ -57,6 +88,7 @@ class MutexLock {
 };
 
 class Context;
+class Worker;
 
 Aborter* getAborter(Context* c);
 
@@ -352,6 +384,21 @@ class Segment {
       if (child)
         child->markAtomic(p);
     }
+
+    void setOnlyAtomic(void* p, unsigned v)
+    {
+      unsigned index = indexOf(p);
+      assertT(segment->context, bitOf(index) + bitsPerRecord <= BitsPerWord);
+
+      uintptr_t* w = data + wordOf(index);
+      for (uintptr_t old = *w;; old = *w) {
+        uintptr_t new_ = old;
+        setBits(&new_, bitsPerRecord, bitOf(index), v);
+        if (new_ == old or atomicCompareAndSwap(w, old, new_)) {
+          break;
+        }
+      }
+    }
 #endif
 
     unsigned get(void* p)
@@ -506,6 +553,13 @@ class Segment {
     return contains(p) or p == data + position();
   }
 
+  // like contains, but independent of position, which may be
+  // advanced concurrently by collector threads:
+  bool reserves(void* p)
+  {
+    return capacity() and p >= data and p < data + capacity();
+  }
+
   void* get(unsigned offset)
   {
     assertT(context, offset <= position());
@@ -528,6 +582,28 @@ class Segment {
     return p;
   }
 
+#ifdef USE_ATOMIC_OPERATIONS
+  bool claim(unsigned size, unsigned* start)
+  {
+    assertT(context, size);
+
+    for (unsigned old = position_;; old = position_) {
+      if (old + size > capacity()) {
+        return false;
+      } else if (atomicCompareAndSwap32(
+                     reinterpret_cast<uint32_t*>(&position_), old, old + size)) {
+        *start = old;
+        return true;
+      }
+    }
+  }
+
+  void unclaim(unsigned start, unsigned end)
+  {
+    atomicCompareAndSwap32(reinterpret_cast<uint32_t*>(&position_), end, start);
+  }
+#endif
+
   void dispose()
   {
     if (data) {
@@ -544,6 +620,7 @@ class Fixie {
   static const unsigned Marked = 1 << 1;
   static const unsigned Dirty = 1 << 2;
   static const unsigned Dead = 1 << 3;
+  static const unsigned InArena = 1 << 4;
 
   Fixie(Context* c, unsigned size, bool hasMask, Fixie** handle, bool immortal)
       : age(immortal ? FixieTenureThreshold + 1 : 0),
@@ -666,6 +743,20 @@ class Fixie {
     return (flags & Dead) != 0;
   }
 
+  bool inArena()
+  {
+    return (flags & InArena) != 0;
+  }
+
+  void inArena(bool v)
+  {
+    if (v) {
+      flags |= InArena;
+    } else {
+      flags &= ~InArena;
+    }
+  }
+
   void dead(bool v)
   {
     if (v) {
@@ -691,11 +782,83 @@ Fixie* fixie(void* body)
   return static_cast<Fixie*>(body) - 1;
 }
 
+// An arena is a block of FixieArenaSizeInBytes holding slots of a
+// single size, each of which begins with a pointer back to the arena
+// followed by a fixie.  A set bit in freeMap means the corresponding
+// slot is free.  Arenas with at least one free slot are kept in a
+// list per size class, and an arena is released once all its slots
+// are free unless it's the only one left in its class.
+class FixieArena {
+ public:
+  static const unsigned MaxSlotCount = FixieArenaSizeInBytes
+                                       / MinFixieSlotSizeInBytes;
+
+  FixieArena(unsigned slotSize)
+      : next(0),
+        emptySince(0),
+        slotSize(slotSize),
+        slotCount((FixieArenaSizeInBytes - sizeof(FixieArena)) / slotSize),
+        freeCount(slotCount)
+  {
+    memset(freeMap, 0, sizeof(freeMap));
+    for (unsigned i = 0; i < slotCount; ++i) {
+      markBit(freeMap, i);
+    }
+  }
+
+  static FixieArena* arena(Fixie* f)
+  {
+    return reinterpret_cast<FixieArena**>(f)[-1];
+  }
+
+  uint8_t* slots()
+  {
+    return reinterpret_cast<uint8_t*>(this + 1);
+  }
+
+  Fixie* allocate()
+  {
+    for (unsigned word = 0;; ++word) {
+      if (freeMap[word]) {
+        unsigned bit = 0;
+        while ((freeMap[word] & (static_cast<uintptr_t>(1) << bit)) == 0) {
+          ++bit;
+        }
+
+        unsigned index = indexOf(word, bit);
+        clearBit(freeMap, index);
+        --freeCount;
+
+        FixieArena** slot
+            = reinterpret_cast<FixieArena**>(slots() + (index * slotSize));
+        *slot = this;
+        return reinterpret_cast<Fixie*>(slot + 1);
+      }
+    }
+  }
+
+  void free(Fixie* f)
+  {
+    unsigned index = (reinterpret_cast<uint8_t*>(f) - BytesPerWord - slots())
+                     / slotSize;
+    markBit(freeMap, index);
+    ++freeCount;
+  }
+
+  FixieArena* next;
+  int64_t emptySince;
+  unsigned slotSize;
+  unsigned slotCount;
+  unsigned freeCount;
+  uintptr_t freeMap[(MaxSlotCount + BitsPerWord - 1) / BitsPerWord];
+};
+
 void free(Context* c, Fixie** fixies, bool resetImmortal = false);
+void releaseFixieArenas(Context* c, bool all);
 
 class Context {
  public:
-  Context(System* system, unsigned limit)
+  Context(System* system, unsigned limit, unsigned workerCount, bool compact)
       : system(system),
         client(0),
         count(0),
@@ -727,6 +890,7 @@ class Context {
         incomingFootprint(0),
         pendingAllocation(0),
         tenureFootprint(0),
+        newlyTenuredFootprint(0),
         gen1Padding(0),
         tenurePadding(0),
         gen2Padding(0),
@@ -743,8 +907,36 @@ class Context {
         lastCollectionTime(system->now()),
         totalCollectionTime(0),
         totalTime(0),
-        limitWasExceeded(false)
+        limitWasExceeded(false),
+        workerCount(workerCount),
+        workers(0),
+        claims(0),
+        fixieLock(0),
+        workerMonitor(0),
+        workerGeneration(0),
+        busyWorkers(0),
+        activeWorkers(0),
+        drainWorkers(0),
+        workersDisposed(false),
+        parallel(false),
+        postVisiting(false),
+        compact(compact),
+        compacting(false),
+        compactBase(0),
+        markStack(0),
+        markStackSize(0),
+        markStackCapacity(0),
+        logFile(0),
+        collectionCount(0),
+        maxPauseTime(0),
+        uncommitDelay(DefaultUncommitDelay),
+        minFreeRatio(DefaultMinFreeRatio),
+        oversizedSince(0)
   {
+    memset(fixieArenas, 0, sizeof(fixieArenas));
+    memset(fixieArenaCounts, 0, sizeof(fixieArenaCounts));
+    memset(pauseHistogram, 0, sizeof(pauseHistogram));
+
     if (not system->success(system->make(&lock))) {
       system->abort();
     }
@@ -756,7 +948,13 @@ class Context {
     nextGen1.dispose();
     gen2.dispose();
     nextGen2.dispose();
+    releaseFixieArenas(this, true);
     lock->dispose();
+    system->free(markStack);
+
+    if (logFile) {
+      fclose(logFile);
+    }
   }
 
   void disposeFixies()
@@ -798,6 +996,7 @@ class Context {
   unsigned incomingFootprint;
   int pendingAllocation;
   unsigned tenureFootprint;
+  unsigned newlyTenuredFootprint;
   unsigned gen1Padding;
   unsigned tenurePadding;
   unsigned gen2Padding;
@@ -815,11 +1014,43 @@ class Context {
   Fixie* markedFixies;
   Fixie* visitedFixies;
 
+  FixieArena* fixieArenas[FixieSizeClassCount];
+  unsigned fixieArenaCounts[FixieSizeClassCount];
+
   int64_t lastCollectionTime;
   int64_t totalCollectionTime;
   int64_t totalTime;
 
   bool limitWasExceeded;
+
+  unsigned workerCount;
+  Worker* workers;
+  uintptr_t* claims;
+  System::Mutex* fixieLock;
+  System::Monitor* workerMonitor;
+  unsigned workerGeneration;
+  unsigned busyWorkers;
+  unsigned activeWorkers;
+  unsigned drainWorkers;
+  bool workersDisposed;
+  bool parallel;
+  bool postVisiting;
+
+  bool compact;
+  bool compacting;
+  unsigned compactBase;
+  void** markStack;
+  unsigned markStackSize;
+  unsigned markStackCapacity;
+
+  FILE* logFile;
+  unsigned collectionCount;
+  unsigned pauseHistogram[PauseHistogramSize];
+  int64_t maxPauseTime;
+
+  int64_t uncommitDelay;
+  unsigned minFreeRatio;
+  int64_t oversizedSince;
 };
 
 const char* segment(Context* c, void* p)
@@ -842,22 +1073,61 @@ inline Aborter* getAborter(Context* c)
   return c->system;
 }
 
+// space which may be lost to partially-filled copy buffers when
+// collecting in parallel, given the number of words to be copied:
+inline unsigned copyBufferSlack(Context* c, unsigned footprint)
+{
+  if (c->workerCount > 1) {
+    return (c->workerCount * CopyBufferSizeInWords)
+           + (footprint / ((CopyBufferSizeInWords / MaxCopyBufferWasteInWords)
+                           - 1));
+  } else {
+    return 0;
+  }
+}
+
 inline unsigned minimumNextGen1Capacity(Context* c)
 {
-  return c->gen1.position() - c->tenureFootprint + c->incomingFootprint
-         + c->gen1Padding;
+  unsigned footprint = c->gen1.position() - c->tenureFootprint
+                       + c->incomingFootprint + c->gen1Padding;
+
+  return footprint + copyBufferSlack(c, footprint);
 }
 
 inline unsigned minimumNextGen2Capacity(Context* c)
 {
-  return c->gen2.position() + c->tenureFootprint + c->tenurePadding
-         + c->gen2Padding;
+  unsigned footprint = c->gen2.position() + c->tenureFootprint
+                       + c->tenurePadding + c->gen2Padding;
+
+  return footprint + copyBufferSlack(c, footprint);
 }
 
-inline bool oversizedGen2(Context* c)
+// returns the capacity which leaves c->minFreeRatio percent of a
+// space free when the specified amount of it is in use
+inline unsigned withFreeRatio(Context* c, unsigned footprint)
+{
+  return min(static_cast<uint64_t>(footprint) * 100
+                 / (100 - c->minFreeRatio),
+             static_cast<uint64_t>(Top - 1));
+}
+
+// returns whether gen2 has more than twice the free space
+// c->minFreeRatio calls for, regardless of how long it has done so
+inline bool gen2HasExcess(Context* c)
 {
   return c->gen2.capacity() > (InitialGen2CapacityInBytes / BytesPerWord)
-         and c->gen2.position() < (c->gen2.capacity() / 4);
+         and withFreeRatio(c, c->gen2.position()) < (c->gen2.capacity() / 2);
+}
+
+// returns whether gen2 has had excess capacity for long enough that
+// we should shrink it
+inline bool oversizedGen2(Context* c)
+{
+  return gen2HasExcess(c)
+         and (c->uncommitDelay == 0
+              or (c->oversizedSince
+                  and c->system->now() - c->oversizedSince
+                      >= c->uncommitDelay));
 }
 
 inline void initNextGen1(Context* c)
@@ -894,7 +1164,7 @@ inline void initNextGen2(Context* c)
   unsigned desired = minimum;
 
   if (not oversizedGen2(c)) {
-    desired *= 2;
+    desired = max(desired, withFreeRatio(c, minimum));
   }
 
   if (desired < InitialGen2CapacityInBytes / BytesPerWord) {
@@ -920,8 +1190,10 @@ inline void initNextGen2(Context* c)
 
 inline bool fresh(Context* c, void* o)
 {
-  return c->nextGen1.contains(o) or c->nextGen2.contains(o)
-         or (c->gen2.contains(o) and c->gen2.indexOf(o) >= c->gen2Base);
+  return c->nextGen1.reserves(o) or c->nextGen2.reserves(o)
+         or (c->gen2.reserves(o)
+             and static_cast<unsigned>(static_cast<uintptr_t*>(o)
+                                       - c->gen2.data) >= c->gen2Base);
 }
 
 inline bool wasCollected(Context* c, void* o)
@@ -947,6 +1219,96 @@ inline uintptr_t* bitset(Context* c UNUSED, void* o)
   return &fieldAtOffset<uintptr_t>(o, BytesPerWord * 2);
 }
 
+unsigned fixieSizeClass(unsigned totalSize)
+{
+  return log(max(nextPowerOfTwo(totalSize + BytesPerWord),
+                 MinFixieSlotSizeInBytes)) - log(MinFixieSlotSizeInBytes);
+}
+
+bool fitsInArena(unsigned totalSize)
+{
+  return totalSize + BytesPerWord <= MaxFixieSlotSizeInBytes;
+}
+
+void* allocateFixie(Context* c, unsigned totalSize)
+{
+  assertT(c, fitsInArena(totalSize));
+
+  unsigned sizeClass = fixieSizeClass(totalSize);
+  FixieArena* a = c->fixieArenas[sizeClass];
+  if (a == 0) {
+    a = new (local::allocate(c, FixieArenaSizeInBytes))
+        FixieArena(MinFixieSlotSizeInBytes << sizeClass);
+    c->fixieArenas[sizeClass] = a;
+    ++c->fixieArenaCounts[sizeClass];
+  }
+
+  Fixie* f = a->allocate();
+
+  if (a->freeCount == 0) {
+    c->fixieArenas[sizeClass] = a->next;
+    a->next = 0;
+  }
+
+  return f;
+}
+
+void free(Context* c, Fixie* f)
+{
+  if (f->inArena()) {
+    FixieArena* a = FixieArena::arena(f);
+    if (a->freeCount == 0) {
+      unsigned sizeClass = log(a->slotSize) - log(MinFixieSlotSizeInBytes);
+      a->next = c->fixieArenas[sizeClass];
+      c->fixieArenas[sizeClass] = a;
+    }
+    a->free(f);
+  } else {
+    free(c, f, f->totalSize());
+  }
+}
+
+// free arenas which have been empty for at least c->uncommitDelay
+// milliseconds, as long as enough slots remain free in their size
+// class to satisfy c->minFreeRatio (or all empty arenas if
+// specified)
+void releaseFixieArenas(Context* c, bool all)
+{
+  int64_t now = all ? 0 : c->system->now();
+
+  for (unsigned i = 0; i < FixieSizeClassCount; ++i) {
+    unsigned freeCount = 0;
+    for (FixieArena* a = c->fixieArenas[i]; a; a = a->next) {
+      freeCount += a->freeCount;
+    }
+
+    for (FixieArena** p = c->fixieArenas + i; *p;) {
+      FixieArena* a = *p;
+      if (a->freeCount == a->slotCount) {
+        if (a->emptySince == 0) {
+          a->emptySince = now;
+        }
+
+        unsigned capacity = c->fixieArenaCounts[i] * a->slotCount;
+        if (all
+            or (now - a->emptySince >= c->uncommitDelay
+                and withFreeRatio(c, capacity - freeCount)
+                    <= capacity - a->slotCount)) {
+          *p = a->next;
+          freeCount -= a->slotCount;
+          --c->fixieArenaCounts[i];
+          free(c, a, FixieArenaSizeInBytes);
+          continue;
+        }
+      } else {
+        a->emptySince = 0;
+      }
+
+      p = &(a->next);
+    }
+  }
+}
+
 void free(Context* c, Fixie** fixies, bool resetImmortal)
 {
   for (Fixie** p = fixies; *p;) {
@@ -971,7 +1333,7 @@ void free(Context* c, Fixie** fixies, bool resetImmortal)
       if (DebugFixies) {
         fprintf(stderr, "free fixie %p\n", f);
       }
-      free(c, f, f->totalSize());
+      free(c, f);
     }
   }
 }
@@ -1048,6 +1410,8 @@ void sweepFixies(Context* c)
 
   c->tenuredFixieCeiling
       = max(c->tenuredFixieFootprint * 2, InitialTenuredFixieCeilingInBytes);
+
+  releaseFixieArenas(c, false);
 }
 
 inline void* copyTo(Context* c, Segment* s, void* o, unsigned size)
@@ -1074,14 +1438,23 @@ void* copy2(Context* c, void* o)
   } else if (c->gen1.contains(o)) {
     unsigned age = c->ageMap.get(o);
     if (age == TenureThreshold) {
-      if (c->mode == Heap::MinorCollection) {
+      c->newlyTenuredFootprint += size;
+
+      if (c->mode == Heap::MinorCollection or c->compacting) {
         assertT(c, c->gen2.remaining() >= size);
 
         if (c->gen2Base == Top) {
           c->gen2Base = c->gen2.position();
         }
 
-        return copyTo(c, &(c->gen2), o, size);
+        o = copyTo(c, &(c->gen2), o, size);
+
+        if (c->compacting) {
+          // tenured objects are compacted along with the rest of gen2
+          c->heapMap.set(o);
+        }
+
+        return o;
       } else {
         return copyTo(c, &(c->nextGen2), o, size);
       }
@@ -1127,6 +1500,37 @@ void* copy(Context* c, void* o)
   return r;
 }
 
+void** grow(Context* c,
+            void** data,
+            unsigned size,
+            unsigned* capacity,
+            unsigned minimum)
+{
+  unsigned newCapacity = max(*capacity * 2, minimum);
+  void** newData = static_cast<void**>(
+      vm::allocate(c->system, newCapacity * BytesPerWord));
+
+  memcpy(newData, data, size * BytesPerWord);
+  c->system->free(data);
+
+  *capacity = newCapacity;
+  return newData;
+}
+
+// push a gen2 object which has just been marked in place so we can
+// scan it later (see compact below):
+void pushMarked(Context* c, void* o)
+{
+  if (c->markStackSize == c->markStackCapacity) {
+    c->markStack = grow(c,
+                        c->markStack,
+                        c->markStackSize,
+                        &(c->markStackCapacity),
+                        InitialGrayStackCapacity);
+  }
+  c->markStack[c->markStackSize++] = o;
+}
+
 void* update3(Context* c, void* o, bool* needsVisit)
 {
   if (c->client->isFixed(o)) {
@@ -1161,6 +1565,15 @@ void* update2(Context* c, void* o, bool* needsVisit)
     return o;
   }
 
+  if (c->compacting and c->gen2.contains(o)) {
+    if (c->gen2.indexOf(o) < c->compactBase and not c->pointerMap.get(o)) {
+      c->heapMap.set(o);
+      pushMarked(c, o);
+    }
+    *needsVisit = false;
+    return o;
+  }
+
   return update3(c, o, needsVisit);
 }
 
@@ -1202,6 +1615,11 @@ void updateHeapMap(Context* c,
   if (c->mode == Heap::MinorCollection) {
     seg = &(c->gen2);
     map = &(c->heapMap);
+  } else if (c->compacting) {
+    // heapMap holds mark bits until we're done compacting, after
+    // which we rebuild it from scratch
+    seg = &(c->gen2);
+    map = 0;
   } else {
     seg = &(c->nextGen2);
     map = &(c->nextHeapMap);
@@ -1210,7 +1628,7 @@ void updateHeapMap(Context* c,
   if (not(immortalHeapContains(c, result)
           or (c->client->isFixed(result)
               and fixie(result)->age >= FixieTenureThreshold)
-          or seg->contains(result))) {
+          or seg->reserves(result))) {
     if (target and c->client->isFixed(target)) {
       Fixie* f = fixie(target);
       assertT(c, offset == 0 or f->hasMask());
@@ -1225,10 +1643,16 @@ void updateHeapMap(Context* c,
                   result);
         }
 
-        f->dirty(true);
-        markBit(f->mask(), offset);
+        if (c->parallel) {
+          ACQUIRE(c->fixieLock);
+          f->dirty(true);
+          markBit(f->mask(), offset);
+        } else {
+          f->dirty(true);
+          markBit(f->mask(), offset);
+        }
       }
-    } else if (seg->contains(p)) {
+    } else if (map and seg->reserves(p)) {
       if (Debug) {
         fprintf(stderr,
                 "mark %p (%s) at %p (%s)\n",
@@ -1238,7 +1662,15 @@ void updateHeapMap(Context* c,
                 segment(c, p));
       }
 
+#ifdef USE_ATOMIC_OPERATIONS
+      if (c->parallel) {
+        map->markAtomic(p);
+      } else {
+        map->set(p);
+      }
+#else
       map->set(p);
+#endif
     }
   }
 }
@@ -1363,120 +1795,864 @@ unsigned bitsetNext(Context* c, uintptr_t* p)
   }
 }
 
-void collect(Context* c, void** p, void* target, unsigned offset)
-{
-  void* original = maskAlignedPointer(*p);
-  void* parent_ = 0;
+#ifdef USE_ATOMIC_OPERATIONS
 
-  if (Debug) {
-    fprintf(stderr,
-            "update %p (%s) at %p (%s)\n",
-            maskAlignedPointer(*p),
-            segment(c, *p),
-            p,
-            segment(c, p));
+// Parallel collection.  When the heap is created with more than one
+// collector thread, collect2 still enumerates roots, dirty gen2 words,
+// and dirty fixies on the collecting thread, but instead of tracing
+// each one immediately it merely copies the referenced object and
+// pushes the copy onto a gray stack.  The transitive closure is then
+// computed by all workers together, each scanning gray objects from
+// its own stack and stealing from the others when it runs out.
+//
+// Copies are allocated from per-worker copy buffers carved out of the
+// target segments, and a copy is published by storing the forwarding
+// pointer in the original while holding one of a set of striped claim
+// words.  Readers check for a forwarding pointer without taking any
+// lock.  Unlike the serial collector, the parallel one never modifies
+// the body of an original object, so other workers may safely read
+// e.g. class metadata from an original while it is being copied.
+
+class CopyBuffer {
+ public:
+  CopyBuffer() : segment(0), position(0), limit(0)
+  {
   }
 
-  bool needsVisit;
-  local::set(p, update(c, maskAlignedPointer(p), target, offset, &needsVisit));
-
-  if (Debug) {
-    fprintf(stderr,
-            "  result: %p (%s) (visit? %d)\n",
-            maskAlignedPointer(*p),
-            segment(c, *p),
-            needsVisit);
+  CopyBuffer(Segment* segment) : segment(segment), position(0), limit(0)
+  {
   }
 
-  if (not needsVisit)
-    return;
-
-visit : {
-  void* copy = follow(c, original);
+  Segment* segment;
+  unsigned position;
+  unsigned limit;
+};
 
-  class Walker : public Heap::Walker {
-   public:
-    Walker(Context* c, void* copy, uintptr_t* bitset)
-        : c(c),
-          copy(copy),
-          bitset(bitset),
-          first(0),
-          second(0),
-          last(0),
-          visits(0),
-          total(0)
-    {
+class Worker : public System::Runnable {
+ public:
+  Worker(Context* c, unsigned index)
+      : c(c),
+        thread(0),
+        index(index),
+        stack(static_cast<void**>(
+            vm::allocate(c->system, InitialGrayStackCapacity * BytesPerWord))),
+        stackSize(0),
+        stackCapacity(InitialGrayStackCapacity),
+        lock(0),
+        shared(static_cast<void**>(
+            vm::allocate(c->system, InitialGrayStackCapacity * BytesPerWord))),
+        sharedSize(0),
+        sharedCapacity(InitialGrayStackCapacity),
+        tenureFootprint(0),
+        newlyTenuredFootprint(0),
+        copyCount(0),
+        copyFootprint(0),
+        scanCount(0),
+        stealCount(0),
+        interrupted_(false)
+  {
+    if (not c->system->success(c->system->make(&lock))) {
+      c->system->abort();
     }
+  }
 
-    virtual bool visit(unsigned offset)
-    {
-      if (Debug) {
-        fprintf(stderr,
-                "  update %p (%s) at %p - offset %d from %p (%s)\n",
-                get(copy, offset),
-                segment(c, get(copy, offset)),
-                getp(copy, offset),
-                offset,
-                copy,
-                segment(c, copy));
-      }
+  virtual void attach(System::Thread* t)
+  {
+    thread = t;
+  }
 
-      bool needsVisit;
-      void* childCopy
-          = update(c, getp(copy, offset), copy, offset, &needsVisit);
+  virtual void run();
 
-      if (Debug) {
-        fprintf(stderr,
-                "    result: %p (%s) (visit? %d)\n",
-                childCopy,
-                segment(c, childCopy),
-                needsVisit);
-      }
+  virtual bool interrupted()
+  {
+    return interrupted_;
+  }
 
-      ++total;
+  virtual void setInterrupted(bool v)
+  {
+    interrupted_ = v;
+  }
 
-      if (total == 3) {
-        bitsetInit(bitset);
-      }
+  void dispose()
+  {
+    lock->dispose();
+    c->system->free(stack);
+    c->system->free(shared);
+  }
 
-      if (needsVisit) {
-        ++visits;
+  Context* c;
+  System::Thread* thread;
+  unsigned index;
 
-        if (visits == 1) {
-          first = offset;
-        } else if (visits == 2) {
-          second = offset;
-        }
-      } else {
-        local::set(copy, offset, childCopy);
-      }
+  // gray objects visible only to this worker:
+  void** stack;
+  unsigned stackSize;
+  unsigned stackCapacity;
 
-      if (visits > 1 and total > 2 and (second or needsVisit)) {
-        bitsetClear(bitset, last, offset);
-        last = offset;
+  // gray objects which other workers may steal, guarded by lock:
+  System::Mutex* lock;
+  void** shared;
+  unsigned sharedSize;
+  unsigned sharedCapacity;
 
-        if (second) {
-          bitsetSet(bitset, second, true);
-          second = 0;
-        }
+  CopyBuffer nextGen1Buffer;
+  CopyBuffer gen2Buffer;
+  CopyBuffer nextGen2Buffer;
 
-        if (needsVisit) {
-          bitsetSet(bitset, offset, true);
-        }
-      }
+  unsigned tenureFootprint;
+  unsigned newlyTenuredFootprint;
 
-      return true;
-    }
+  unsigned copyCount;
+  unsigned copyFootprint;
+  unsigned scanCount;
+  unsigned stealCount;
 
-    Context* c;
-    void* copy;
-    uintptr_t* bitset;
-    unsigned first;
-    unsigned second;
-    unsigned last;
-    unsigned visits;
-    unsigned total;
-  } walker(c, copy, bitset(c, original));
+  bool interrupted_;
+};
+
+inline void atomicAdd(unsigned* p, int v)
+{
+  for (unsigned old = *p; not atomicCompareAndSwap32(
+           reinterpret_cast<uint32_t*>(p), old, old + v);
+       old = *p) {
+  }
+}
+
+inline void push(Worker* w, void* o)
+{
+  if (w->stackSize == w->stackCapacity) {
+    w->stack = grow(
+        w->c, w->stack, w->stackSize, &(w->stackCapacity), w->stackSize + 1);
+  }
+  w->stack[w->stackSize++] = o;
+}
+
+// move the top half of the private stack to the shared one
+void publish(Worker* w)
+{
+  unsigned count = w->stackSize / 2;
+
+  ACQUIRE(w->lock);
+
+  if (w->sharedSize + count > w->sharedCapacity) {
+    w->shared = grow(w->c,
+                     w->shared,
+                     w->sharedSize,
+                     &(w->sharedCapacity),
+                     w->sharedSize + count);
+  }
+
+  w->stackSize -= count;
+  memcpy(w->shared + w->sharedSize,
+         w->stack + w->stackSize,
+         count * BytesPerWord);
+  w->sharedSize += count;
+}
+
+// move gray objects from the victim's shared stack to our private
+// one: all of them if the victim is us, otherwise half
+bool take(Worker* w, Worker* victim)
+{
+  if (victim->sharedSize == 0) {
+    return false;
+  }
+
+  ACQUIRE(victim->lock);
+
+  unsigned size = victim->sharedSize;
+  if (size == 0) {
+    return false;
+  }
+
+  unsigned count = victim == w ? size : ceilingDivide(size, 2);
+
+  if (w->stackSize + count > w->stackCapacity) {
+    w->stack = grow(w->c,
+                    w->stack,
+                    w->stackSize,
+                    &(w->stackCapacity),
+                    w->stackSize + count);
+  }
+
+  memcpy(w->stack + w->stackSize,
+         victim->shared + size - count,
+         count * BytesPerWord);
+  w->stackSize += count;
+  victim->sharedSize = size - count;
+
+  return true;
+}
+
+inline bool pop(Worker* w, void** o)
+{
+  if (w->stackSize == 0 and not take(w, w)) {
+    return false;
+  }
+
+  if (w->stackSize > 1 and w->sharedSize == 0
+      and w->c->activeWorkers < w->c->drainWorkers) {
+    // somebody is idle, so give them something to do
+    publish(w);
+  }
+
+  *o = w->stack[--w->stackSize];
+  return true;
+}
+
+bool steal(Worker* w)
+{
+  Context* c = w->c;
+  for (unsigned i = 1; i < c->drainWorkers; ++i) {
+    if (take(w, c->workers + ((w->index + i) % c->drainWorkers))) {
+      ++w->stealCount;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool maySteal(Context* c)
+{
+  for (unsigned i = 0; i < c->drainWorkers; ++i) {
+    if (c->workers[i].sharedSize) {
+      return true;
+    }
+  }
+  return false;
+}
+
+inline uintptr_t* claimWord(Context* c, void* o)
+{
+  return c->claims
+         + ((reinterpret_cast<uintptr_t>(o) / BytesPerWord) % ClaimStripeCount);
+}
+
+inline void acquireClaim(uintptr_t* p)
+{
+  while (not atomicCompareAndSwap(p, 0, 1)) {
+    while (*static_cast<volatile uintptr_t*>(p)) {
+    }
+  }
+}
+
+inline void releaseClaim(uintptr_t* p)
+{
+  storeStoreMemoryBarrier();
+  *static_cast<volatile uintptr_t*>(p) = 0;
+}
+
+void* copyTo(Worker* w, CopyBuffer* b, void* o, unsigned size)
+{
+  Context* c = w->c;
+  Segment* s = b->segment;
+  unsigned start;
+
+  if (b->position + size > b->limit) {
+    if (size > CopyBufferSizeInWords / 4
+        or b->limit - b->position > MaxCopyBufferWasteInWords) {
+      // allocate directly from the segment rather than waste what's
+      // left in the buffer
+      expect(c, s->claim(size, &start));
+
+      void* dst = s->data + start;
+      c->client->copy(o, dst);
+      return dst;
+    }
+
+    if (s->claim(CopyBufferSizeInWords, &start)) {
+      b->limit = start + CopyBufferSizeInWords;
+    } else {
+      expect(c, s->claim(size, &start));
+      b->limit = start + size;
+    }
+    b->position = start;
+  }
+
+  void* dst = s->data + b->position;
+  b->position += size;
+  c->client->copy(o, dst);
+  return dst;
+}
+
+void* copy2(Worker* w, void* o)
+{
+  Context* c = w->c;
+  unsigned size = c->client->copiedSizeInWords(o);
+
+  ++w->copyCount;
+  w->copyFootprint += size;
+
+  if (c->gen2.contains(o)) {
+    assertT(c, c->mode == Heap::MajorCollection);
+
+    return copyTo(w, &(w->nextGen2Buffer), o, size);
+  } else if (c->gen1.contains(o)) {
+    unsigned age = c->ageMap.get(o);
+    if (age == TenureThreshold) {
+      w->newlyTenuredFootprint += size;
+
+      if (c->mode == Heap::MinorCollection) {
+        return copyTo(w, &(w->gen2Buffer), o, size);
+      } else {
+        return copyTo(w, &(w->nextGen2Buffer), o, size);
+      }
+    } else {
+      o = copyTo(w, &(w->nextGen1Buffer), o, size);
+
+      c->nextAgeMap.setOnlyAtomic(o, age + 1);
+      if (age + 1 == TenureThreshold) {
+        w->tenureFootprint += size;
+      }
+
+      return o;
+    }
+  } else {
+    assertT(c, not c->nextGen1.reserves(o));
+    assertT(c, not c->nextGen2.reserves(o));
+    assertT(c, not immortalHeapContains(c, o));
+
+    o = copyTo(w, &(w->nextGen1Buffer), o, size);
+
+    c->nextAgeMap.setOnlyAtomic(o, 0);
+
+    return o;
+  }
+}
+
+void* update3(Worker* w, void* o, bool* needsVisit)
+{
+  Context* c = w->c;
+
+  *needsVisit = false;
+
+  if (c->client->isFixed(o)) {
+    Fixie* f = fixie(o);
+    if ((not f->marked()) and (c->mode == Heap::MajorCollection
+                               or f->age < FixieTenureThreshold)) {
+      bool marked = false;
+      {
+        ACQUIRE(c->fixieLock);
+
+        if (not f->marked()) {
+          if (DebugFixies) {
+            fprintf(stderr, "mark fixie %p\n", f);
+          }
+          f->marked(true);
+          f->dead(false);
+          f->move(c, &(c->visitedFixies));
+          marked = true;
+        }
+      }
+
+      if (marked) {
+        push(w, f->body());
+      }
+    }
+    return o;
+  } else if (immortalHeapContains(c, o)) {
+    return o;
+  } else if (wasCollected(c, o)) {
+    loadMemoryBarrier();
+    return follow(c, o);
+  } else {
+    uintptr_t* claim = claimWord(c, o);
+    acquireClaim(claim);
+
+    if (wasCollected(c, o)) {
+      // somebody beat us to it
+      releaseClaim(claim);
+      return follow(c, o);
+    }
+
+    void* r = copy2(w, o);
+
+    if (Debug) {
+      fprintf(stderr,
+              "copy %p (%s) to %p (%s) on worker %d\n",
+              o,
+              segment(c, o),
+              r,
+              segment(c, r),
+              w->index);
+    }
+
+    // make sure the copy is complete before anyone can see it:
+    storeStoreMemoryBarrier();
+    fieldAtOffset<void*>(o, 0) = r;
+
+    releaseClaim(claim);
+
+    *needsVisit = true;
+    return r;
+  }
+}
+
+void* update(Worker* w,
+             void** p,
+             void* target,
+             unsigned offset,
+             bool* needsVisit)
+{
+  Context* c = w->c;
+  void* o = maskAlignedPointer(*p);
+
+  if (o == 0) {
+    *needsVisit = false;
+    return 0;
+  }
+
+  void* result;
+  if (c->mode == Heap::MinorCollection and c->gen2.contains(o)) {
+    *needsVisit = false;
+    result = o;
+  } else {
+    result = update3(w, o, needsVisit);
+  }
+
+  updateHeapMap(c, p, target, offset, result);
+
+  return result;
+}
+
+void scan(Worker* w, void* o)
+{
+  class Walker : public Heap::Walker {
+   public:
+    Walker(Worker* w, void* o) : w(w), o(o)
+    {
+    }
+
+    virtual bool visit(unsigned offset)
+    {
+      bool needsVisit;
+      void* result = update(w, getp(o, offset), o, offset, &needsVisit);
+
+      local::set(o, offset, result);
+
+      if (needsVisit) {
+        push(w, result);
+      }
+
+      return true;
+    }
+
+    Worker* w;
+    void* o;
+  } walker(w, o);
+
+  if (Debug) {
+    fprintf(stderr, "scan %p (%s) on worker %d\n", o, segment(w->c, o), w->index);
+  }
+
+  ++w->scanCount;
+  w->c->client->walk(o, &walker);
+}
+
+void work(Worker* w)
+{
+  Context* c = w->c;
+
+  while (true) {
+    void* o;
+    while (pop(w, &o)) {
+      scan(w, o);
+    }
+
+    if (steal(w)) {
+      continue;
+    }
+
+    atomicAdd(&(c->activeWorkers), -1);
+
+    // wait until either everybody is idle (in which case we're done)
+    // or there's something to steal:
+    bool done = true;
+    while (c->activeWorkers) {
+      if (maySteal(c)) {
+        atomicAdd(&(c->activeWorkers), 1);
+        if (steal(w)) {
+          done = false;
+          break;
+        }
+        atomicAdd(&(c->activeWorkers), -1);
+      }
+      c->system->yield();
+    }
+
+    if (done) {
+      return;
+    }
+  }
+}
+
+void Worker::run()
+{
+  unsigned generation = 0;
+  while (true) {
+    {
+      ACQUIRE_MONITOR(thread, c->workerMonitor);
+
+      while (c->workerGeneration == generation and not c->workersDisposed) {
+        c->workerMonitor->wait(thread, 0);
+      }
+
+      if (c->workersDisposed) {
+        return;
+      }
+
+      generation = c->workerGeneration;
+    }
+
+    work(this);
+
+    {
+      ACQUIRE_MONITOR(thread, c->workerMonitor);
+
+      if (--c->busyWorkers == 0) {
+        c->workerMonitor->notifyAll(thread);
+      }
+    }
+  }
+}
+
+// trace everything reachable from the gray stacks, using all the
+// workers if parallel is true and only the collecting thread
+// otherwise:
+void drain(Context* c, bool parallel)
+{
+  Worker* w = c->workers;
+
+  if (parallel) {
+    {
+      ACQUIRE_MONITOR(w->thread, c->workerMonitor);
+
+      c->drainWorkers = c->workerCount;
+      c->activeWorkers = c->workerCount;
+      c->busyWorkers = c->workerCount - 1;
+      ++c->workerGeneration;
+
+      c->workerMonitor->notifyAll(w->thread);
+    }
+
+    work(w);
+
+    {
+      ACQUIRE_MONITOR(w->thread, c->workerMonitor);
+
+      while (c->busyWorkers) {
+        c->workerMonitor->wait(w->thread, 0);
+      }
+    }
+  } else {
+    c->drainWorkers = 1;
+    c->activeWorkers = 1;
+
+    work(w);
+  }
+}
+
+void parallelCollect(Context* c, void** p, void* target, unsigned offset)
+{
+  Worker* w = c->workers;
+
+  bool needsVisit;
+  void* result = update(w, maskAlignedPointer(p), target, offset, &needsVisit);
+
+  local::set(p, result);
+
+  if (needsVisit) {
+    push(w, result);
+  }
+
+  if (c->postVisiting) {
+    // the client expects the status of everything reachable from
+    // this root to be settled by the time we return
+    drain(c, false);
+  }
+}
+
+void startParallelCollection(Context* c)
+{
+  for (unsigned i = 0; i < c->workerCount; ++i) {
+    Worker* w = c->workers + i;
+
+    assertT(c, w->stackSize == 0);
+    assertT(c, w->sharedSize == 0);
+
+    w->nextGen1Buffer = CopyBuffer(&(c->nextGen1));
+    w->gen2Buffer = CopyBuffer(&(c->gen2));
+    w->nextGen2Buffer = CopyBuffer(&(c->nextGen2));
+    w->tenureFootprint = 0;
+    w->newlyTenuredFootprint = 0;
+    w->copyCount = 0;
+    w->copyFootprint = 0;
+    w->scanCount = 0;
+    w->stealCount = 0;
+  }
+
+  // copies may be made by several workers at once, so we can't wait
+  // until the first one to decide where fresh gen2 objects start:
+  c->gen2Base = c->gen2.position();
+
+  c->parallel = true;
+}
+
+void retire(CopyBuffer* b)
+{
+  if (b->limit > b->position) {
+    // this only succeeds if the buffer is at the end of the segment
+    b->segment->unclaim(b->position, b->limit);
+  }
+}
+
+void finishParallelCollection(Context* c)
+{
+  drain(c, not c->postVisiting);
+
+  for (unsigned i = 0; i < c->workerCount; ++i) {
+    Worker* w = c->workers + i;
+
+    retire(&(w->nextGen1Buffer));
+    retire(&(w->gen2Buffer));
+    retire(&(w->nextGen2Buffer));
+
+    c->tenureFootprint += w->tenureFootprint;
+    c->newlyTenuredFootprint += w->newlyTenuredFootprint;
+  }
+
+  c->parallel = false;
+  c->postVisiting = false;
+}
+
+void initWorkers(Context* c)
+{
+  c->workers = static_cast<Worker*>(
+      vm::allocate(c->system, sizeof(Worker) * c->workerCount));
+
+  for (unsigned i = 0; i < c->workerCount; ++i) {
+    new (c->workers + i) Worker(c, i);
+  }
+
+  c->claims = static_cast<uintptr_t*>(
+      vm::allocate(c->system, ClaimStripeCount * BytesPerWord));
+  memset(c->claims, 0, ClaimStripeCount * BytesPerWord);
+
+  if (not(c->system->success(c->system->make(&(c->fixieLock)))
+          and c->system->success(c->system->make(&(c->workerMonitor))))) {
+    c->system->abort();
+  }
+
+  // the first worker is whichever thread happens to be collecting;
+  // collections never overlap, so they can all share one context:
+  expect(c, c->system->success(c->system->attach(c->workers)));
+
+  for (unsigned i = 1; i < c->workerCount; ++i) {
+    expect(c, c->system->success(c->system->start(c->workers + i)));
+  }
+}
+
+void disposeWorkers(Context* c)
+{
+  if (c->workers) {
+    Worker* w = c->workers;
+
+    {
+      ACQUIRE_MONITOR(w->thread, c->workerMonitor);
+
+      c->workersDisposed = true;
+      c->workerMonitor->notifyAll(w->thread);
+    }
+
+    for (unsigned i = 1; i < c->workerCount; ++i) {
+      c->workers[i].thread->join();
+      c->workers[i].thread->dispose();
+    }
+    w->thread->dispose();
+
+    for (unsigned i = 0; i < c->workerCount; ++i) {
+      c->workers[i].dispose();
+    }
+
+    c->system->free(c->workers);
+    c->system->free(c->claims);
+    c->fixieLock->dispose();
+    c->workerMonitor->dispose();
+
+    c->workers = 0;
+  }
+}
+
+void printWorkerStatistics(Context* c)
+{
+  for (unsigned i = 0; i < c->workerCount; ++i) {
+    Worker* w = c->workers + i;
+    fprintf(stderr,
+            " -        worker %2d: %8d objects; %8d bytes copied; "
+            "%8d scanned; %4d steals\n",
+            i,
+            w->copyCount,
+            w->copyFootprint * BytesPerWord,
+            w->scanCount,
+            w->stealCount);
+  }
+}
+
+#else  // not USE_ATOMIC_OPERATIONS
+
+void parallelCollect(Context* c, void**, void*, unsigned)
+{
+  abort(c);
+}
+
+void drain(Context* c, bool)
+{
+  abort(c);
+}
+
+void startParallelCollection(Context* c)
+{
+  abort(c);
+}
+
+void finishParallelCollection(Context* c)
+{
+  abort(c);
+}
+
+void initWorkers(Context* c)
+{
+  abort(c);
+}
+
+void disposeWorkers(Context*)
+{
+}
+
+void printWorkerStatistics(Context*)
+{
+}
+
+#endif  // not USE_ATOMIC_OPERATIONS
+
+void collect(Context* c, void** p, void* target, unsigned offset)
+{
+  if (c->parallel) {
+    parallelCollect(c, p, target, offset);
+    return;
+  }
+
+  void* original = maskAlignedPointer(*p);
+  void* parent_ = 0;
+
+  if (Debug) {
+    fprintf(stderr,
+            "update %p (%s) at %p (%s)\n",
+            maskAlignedPointer(*p),
+            segment(c, *p),
+            p,
+            segment(c, p));
+  }
+
+  bool needsVisit;
+  local::set(p, update(c, maskAlignedPointer(p), target, offset, &needsVisit));
+
+  if (Debug) {
+    fprintf(stderr,
+            "  result: %p (%s) (visit? %d)\n",
+            maskAlignedPointer(*p),
+            segment(c, *p),
+            needsVisit);
+  }
+
+  if (not needsVisit)
+    return;
+
+visit : {
+  void* copy = follow(c, original);
+
+  class Walker : public Heap::Walker {
+   public:
+    Walker(Context* c, void* copy, uintptr_t* bitset)
+        : c(c),
+          copy(copy),
+          bitset(bitset),
+          first(0),
+          second(0),
+          last(0),
+          visits(0),
+          total(0)
+    {
+    }
+
+    virtual bool visit(unsigned offset)
+    {
+      if (Debug) {
+        fprintf(stderr,
+                "  update %p (%s) at %p - offset %d from %p (%s)\n",
+                get(copy, offset),
+                segment(c, get(copy, offset)),
+                getp(copy, offset),
+                offset,
+                copy,
+                segment(c, copy));
+      }
+
+      bool needsVisit;
+      void* childCopy
+          = update(c, getp(copy, offset), copy, offset, &needsVisit);
+
+      if (Debug) {
+        fprintf(stderr,
+                "    result: %p (%s) (visit? %d)\n",
+                childCopy,
+                segment(c, childCopy),
+                needsVisit);
+      }
+
+      ++total;
+
+      if (total == 3) {
+        bitsetInit(bitset);
+      }
+
+      if (needsVisit) {
+        ++visits;
+
+        if (visits == 1) {
+          first = offset;
+        } else if (visits == 2) {
+          second = offset;
+        }
+      } else {
+        local::set(copy, offset, childCopy);
+      }
+
+      if (visits > 1 and total > 2 and (second or needsVisit)) {
+        bitsetClear(bitset, last, offset);
+        last = offset;
+
+        if (second) {
+          bitsetSet(bitset, second, true);
+          second = 0;
+        }
+
+        if (needsVisit) {
+          bitsetSet(bitset, offset, true);
+        }
+      }
+
+      return true;
+    }
+
+    Context* c;
+    void* copy;
+    uintptr_t* bitset;
+    unsigned first;
+    unsigned second;
+    unsigned last;
+    unsigned visits;
+    unsigned total;
+  } walker(c, copy, bitset(c, original));
 
   if (Debug) {
     fprintf(stderr, "walk %p (%s)\n", copy, segment(c, copy));
@@ -1672,6 +2848,39 @@ void visitMarkedFixies(Context* c)
   }
 }
 
+void visitMarkedGen2(Context* c)
+{
+  while (c->markStackSize) {
+    void* o = c->markStack[--c->markStackSize];
+
+    class Walker : public Heap::Walker {
+     public:
+      Walker(Context* c, void* o) : c(c), o(o)
+      {
+      }
+
+      virtual bool visit(unsigned offset)
+      {
+        local::collect(c, o, offset);
+        return true;
+      }
+
+      Context* c;
+      void* o;
+    } w(c, o);
+
+    c->client->walk(o, &w);
+  }
+}
+
+void visitMarked(Context* c)
+{
+  do {
+    visitMarkedFixies(c);
+    visitMarkedGen2(c);
+  } while (c->markedFixies);
+}
+
 void collect(Context* c,
              Segment::Map* map,
              unsigned start,
@@ -1716,10 +2925,354 @@ void collect(Context* c,
   assertT(c, wasDirty or not expectDirty);
 }
 
+// Compaction.  When the heap is created with compaction enabled, a
+// major collection which need not grow or shrink gen2 compacts it in
+// place instead of copying it to nextGen2, so it never needs more
+// than one copy of gen2 at a time.  While tracing, collect2 marks
+// each reachable gen2 object in heapMap (and thus pageMap and
+// pointerMap) without moving it, tenures objects from gen1 to the
+// end of gen2 as a minor collection would, and scans marked objects
+// from an explicit stack, since we can't borrow their bodies for the
+// traversal as the serial collector does for copied objects.  compact
+// then:
+//
+//  1. visits each marked object in address order while the client
+//     can still inspect it, noting where it ends, whether it will
+//     grow (i.e. its hash has been taken but not yet stored), and
+//     which of its words are references, and recording where the
+//     first object in each block of BitsPerWord words will end up;
+//
+//  2. updates every reference to gen2: those in nextGen1 and fixies,
+//     those in gen2 itself, and those the client reports via
+//     Client::updateRoots;
+//
+//  3. slides each object down to its new location; and
+//
+//  4. rebuilds heapMap as a remembered set.
+//
+// An object only grows if it moves, in which case there's at least
+// one free word below it, so no object ever ends up higher than it
+// started.
+
+class Compaction {
+ public:
+  unsigned end;
+  uintptr_t* ends;
+  uintptr_t* grows;
+  uintptr_t* references;
+  unsigned* blocks;
+  void** slots;
+  unsigned slotCount;
+  unsigned slotCapacity;
+  void** roots;
+  unsigned rootCount;
+  unsigned rootCapacity;
+};
+
+void clearMap(Segment::Map* map)
+{
+  for (; map; map = map->child) {
+    memset(map->data, 0, map->size() * BytesPerWord);
+  }
+}
+
+// returns the index of the first bit set in map at or after start,
+// or limit if there is none before it
+unsigned nextBit(uintptr_t* map, unsigned start, unsigned limit)
+{
+  for (unsigned i = start; i < limit;) {
+    uintptr_t w = map[wordOf(i)] >> bitOf(i);
+    if (w) {
+      while ((w & 1) == 0) {
+        w >>= 1;
+        ++i;
+      }
+      return i < limit ? i : limit;
+    }
+    i = (wordOf(i) + 1) * BitsPerWord;
+  }
+  return limit;
+}
+
+unsigned forward(Context* c, Compaction* x, unsigned index)
+{
+  uintptr_t* marks = c->pointerMap.data;
+  assertT(c, getBit(marks, index));
+
+  unsigned block = index / BitsPerWord;
+  unsigned n = x->blocks[block];
+  for (unsigned i = nextBit(marks, block * BitsPerWord, index); i < index;
+       i = nextBit(marks, i + 1, index)) {
+    unsigned size = nextBit(x->ends, i, x->end) + 1 - i;
+    if (n != i and getBit(x->grows, i)) {
+      ++size;
+    }
+    n += size;
+  }
+
+  return n;
+}
+
+void forward(Context* c, Compaction* x, void** p)
+{
+  void* o = maskAlignedPointer(*p);
+  if (o and c->gen2.contains(o)) {
+    local::set(p, c->gen2.data + forward(c, x, c->gen2.indexOf(o)));
+  }
+}
+
+void addSlot(Context* c, Compaction* x, void** p)
+{
+  if (x->slotCount == x->slotCapacity) {
+    x->slots = grow(c,
+                    x->slots,
+                    x->slotCount,
+                    &(x->slotCapacity),
+                    InitialGrayStackCapacity);
+  }
+  x->slots[x->slotCount++] = p;
+}
+
+// remember each slot in the specified object which refers to gen2
+void addSlots(Context* c, Compaction* x, void* o)
+{
+  class Walker : public Heap::Walker {
+   public:
+    Walker(Context* c, Compaction* x, void* o) : c(c), x(x), o(o)
+    {
+    }
+
+    virtual bool visit(unsigned offset)
+    {
+      void** p = getp(o, offset);
+      if (c->gen2.contains(maskAlignedPointer(*p))) {
+        addSlot(c, x, p);
+      }
+      return true;
+    }
+
+    Context* c;
+    Compaction* x;
+    void* o;
+  } w(c, x, o);
+
+  c->client->walk(o, &w);
+}
+
+void plan(Context* c, Compaction* x)
+{
+  uintptr_t* marks = c->pointerMap.data;
+  unsigned n = 0;
+  unsigned lastBlock = Top;
+
+  c->gen2Padding = 0;
+
+  for (unsigned i = nextBit(marks, 0, x->end); i < x->end;) {
+    void* o = c->gen2.data + i;
+
+    if (i / BitsPerWord != lastBlock) {
+      lastBlock = i / BitsPerWord;
+      x->blocks[lastBlock] = n;
+    }
+
+    unsigned size = c->client->sizeInWords(o);
+    bool grows = c->client->copiedSizeInWords(o) > size;
+
+    markBit(x->ends, i + size - 1);
+
+    if (grows) {
+      markBit(x->grows, i);
+
+      if (n == i) {
+        // it stays put, so it may still grow the next time we copy
+        // or compact
+        ++c->gen2Padding;
+      }
+    }
+
+    class Walker : public Heap::Walker {
+     public:
+      Walker(uintptr_t* references, unsigned index)
+          : references(references), index(index)
+      {
+      }
+
+      virtual bool visit(unsigned offset)
+      {
+        markBit(references, index + offset);
+        return true;
+      }
+
+      uintptr_t* references;
+      unsigned index;
+    } w(x->references, i);
+
+    c->client->walk(o, &w);
+
+    n += (n != i and grows) ? size + 1 : size;
+    i = nextBit(marks, i + size, x->end);
+  }
+}
+
+void updateReferences(Context* c, Compaction* x)
+{
+  // first, find the references in nextGen1 and fixies, since we may
+  // need the client's help to do so, and it can't make sense of
+  // anything once we've started updating gen2:
+
+  for (unsigned i = 0; i < c->nextGen1.position();) {
+    void* o = c->nextGen1.data + i;
+    addSlots(c, x, o);
+    i += c->client->sizeInWords(o);
+  }
+
+  for (Fixie* f = c->visitedFixies; f; f = f->next) {
+    addSlots(c, x, f->body());
+  }
+
+  class Visitor : public Heap::Visitor {
+   public:
+    Visitor(Context* c, Compaction* x) : c(c), x(x)
+    {
+    }
+
+    virtual void visit(void* p)
+    {
+      void* o = maskAlignedPointer(*static_cast<void**>(p));
+      if (c->gen2.contains(o)) {
+        if (x->rootCount + 2 > x->rootCapacity) {
+          x->roots = grow(c,
+                          x->roots,
+                          x->rootCount,
+                          &(x->rootCapacity),
+                          InitialGrayStackCapacity);
+        }
+        // remember the original value as well as the slot, since the
+        // client may report the same slot more than once, or report
+        // one we'll have already updated while updating gen2:
+        x->roots[x->rootCount++] = p;
+        x->roots[x->rootCount++] = o;
+      }
+    }
+
+    Context* c;
+    Compaction* x;
+  } v(c, x);
+
+  c->client->updateRoots(&v);
+
+  for (unsigned i = 0; i < x->slotCount; ++i) {
+    forward(c, x, static_cast<void**>(x->slots[i]));
+  }
+
+  for (unsigned i = nextBit(x->references, 0, x->end); i < x->end;
+       i = nextBit(x->references, i + 1, x->end)) {
+    forward(c, x, reinterpret_cast<void**>(c->gen2.data + i));
+  }
+
+  for (unsigned i = 0; i < x->rootCount; i += 2) {
+    void** p = static_cast<void**>(x->roots[i]);
+    if (maskAlignedPointer(*p) == x->roots[i + 1]) {
+      forward(c, x, p);
+    }
+  }
+}
+
+unsigned slide(Context* c, Compaction* x)
+{
+  uintptr_t* marks = c->pointerMap.data;
+  unsigned n = 0;
+
+  for (unsigned i = nextBit(marks, 0, x->end); i < x->end;) {
+    unsigned size = nextBit(x->ends, i, x->end) + 1 - i;
+
+    if (n == i) {
+      n += size;
+    } else {
+      c->client->move(c->gen2.data + i, c->gen2.data + n, size);
+
+      // the reference bits move with the object, which is safe for
+      // the same reason moving the object itself is
+      for (unsigned j = nextBit(x->references, i, i + size); j < i + size;
+           j = nextBit(x->references, j + 1, i + size)) {
+        clearBit(x->references, j);
+        markBit(x->references, n + (j - i));
+      }
+
+      n += getBit(x->grows, i) ? size + 1 : size;
+    }
+
+    i = nextBit(marks, i + size, x->end);
+  }
+
+  return n;
+}
+
+void rebuildHeapMap(Context* c, Compaction* x)
+{
+  clearMap(&(c->heapMap));
+
+  unsigned end = c->gen2.position();
+  for (unsigned i = nextBit(x->references, 0, end); i < end;
+       i = nextBit(x->references, i + 1, end)) {
+    void** p = reinterpret_cast<void**>(c->gen2.data + i);
+    void* o = maskAlignedPointer(*p);
+    if (o and not(c->gen2.reserves(o) or immortalHeapContains(c, o)
+                  or (c->client->isFixed(o)
+                      and fixie(o)->age >= FixieTenureThreshold))) {
+      c->heapMap.set(p);
+    }
+  }
+}
+
+void compact(Context* c)
+{
+  assertT(c, c->markStackSize == 0);
+
+  Compaction x;
+  x.end = c->gen2.position();
+
+  unsigned mapSize = ceilingDivide(x.end, BitsPerWord);
+  unsigned blockCount = mapSize;
+  unsigned footprint = (mapSize * 3 * BytesPerWord)
+                       + (blockCount * sizeof(unsigned));
+
+  x.ends = static_cast<uintptr_t*>(local::allocate(c, footprint));
+  memset(x.ends, 0, mapSize * 3 * BytesPerWord);
+  x.grows = x.ends + mapSize;
+  x.references = x.grows + mapSize;
+  x.blocks = reinterpret_cast<unsigned*>(x.references + mapSize);
+  x.slots = 0;
+  x.slotCount = 0;
+  x.slotCapacity = 0;
+  x.roots = 0;
+  x.rootCount = 0;
+  x.rootCapacity = 0;
+
+  plan(c, &x);
+  updateReferences(c, &x);
+  c->gen2.position_ = slide(c, &x);
+  rebuildHeapMap(c, &x);
+
+  if (Verbose) {
+    fprintf(stderr,
+            "compacted gen2 from %d to %d bytes\n",
+            x.end * BytesPerWord,
+            c->gen2.position() * BytesPerWord);
+  }
+
+  c->system->free(x.slots);
+  c->system->free(x.roots);
+  local::free(c, x.ends, footprint);
+
+  c->compacting = false;
+}
+
 void collect2(Context* c)
 {
   c->gen2Base = Top;
   c->tenureFootprint = 0;
+  c->newlyTenuredFootprint = 0;
   c->fixieTenureFootprint = 0;
   c->gen1Padding = 0;
   c->tenurePadding = 0;
@@ -1728,6 +3281,15 @@ void collect2(Context* c)
     c->gen2Padding = 0;
   }
 
+  if (c->compacting) {
+    // gen2 objects are marked in place rather than copied, using
+    // heapMap to hold the mark bits:
+    c->compactBase = c->gen2.position();
+    clearMap(&(c->heapMap));
+  } else if (c->workerCount > 1) {
+    startParallelCollection(c);
+  }
+
   if (c->mode == Heap::MinorCollection and c->gen2.position()) {
     unsigned start = 0;
     unsigned end = start + c->gen2.position();
@@ -1748,13 +3310,17 @@ void collect2(Context* c)
     virtual void visit(void* p)
     {
       local::collect(c, static_cast<void**>(p));
-      visitMarkedFixies(c);
+      visitMarked(c);
     }
 
     Context* c;
   } v(c);
 
   c->client->visitRoots(&v);
+
+  if (c->parallel) {
+    finishParallelCollection(c);
+  }
 }
 
 bool limitExceeded(Context* c, int pendingAllocation)
@@ -1778,55 +3344,260 @@ bool limitExceeded(Context* c, int pendingAllocation)
   return count > c->limit;
 }
 
+// return the pages entirely within the specified range to the OS
+void uncommit(Context*, void* start, size_t sizeInBytes)
+{
+  const uintptr_t mask = Memory::PageSize - 1;
+  uintptr_t begin = (reinterpret_cast<uintptr_t>(start) + mask) & ~mask;
+  uintptr_t end = (reinterpret_cast<uintptr_t>(start) + sizeInBytes) & ~mask;
+
+  if (end > begin) {
+    Memory::decommit(
+        Slice<uint8_t>(reinterpret_cast<uint8_t*>(begin), end - begin));
+  }
+}
+
+// compaction leaves the tail of gen2 empty, so return what we don't
+// need to satisfy c->minFreeRatio to the OS
+void uncommitGen2Tail(Context* c, unsigned oldPosition)
+{
+  unsigned keep = min(withFreeRatio(c, c->gen2.position()), oldPosition);
+
+  if ((oldPosition - keep) * BytesPerWord >= MinUncommitSizeInBytes) {
+    uncommit(c, c->gen2.data + keep, (oldPosition - keep) * BytesPerWord);
+  }
+}
+
+unsigned pauseBucket(int64_t micros)
+{
+  if (micros < static_cast<int64_t>(PauseSubBuckets)) {
+    return max(micros, static_cast<int64_t>(0));
+  }
+
+  unsigned shift = 0;
+  while ((micros >> shift) >= static_cast<int64_t>(PauseSubBuckets * 2)) {
+    ++shift;
+  }
+
+  return min((shift + 1) * PauseSubBuckets
+             + static_cast<unsigned>(micros >> shift) - PauseSubBuckets,
+             PauseHistogramSize - 1);
+}
+
+// the shortest pause counted in the bucket after the specified one
+int64_t pauseBucketLimit(unsigned bucket)
+{
+  ++bucket;
+  if (bucket < PauseSubBuckets) {
+    return bucket;
+  } else {
+    return static_cast<int64_t>(PauseSubBuckets + (bucket % PauseSubBuckets))
+           << ((bucket / PauseSubBuckets) - 1);
+  }
+}
+
+void recordPause(Context* c, int64_t pause)
+{
+  ++c->collectionCount;
+  ++c->pauseHistogram[pauseBucket(pause)];
+  c->maxPauseTime = max(c->maxPauseTime, pause);
+}
+
+// returns the pause time, in microseconds, which at least the
+// specified percentage of collections have not exceeded, rounded up
+// to the end of its histogram bucket
+int64_t pauseTime(Context* c, unsigned percentile)
+{
+  if (c->collectionCount == 0) {
+    return 0;
+  } else if (percentile >= 100) {
+    return c->maxPauseTime;
+  }
+
+  unsigned target
+      = max(1u, ceilingDivide(c->collectionCount * percentile, 100u));
+  unsigned count = 0;
+  for (unsigned i = 0; i < PauseHistogramSize; ++i) {
+    count += c->pauseHistogram[i];
+    if (count >= target) {
+      return min(pauseBucketLimit(i) - 1, c->maxPauseTime);
+    }
+  }
+
+  return c->maxPauseTime;
+}
+
+// why a collection happened; anything but AllocationCause or
+// RequestedCause escalates it to a major collection
+enum CollectionCause {
+  AllocationCause,
+  RequestedCause,
+  LowMemoryCause,
+  OversizedGen2Cause,
+  UndersizedGen2Cause,
+  FixieCeilingCause
+};
+
+const char* causeName(CollectionCause cause)
+{
+  switch (cause) {
+  case AllocationCause:
+    return "allocation";
+  case RequestedCause:
+    return "requested";
+  case LowMemoryCause:
+    return "low memory";
+  case OversizedGen2Cause:
+    return "oversized gen2";
+  case UndersizedGen2Cause:
+    return "undersized gen2";
+  case FixieCeilingCause:
+    return "fixie ceiling";
+  default:
+    return "unknown";
+  }
+}
+
+// write a line of JSON describing the collection just finished
+void logCollection(Context* c,
+                   CollectionCause cause,
+                   bool compacted,
+                   int64_t start,
+                   int64_t pause,
+                   unsigned gen1Before,
+                   unsigned gen2Before,
+                   unsigned fixiesBefore)
+{
+  fprintf(c->logFile,
+          "{\"collection\":%u,\"type\":\"%s\",\"compacted\":%s,"
+          "\"cause\":\"%s\",\"start\":%lld,\"pauseMicros\":%lld,"
+          "\"gen1\":{\"before\":%u,\"after\":%u},"
+          "\"gen2\":{\"before\":%u,\"after\":%u},"
+          "\"fixies\":{\"before\":%u,\"after\":%u},"
+          "\"tenured\":%u}\n",
+          c->collectionCount,
+          c->mode == Heap::MajorCollection ? "major" : "minor",
+          compacted ? "true" : "false",
+          causeName(cause),
+          static_cast<long long>(start),
+          static_cast<long long>(pause),
+          gen1Before,
+          c->gen1.position() * BytesPerWord,
+          gen2Before,
+          c->gen2.position() * BytesPerWord,
+          fixiesBefore,
+          c->untenuredFixieFootprint + c->tenuredFixieFootprint,
+          c->newlyTenuredFootprint * BytesPerWord);
+
+  fflush(c->logFile);
+}
+
 void collect(Context* c)
 {
-  if (limitExceeded(c, c->pendingAllocation) or oversizedGen2(c)
-      or c->tenureFootprint + c->tenurePadding > c->gen2.remaining()
-      or c->fixieTenureFootprint + c->tenuredFixieFootprint
-         > c->tenuredFixieCeiling) {
+  unsigned tenureFootprint
+      = c->tenureFootprint + c->tenurePadding
+        + copyBufferSlack(c, c->tenureFootprint + c->tenurePadding);
+
+  // the VM asks for minor collections when it runs out of room to
+  // allocate, and for major ones when it wants everything collected
+  CollectionCause cause = c->mode == Heap::MajorCollection ? RequestedCause
+                                                           : AllocationCause;
+  bool escalate = true;
+  if (limitExceeded(c, c->pendingAllocation)) {
+    cause = LowMemoryCause;
+  } else if (oversizedGen2(c)) {
+    cause = OversizedGen2Cause;
+  } else if (tenureFootprint > c->gen2.remaining()) {
+    cause = UndersizedGen2Cause;
+  } else if (c->fixieTenureFootprint + c->tenuredFixieFootprint
+             > c->tenuredFixieCeiling) {
+    cause = FixieCeilingCause;
+  } else {
+    escalate = false;
+  }
+
+  if (escalate) {
     if (Verbose) {
-      if (limitExceeded(c, c->pendingAllocation)) {
-        fprintf(stderr, "low memory causes ");
-      } else if (oversizedGen2(c)) {
-        fprintf(stderr, "oversized gen2 causes ");
-      } else if (c->tenureFootprint + c->tenurePadding > c->gen2.remaining()) {
-        fprintf(stderr, "undersized gen2 causes ");
-      } else {
-        fprintf(stderr, "fixie ceiling causes ");
-      }
+      fprintf(stderr, "%s causes ", causeName(cause));
     }
 
     c->mode = Heap::MajorCollection;
   }
 
-  int64_t then;
+  // compaction can neither grow nor shrink gen2, so we copy it
+  // instead if it's too small or too big:
+  c->compacting = c->compact and c->mode == Heap::MajorCollection
+                  and c->gen2.position() and (not oversizedGen2(c))
+                  and tenureFootprint <= c->gen2.remaining();
+
+  bool compacted = c->compacting;
+  unsigned gen1Before = (c->gen1.position() + c->incomingFootprint)
+                        * BytesPerWord;
+  unsigned gen2Before = c->gen2.position() * BytesPerWord;
+  unsigned fixiesBefore = c->untenuredFixieFootprint
+                          + c->tenuredFixieFootprint;
+
   if (Verbose) {
-    if (c->mode == Heap::MajorCollection) {
+    if (c->compacting) {
+      fprintf(stderr, "compacting major collection\n");
+    } else if (c->mode == Heap::MajorCollection) {
       fprintf(stderr, "major collection\n");
     } else {
       fprintf(stderr, "minor collection\n");
     }
-
-    then = c->system->now();
   }
 
+  int64_t then = c->system->now();
+  int64_t start = c->system->nowMicroseconds();
+
   initNextGen1(c);
 
-  if (c->mode == Heap::MajorCollection) {
-    initNextGen2(c);
-  }
+  if (c->compacting) {
+    unsigned oldPosition = c->gen2.position();
 
-  collect2(c);
+    collect2(c);
+    compact(c);
+    uncommitGen2Tail(c, oldPosition);
 
-  c->gen1.replaceWith(&(c->nextGen1));
-  if (c->mode == Heap::MajorCollection) {
-    c->gen2.replaceWith(&(c->nextGen2));
+    c->gen1.replaceWith(&(c->nextGen1));
+  } else {
+    if (c->mode == Heap::MajorCollection) {
+      initNextGen2(c);
+    }
+
+    collect2(c);
+
+    c->gen1.replaceWith(&(c->nextGen1));
+    if (c->mode == Heap::MajorCollection) {
+      c->gen2.replaceWith(&(c->nextGen2));
+    }
   }
 
   sweepFixies(c);
 
+  int64_t pause = c->system->nowMicroseconds() - start;
+  int64_t now = c->system->now();
+
+  if (not gen2HasExcess(c)) {
+    c->oversizedSince = 0;
+  } else if (c->oversizedSince == 0) {
+    c->oversizedSince = now;
+  }
+
+  recordPause(c, pause);
+
+  if (c->logFile) {
+    logCollection(c,
+                  cause,
+                  compacted,
+                  then,
+                  pause,
+                  gen1Before,
+                  gen2Before,
+                  fixiesBefore);
+  }
+
   if (Verbose) {
-    int64_t now = c->system->now();
     int64_t collection = now - then;
     int64_t run = then - c->lastCollectionTime;
     c->totalCollectionTime += collection;
@@ -1860,6 +3631,10 @@ void collect(Context* c)
     fprintf(stderr,
             " -   tenured fixies:          %8d bytes\n",
             c->tenuredFixieFootprint);
+
+    if (c->workerCount > 1) {
+      printWorkerStatistics(c);
+    }
   }
 }
 
@@ -1921,6 +3696,10 @@ void free(Context* c, const void* p, size_t size)
 
   expect(c->system, c->count >= size);
 
+  if (size >= MinUncommitSizeInBytes) {
+    uncommit(c, const_cast<void*>(p), size);
+  }
+
   c->system->free(p);
   c->count -= size;
 }
@@ -1932,8 +3711,15 @@ void free_(Context* c, const void* p, size_t size)
 
 class MyHeap : public Heap {
  public:
-  MyHeap(System* system, unsigned limit) : c(system, limit)
+  MyHeap(System* system,
+         unsigned limit,
+         unsigned collectorThreads,
+         bool compact)
+      : c(system, limit, collectorThreads, compact)
   {
+    if (c.workerCount > 1) {
+      initWorkers(&c);
+    }
   }
 
   virtual void setClient(Heap::Client* client)
@@ -2003,12 +3789,26 @@ class MyHeap : public Heap {
     expect(&c, not limitExceeded());
 
     unsigned total = Fixie::totalSize(sizeInWords, objectMask);
-    void* p = allocator->allocate(total);
+
+    // only fixies allocated from the heap itself are freed by it, so
+    // those are the only ones we can put in arenas:
+    bool inArena = allocator == this and (not immortal)
+                   and fitsInArena(total);
+
+    void* p = inArena ? allocateFixie(&c, total) : allocator->allocate(total);
 
     expect(&c, not limitExceeded());
 
-    return (new (p) Fixie(&c, sizeInWords, objectMask, handle, immortal))
-        ->body();
+    Fixie* f = new (p) Fixie(&c, sizeInWords, objectMask, handle, immortal);
+    f->inArena(inArena);
+
+    if (not immortal) {
+      // sweepFixies will recalculate this, but we update it here so
+      // it reflects new fixies when we log the next collection:
+      c.untenuredFixieFootprint += total;
+    }
+
+    return f->body();
   }
 
   virtual void* allocateFixed(Alloc* allocator,
@@ -2107,22 +3907,31 @@ class MyHeap : public Heap {
 
   virtual void pad(void* p)
   {
+    unsigned* padding;
     if (c.gen1.contains(p)) {
       if (c.ageMap.get(p) == TenureThreshold) {
-        ++c.tenurePadding;
+        padding = &(c.tenurePadding);
       } else {
-        ++c.gen1Padding;
+        padding = &(c.gen1Padding);
       }
     } else if (c.gen2.contains(p)) {
-      ++c.gen2Padding;
+      padding = &(c.gen2Padding);
     } else {
-      ++c.gen1Padding;
+      padding = &(c.gen1Padding);
     }
+
+#ifdef USE_ATOMIC_OPERATIONS
+    atomicAdd(padding, 1);
+#else
+    ACQUIRE(c.lock);
+    ++*padding;
+#endif
   }
 
   virtual void* follow(void* p)
   {
-    if (p == 0 or c.client->isFixed(p)) {
+    if (p == 0 or c.client->isFixed(p)
+        or (c.compacting and c.gen2.contains(p))) {
       return p;
     } else if (wasCollected(&c, p)) {
       if (Debug) {
@@ -2142,6 +3951,14 @@ class MyHeap : public Heap {
 
   virtual void postVisit()
   {
+    if (c.parallel) {
+      // the client is about to ask about the status of objects, so
+      // we must finish tracing everything reachable from the roots
+      // it's given us so far:
+      drain(&c, true);
+      c.postVisiting = true;
+    }
+
     killFixies(&c);
   }
 
@@ -2157,6 +3974,9 @@ class MyHeap : public Heap {
                                             < FixieTenureThreshold
                                             ? Reachable
                                             : Tenured);
+    } else if (c.compacting and c.gen2.contains(p)
+               and c.gen2.indexOf(p) < c.compactBase) {
+      return c.pointerMap.get(p) ? Tenured : Unreachable;
     } else if (c.nextGen1.contains(p)) {
       return Reachable;
     } else if (c.nextGen2.contains(p) or immortalHeapContains(&c, p)
@@ -2176,6 +3996,35 @@ class MyHeap : public Heap {
     return c.mode;
   }
 
+  virtual void setLog(const char* path)
+  {
+    if (c.logFile) {
+      fclose(c.logFile);
+    }
+
+    c.logFile = vm::fopen(path, "a");
+
+    if (c.logFile == 0) {
+      fprintf(stderr, "unable to open GC log %s\n", path);
+    }
+  }
+
+  virtual void setUncommitPolicy(unsigned delay, unsigned minFreeRatio)
+  {
+    c.uncommitDelay = delay;
+    c.minFreeRatio = min(minFreeRatio, 99u);
+  }
+
+  virtual unsigned collectionCount()
+  {
+    return c.collectionCount;
+  }
+
+  virtual int64_t pauseTime(unsigned percentile)
+  {
+    return local::pauseTime(&c, percentile);
+  }
+
   virtual void disposeFixies()
   {
     c.disposeFixies();
@@ -2183,6 +4032,7 @@ class MyHeap : public Heap {
 
   virtual void dispose()
   {
+    disposeWorkers(&c);
     c.dispose();
     assertT(&c, c.count == 0);
     c.system->free(this);
@@ -2197,10 +4047,20 @@ class MyHeap : public Heap {
 
 namespace vm {
 
-Heap* makeHeap(System* system, unsigned limit)
+Heap* makeHeap(System* system,
+               unsigned limit,
+               unsigned collectorThreads,
+               bool compact)
 {
+#ifdef USE_ATOMIC_OPERATIONS
+  collectorThreads
+      = min(max(collectorThreads, 1u), local::MaxCollectorThreads);
+#else
+  collectorThreads = 1;
+#endif
+
   return new (system->tryAllocate(sizeof(local::MyHeap)))
-      local::MyHeap(system, limit);
+      local::MyHeap(system, limit, collectorThreads, compact);
 }
 
 }  // namespace vm
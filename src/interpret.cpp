@@ -32,6 +32,8 @@ const unsigned FrameMethodOffset = 2;
 const unsigned FrameIpOffset = 3;
 const unsigned FrameFootprint = 4;
 
+const bool QuickenInstructions = true;
+
 class Thread : public vm::Thread {
  public:
   Thread(Machine* m, GcThread* javaThread, vm::Thread* parent)
@@ -763,8 +765,238 @@ void safePoint(Thread* t)
   }
 }
 
+// Once getfield, putfield, getstatic or invokevirtual has resolved its
+// operand, we rewrite it in place to a "quick" form which needs only
+// the field offset or vtable index, and skips resolution, volatile
+// handling and class initialization checks.  The operand bytes still
+// name the constant pool entry, so a thread which reads the old
+// opcode executes the instruction correctly, and the offset or index
+// lives in a table with an entry for each pool entry, shared by every
+// method of the class (see quickOperand).
+GcIntArray* quickOperands(Thread* t, GcMethod* method)
+{
+  GcCode* code = method->code();
+  GcIntArray* table = code->quickOperands();
+  if (table == 0) {
+    PROTECT(t, code);
+
+    GcClassRuntimeData* runtimeData = getClassRuntimeData(t, method->class_());
+    PROTECT(t, runtimeData);
+
+    ACQUIRE(t, t->m->classLock);
+
+    table = runtimeData->quickOperands();
+    if (table == 0) {
+      table = makeIntArray(t, code->pool()->length());
+      runtimeData->setQuickOperands(t, table);
+    }
+
+    code->setQuickOperands(t, table);
+  }
+  return table;
+}
+
+// rewrites the instruction at the specified ip, whose operand is a
+// constant pool index, to the specified quick form, which will find
+// the specified non-zero value in the quick operand table
+void quicken(Thread* t,
+             GcMethod* method,
+             unsigned ip,
+             unsigned instruction,
+             uint32_t operand)
+{
+  assertT(t, operand);
+
+  PROTECT(t, method);
+
+  GcIntArray* table = quickOperands(t, method);
+
+  GcCode* code = method->code();
+  uint16_t index = (code->body()[ip + 1] << 8) | code->body()[ip + 2];
+
+  table->body()[index - 1] = operand;
+
+  // make sure the operand is visible before the new opcode (see
+  // quickOperand):
+  storeStoreMemoryBarrier();
+  code->body()[ip] = instruction;
+}
+
+uint32_t quickOperandAfterBarrier(GcCode* code, uint16_t index)
+{
+  loadMemoryBarrier();
+  return code->quickOperands()->body()[index - 1];
+}
+
+// Returns the operand of a quick instruction.  Zero is never a valid
+// operand, so if the table or entry reads as zero, we must have seen
+// the new opcode before what quicken stored ahead of it, which only
+// processors that reorder loads allow, and we try again after a
+// barrier.  Thus we only pay for the barrier in that rare case.
+inline uint32_t quickOperand(Thread* t, GcCode* code, unsigned& ip)
+{
+  uint16_t index = codeReadInt16(t, code, ip);
+  GcIntArray* table = code->quickOperands();
+  if (LIKELY(table)) {
+    uint32_t operand = table->body()[index - 1];
+    if (LIKELY(operand)) {
+      return operand;
+    }
+  }
+  return quickOperandAfterBarrier(code, index);
+}
+
+// returns the quick form of the specified getfield, putfield or
+// getstatic instruction for the specified field, or zero if it has
+// none
+unsigned quickFieldInstruction(GcField* field, unsigned instruction)
+{
+  if (not QuickenInstructions or (field->flags() & ACC_VOLATILE)) {
+    return 0;
+  }
+
+  switch (field->code()) {
+  case FloatField:
+  case IntField:
+    switch (instruction) {
+    case getfield:
+      return getfield_quick_int;
+    case putfield:
+      return putfield_quick_int;
+    default:
+      return getstatic_quick_int;
+    }
+
+  case DoubleField:
+  case LongField:
+    switch (instruction) {
+    case getfield:
+      return getfield_quick_long;
+    case putfield:
+      return putfield_quick_long;
+    default:
+      return getstatic_quick_long;
+    }
+
+  case ObjectField:
+    switch (instruction) {
+    case getfield:
+      return getfield_quick_object;
+    case putfield:
+      return putfield_quick_object;
+    default:
+      return getstatic_quick_object;
+    }
+
+  default:
+    return 0;
+  }
+}
+
+// Where the compiler supports taking the address of a label (GCC and
+// Clang do), each instruction handler ends by fetching the next
+// instruction and jumping straight to its handler through a table,
+// rather than returning to a central switch.  That gives the branch
+// predictor a separate indirect jump to learn from for each handler.
+// Elsewhere, or if AVIAN_SWITCH_DISPATCH is defined, we fall back to
+// the switch.
+#if (defined __GNUC__) && (!defined AVIAN_SWITCH_DISPATCH)
+#define THREADED_DISPATCH
+#endif
+
+#ifdef THREADED_DISPATCH
+#define CASE(x) \
+  case vm::x:   \
+  op_##x
+#define DEFAULT \
+  default:      \
+  op_default
+#define NEXT                          \
+  if (DebugRun) {                     \
+    goto loop;                        \
+  } else {                            \
+    instruction = code->body()[ip++]; \
+    goto* dispatchTable[instruction]; \
+  }
+#else
+#define CASE(x) case vm::x
+#define DEFAULT default
+#define NEXT goto loop
+#endif
+
 object interpret3(Thread* t, const int base)
 {
+#ifdef THREADED_DISPATCH
+  static void* const dispatchTable[256] = {
+      &&op_nop, &&op_aconst_null, &&op_iconst_m1, &&op_iconst_0,
+      &&op_iconst_1, &&op_iconst_2, &&op_iconst_3, &&op_iconst_4,
+      &&op_iconst_5, &&op_lconst_0, &&op_lconst_1, &&op_fconst_0,
+      &&op_fconst_1, &&op_fconst_2, &&op_dconst_0, &&op_dconst_1,
+      &&op_bipush, &&op_sipush, &&op_ldc, &&op_ldc_w,
+      &&op_ldc2_w, &&op_iload, &&op_lload, &&op_fload,
+      &&op_dload, &&op_aload, &&op_iload_0, &&op_iload_1,
+      &&op_iload_2, &&op_iload_3, &&op_lload_0, &&op_lload_1,
+      &&op_lload_2, &&op_lload_3, &&op_fload_0, &&op_fload_1,
+      &&op_fload_2, &&op_fload_3, &&op_dload_0, &&op_dload_1,
+      &&op_dload_2, &&op_dload_3, &&op_aload_0, &&op_aload_1,
+      &&op_aload_2, &&op_aload_3, &&op_iaload, &&op_laload,
+      &&op_faload, &&op_daload, &&op_aaload, &&op_baload,
+      &&op_caload, &&op_saload, &&op_istore, &&op_lstore,
+      &&op_fstore, &&op_dstore, &&op_astore, &&op_istore_0,
+      &&op_istore_1, &&op_istore_2, &&op_istore_3, &&op_lstore_0,
+      &&op_lstore_1, &&op_lstore_2, &&op_lstore_3, &&op_fstore_0,
+      &&op_fstore_1, &&op_fstore_2, &&op_fstore_3, &&op_dstore_0,
+      &&op_dstore_1, &&op_dstore_2, &&op_dstore_3, &&op_astore_0,
+      &&op_astore_1, &&op_astore_2, &&op_astore_3, &&op_iastore,
+      &&op_lastore, &&op_fastore, &&op_dastore, &&op_aastore,
+      &&op_bastore, &&op_castore, &&op_sastore, &&op_pop_,
+      &&op_pop2, &&op_dup, &&op_dup_x1, &&op_dup_x2,
+      &&op_dup2, &&op_dup2_x1, &&op_dup2_x2, &&op_swap,
+      &&op_iadd, &&op_ladd, &&op_fadd, &&op_dadd,
+      &&op_isub, &&op_lsub, &&op_fsub, &&op_dsub,
+      &&op_imul, &&op_lmul, &&op_fmul, &&op_dmul,
+      &&op_idiv, &&op_ldiv_, &&op_fdiv, &&op_ddiv,
+      &&op_irem, &&op_lrem, &&op_frem, &&op_drem,
+      &&op_ineg, &&op_lneg, &&op_fneg, &&op_dneg,
+      &&op_ishl, &&op_lshl, &&op_ishr, &&op_lshr,
+      &&op_iushr, &&op_lushr, &&op_iand, &&op_land,
+      &&op_ior, &&op_lor, &&op_ixor, &&op_lxor,
+      &&op_iinc, &&op_i2l, &&op_i2f, &&op_i2d,
+      &&op_l2i, &&op_l2f, &&op_l2d, &&op_f2i,
+      &&op_f2l, &&op_f2d, &&op_d2i, &&op_d2l,
+      &&op_d2f, &&op_i2b, &&op_i2c, &&op_i2s,
+      &&op_lcmp, &&op_fcmpl, &&op_fcmpg, &&op_dcmpl,
+      &&op_dcmpg, &&op_ifeq, &&op_ifne, &&op_iflt,
+      &&op_ifge, &&op_ifgt, &&op_ifle, &&op_if_icmpeq,
+      &&op_if_icmpne, &&op_if_icmplt, &&op_if_icmpge, &&op_if_icmpgt,
+      &&op_if_icmple, &&op_if_acmpeq, &&op_if_acmpne, &&op_goto_,
+      &&op_jsr, &&op_ret, &&op_tableswitch, &&op_lookupswitch,
+      &&op_ireturn, &&op_lreturn, &&op_freturn, &&op_dreturn,
+      &&op_areturn, &&op_return_, &&op_getstatic, &&op_putstatic,
+      &&op_getfield, &&op_putfield, &&op_invokevirtual, &&op_invokespecial,
+      &&op_invokestatic, &&op_invokeinterface, &&op_invokedynamic, &&op_new_,
+      &&op_newarray, &&op_anewarray, &&op_arraylength, &&op_athrow,
+      &&op_checkcast, &&op_instanceof, &&op_monitorenter, &&op_monitorexit,
+      &&op_wide, &&op_multianewarray, &&op_ifnull, &&op_ifnonnull,
+      &&op_goto_w, &&op_jsr_w, &&op_default, &&op_getfield_quick_int,
+      &&op_getfield_quick_long, &&op_getfield_quick_object,
+      &&op_putfield_quick_int, &&op_putfield_quick_long,
+      &&op_putfield_quick_object, &&op_getstatic_quick_int,
+      &&op_getstatic_quick_long, &&op_getstatic_quick_object,
+      &&op_invokevirtual_quick, &&op_default, &&op_default, &&op_default,
+      &&op_default, &&op_default, &&op_default, &&op_default,
+      &&op_default, &&op_default, &&op_default, &&op_default,
+      &&op_default, &&op_default, &&op_default, &&op_default,
+      &&op_default, &&op_default, &&op_default, &&op_default,
+      &&op_default, &&op_default, &&op_default, &&op_default,
+      &&op_default, &&op_default, &&op_default, &&op_default,
+      &&op_default, &&op_default, &&op_default, &&op_default,
+      &&op_default, &&op_default, &&op_default, &&op_default,
+      &&op_default, &&op_default, &&op_default, &&op_default,
+      &&op_default, &&op_default, &&op_impdep1, &&op_default
+  };
+#endif
+
   unsigned instruction = nop;
   unsigned& ip = t->ip;
   unsigned& sp = t->sp;
@@ -805,8 +1037,12 @@ loop:
     }
   }
 
+#ifdef THREADED_DISPATCH
+  goto* dispatchTable[instruction];
+#endif
+
   switch (instruction) {
-  case aaload: {
+  CASE(aaload): {
     int32_t index = popInt(t);
     object array = popObject(t);
 
@@ -828,9 +1064,9 @@ loop:
       goto throw_;
     }
   }
-    goto loop;
+    NEXT;
 
-  case aastore: {
+  CASE(aastore): {
     object value = popObject(t);
     int32_t index = popInt(t);
     object array = popObject(t);
@@ -853,39 +1089,39 @@ loop:
       goto throw_;
     }
   }
-    goto loop;
+    NEXT;
 
-  case aconst_null: {
+  CASE(aconst_null): {
     pushObject(t, 0);
   }
-    goto loop;
+    NEXT;
 
-  case aload: {
+  CASE(aload): {
     pushObject(t, localObject(t, code->body()[ip++]));
   }
-    goto loop;
+    NEXT;
 
-  case aload_0: {
+  CASE(aload_0): {
     pushObject(t, localObject(t, 0));
   }
-    goto loop;
+    NEXT;
 
-  case aload_1: {
+  CASE(aload_1): {
     pushObject(t, localObject(t, 1));
   }
-    goto loop;
+    NEXT;
 
-  case aload_2: {
+  CASE(aload_2): {
     pushObject(t, localObject(t, 2));
   }
-    goto loop;
+    NEXT;
 
-  case aload_3: {
+  CASE(aload_3): {
     pushObject(t, localObject(t, 3));
   }
-    goto loop;
+    NEXT;
 
-  case anewarray: {
+  CASE(anewarray): {
     int32_t count = popInt(t);
 
     if (LIKELY(count >= 0)) {
@@ -900,21 +1136,21 @@ loop:
       goto throw_;
     }
   }
-    goto loop;
+    NEXT;
 
-  case areturn: {
+  CASE(areturn): {
     object result = popObject(t);
     if (frame > base) {
       popFrame(t);
       pushObject(t, result);
-      goto loop;
+      NEXT;
     } else {
       return result;
     }
   }
-    goto loop;
+    NEXT;
 
-  case arraylength: {
+  CASE(arraylength): {
     object array = popObject(t);
     if (LIKELY(array)) {
       pushInt(t, fieldAtOffset<uintptr_t>(array, BytesPerWord));
@@ -923,34 +1159,34 @@ loop:
       goto throw_;
     }
   }
-    goto loop;
+    NEXT;
 
-  case astore: {
+  CASE(astore): {
     store(t, code->body()[ip++]);
   }
-    goto loop;
+    NEXT;
 
-  case astore_0: {
+  CASE(astore_0): {
     store(t, 0);
   }
-    goto loop;
+    NEXT;
 
-  case astore_1: {
+  CASE(astore_1): {
     store(t, 1);
   }
-    goto loop;
+    NEXT;
 
-  case astore_2: {
+  CASE(astore_2): {
     store(t, 2);
   }
-    goto loop;
+    NEXT;
 
-  case astore_3: {
+  CASE(astore_3): {
     store(t, 3);
   }
-    goto loop;
+    NEXT;
 
-  case athrow: {
+  CASE(athrow): {
     exception = cast<GcThrowable>(t, popObject(t));
     if (UNLIKELY(exception == 0)) {
       exception = makeThrowable(t, GcNullPointerException::Type);
@@ -958,7 +1194,7 @@ loop:
   }
     goto throw_;
 
-  case baload: {
+  CASE(baload): {
     int32_t index = popInt(t);
     object array = popObject(t);
 
@@ -995,9 +1231,9 @@ loop:
       goto throw_;
     }
   }
-    goto loop;
+    NEXT;
 
-  case bastore: {
+  CASE(bastore): {
     int8_t value = popInt(t);
     int32_t index = popInt(t);
     object array = popObject(t);
@@ -1035,14 +1271,14 @@ loop:
       goto throw_;
     }
   }
-    goto loop;
+    NEXT;
 
-  case bipush: {
+  CASE(bipush): {
     pushInt(t, static_cast<int8_t>(code->body()[ip++]));
   }
-    goto loop;
+    NEXT;
 
-  case caload: {
+  CASE(caload): {
     int32_t index = popInt(t);
     object array = popObject(t);
 
@@ -1063,9 +1299,9 @@ loop:
       goto throw_;
     }
   }
-    goto loop;
+    NEXT;
 
-  case castore: {
+  CASE(castore): {
     uint16_t value = popInt(t);
     int32_t index = popInt(t);
     object array = popObject(t);
@@ -1087,9 +1323,9 @@ loop:
       goto throw_;
     }
   }
-    goto loop;
+    NEXT;
 
-  case checkcast: {
+  CASE(checkcast): {
     uint16_t index = codeReadInt16(t, code, ip);
 
     if (peekObject(t, sp - 1)) {
@@ -1108,14 +1344,14 @@ loop:
       }
     }
   }
-    goto loop;
+    NEXT;
 
-  case d2f: {
+  CASE(d2f): {
     pushFloat(t, static_cast<float>(popDouble(t)));
   }
-    goto loop;
+    NEXT;
 
-  case d2i: {
+  CASE(d2i): {
     double f = popDouble(t);
     switch (fpclassify(f)) {
     case FP_NAN:
@@ -1132,9 +1368,9 @@ loop:
       break;
     }
   }
-    goto loop;
+    NEXT;
 
-  case d2l: {
+  CASE(d2l): {
     double f = popDouble(t);
     switch (fpclassify(f)) {
     case FP_NAN:
@@ -1151,17 +1387,17 @@ loop:
       break;
     }
   }
-    goto loop;
+    NEXT;
 
-  case dadd: {
+  CASE(dadd): {
     double b = popDouble(t);
     double a = popDouble(t);
 
     pushDouble(t, a + b);
   }
-    goto loop;
+    NEXT;
 
-  case daload: {
+  CASE(daload): {
     int32_t index = popInt(t);
     object array = popObject(t);
 
@@ -1182,9 +1418,9 @@ loop:
       goto throw_;
     }
   }
-    goto loop;
+    NEXT;
 
-  case dastore: {
+  CASE(dastore): {
     double value = popDouble(t);
     int32_t index = popInt(t);
     object array = popObject(t);
@@ -1206,9 +1442,9 @@ loop:
       goto throw_;
     }
   }
-    goto loop;
+    NEXT;
 
-  case dcmpg: {
+  CASE(dcmpg): {
     double b = popDouble(t);
     double a = popDouble(t);
 
@@ -1225,9 +1461,9 @@ loop:
       pushInt(t, 1);
     }
   }
-    goto loop;
+    NEXT;
 
-  case dcmpl: {
+  CASE(dcmpl): {
     double b = popDouble(t);
     double a = popDouble(t);
 
@@ -1244,58 +1480,58 @@ loop:
       pushInt(t, static_cast<unsigned>(-1));
     }
   }
-    goto loop;
+    NEXT;
 
-  case dconst_0: {
+  CASE(dconst_0): {
     pushDouble(t, 0);
   }
-    goto loop;
+    NEXT;
 
-  case dconst_1: {
+  CASE(dconst_1): {
     pushDouble(t, 1);
   }
-    goto loop;
+    NEXT;
 
-  case ddiv: {
+  CASE(ddiv): {
     double b = popDouble(t);
     double a = popDouble(t);
 
     pushDouble(t, a / b);
   }
-    goto loop;
+    NEXT;
 
-  case dmul: {
+  CASE(dmul): {
     double b = popDouble(t);
     double a = popDouble(t);
 
     pushDouble(t, a * b);
   }
-    goto loop;
+    NEXT;
 
-  case dneg: {
+  CASE(dneg): {
     double a = popDouble(t);
 
     pushDouble(t, -a);
   }
-    goto loop;
+    NEXT;
 
-  case vm::drem: {
+  CASE(drem): {
     double b = popDouble(t);
     double a = popDouble(t);
 
     pushDouble(t, fmod(a, b));
   }
-    goto loop;
+    NEXT;
 
-  case dsub: {
+  CASE(dsub): {
     double b = popDouble(t);
     double a = popDouble(t);
 
     pushDouble(t, a - b);
   }
-    goto loop;
+    NEXT;
 
-  case vm::dup: {
+  CASE(dup): {
     if (DebugStack) {
       fprintf(stderr, "dup\n");
     }
@@ -1303,9 +1539,9 @@ loop:
     memcpy(stack + ((sp)*2), stack + ((sp - 1) * 2), BytesPerWord * 2);
     ++sp;
   }
-    goto loop;
+    NEXT;
 
-  case dup_x1: {
+  CASE(dup_x1): {
     if (DebugStack) {
       fprintf(stderr, "dup_x1\n");
     }
@@ -1315,9 +1551,9 @@ loop:
     memcpy(stack + ((sp - 2) * 2), stack + ((sp)*2), BytesPerWord * 2);
     ++sp;
   }
-    goto loop;
+    NEXT;
 
-  case dup_x2: {
+  CASE(dup_x2): {
     if (DebugStack) {
       fprintf(stderr, "dup_x2\n");
     }
@@ -1328,9 +1564,9 @@ loop:
     memcpy(stack + ((sp - 3) * 2), stack + ((sp)*2), BytesPerWord * 2);
     ++sp;
   }
-    goto loop;
+    NEXT;
 
-  case vm::dup2: {
+  CASE(dup2): {
     if (DebugStack) {
       fprintf(stderr, "dup2\n");
     }
@@ -1338,9 +1574,9 @@ loop:
     memcpy(stack + ((sp)*2), stack + ((sp - 2) * 2), BytesPerWord * 4);
     sp += 2;
   }
-    goto loop;
+    NEXT;
 
-  case dup2_x1: {
+  CASE(dup2_x1): {
     if (DebugStack) {
       fprintf(stderr, "dup2_x1\n");
     }
@@ -1351,9 +1587,9 @@ loop:
     memcpy(stack + ((sp - 3) * 2), stack + ((sp)*2), BytesPerWord * 4);
     sp += 2;
   }
-    goto loop;
+    NEXT;
 
-  case dup2_x2: {
+  CASE(dup2_x2): {
     if (DebugStack) {
       fprintf(stderr, "dup2_x2\n");
     }
@@ -1365,14 +1601,14 @@ loop:
     memcpy(stack + ((sp - 4) * 2), stack + ((sp)*2), BytesPerWord * 4);
     sp += 2;
   }
-    goto loop;
+    NEXT;
 
-  case f2d: {
+  CASE(f2d): {
     pushDouble(t, popFloat(t));
   }
-    goto loop;
+    NEXT;
 
-  case f2i: {
+  CASE(f2i): {
     float f = popFloat(t);
     switch (fpclassify(f)) {
     case FP_NAN:
@@ -1389,9 +1625,9 @@ loop:
       break;
     }
   }
-    goto loop;
+    NEXT;
 
-  case f2l: {
+  CASE(f2l): {
     float f = popFloat(t);
     switch (fpclassify(f)) {
     case FP_NAN:
@@ -1405,17 +1641,17 @@ loop:
       break;
     }
   }
-    goto loop;
+    NEXT;
 
-  case fadd: {
+  CASE(fadd): {
     float b = popFloat(t);
     float a = popFloat(t);
 
     pushFloat(t, a + b);
   }
-    goto loop;
+    NEXT;
 
-  case faload: {
+  CASE(faload): {
     int32_t index = popInt(t);
     object array = popObject(t);
 
@@ -1436,9 +1672,9 @@ loop:
       goto throw_;
     }
   }
-    goto loop;
+    NEXT;
 
-  case fastore: {
+  CASE(fastore): {
     float value = popFloat(t);
     int32_t index = popInt(t);
     object array = popObject(t);
@@ -1460,9 +1696,9 @@ loop:
       goto throw_;
     }
   }
-    goto loop;
+    NEXT;
 
-  case fcmpg: {
+  CASE(fcmpg): {
     float b = popFloat(t);
     float a = popFloat(t);
 
@@ -1479,9 +1715,9 @@ loop:
       pushInt(t, 1);
     }
   }
-    goto loop;
+    NEXT;
 
-  case fcmpl: {
+  CASE(fcmpl): {
     float b = popFloat(t);
     float a = popFloat(t);
 
@@ -1498,63 +1734,63 @@ loop:
       pushInt(t, static_cast<unsigned>(-1));
     }
   }
-    goto loop;
+    NEXT;
 
-  case fconst_0: {
+  CASE(fconst_0): {
     pushFloat(t, 0);
   }
-    goto loop;
+    NEXT;
 
-  case fconst_1: {
+  CASE(fconst_1): {
     pushFloat(t, 1);
   }
-    goto loop;
+    NEXT;
 
-  case fconst_2: {
+  CASE(fconst_2): {
     pushFloat(t, 2);
   }
-    goto loop;
+    NEXT;
 
-  case fdiv: {
+  CASE(fdiv): {
     float b = popFloat(t);
     float a = popFloat(t);
 
     pushFloat(t, a / b);
   }
-    goto loop;
+    NEXT;
 
-  case fmul: {
+  CASE(fmul): {
     float b = popFloat(t);
     float a = popFloat(t);
 
     pushFloat(t, a * b);
   }
-    goto loop;
+    NEXT;
 
-  case fneg: {
+  CASE(fneg): {
     float a = popFloat(t);
 
     pushFloat(t, -a);
   }
-    goto loop;
+    NEXT;
 
-  case frem: {
+  CASE(frem): {
     float b = popFloat(t);
     float a = popFloat(t);
 
     pushFloat(t, fmodf(a, b));
   }
-    goto loop;
+    NEXT;
 
-  case fsub: {
+  CASE(fsub): {
     float b = popFloat(t);
     float a = popFloat(t);
 
     pushFloat(t, a - b);
   }
-    goto loop;
+    NEXT;
 
-  case getfield: {
+  CASE(getfield): {
     if (LIKELY(peekObject(t, sp - 1))) {
       uint16_t index = codeReadInt16(t, code, ip);
 
@@ -1562,6 +1798,12 @@ loop:
 
       assertT(t, (field->flags() & ACC_STATIC) == 0);
 
+      unsigned quick = quickFieldInstruction(field, getfield);
+      if (quick) {
+        PROTECT(t, field);
+        quicken(t, frameMethod(t, frame), ip - 3, quick, field->offset());
+      }
+
       PROTECT(t, field);
 
       ACQUIRE_FIELD_FOR_READ(t, field);
@@ -1572,9 +1814,9 @@ loop:
       goto throw_;
     }
   }
-    goto loop;
+    NEXT;
 
-  case getstatic: {
+  CASE(getstatic): {
     uint16_t index = codeReadInt16(t, code, ip);
 
     GcField* field = resolveField(t, frameMethod(t, frame), index - 1);
@@ -1585,63 +1827,142 @@ loop:
 
     initClass(t, field->class_());
 
+    // the quick form finds the static table through the class of the
+    // executing method, so only that class's own fields qualify:
+    unsigned quick = field->class_() == frameMethod(t, frame)->class_()
+                     and (field->class_()->vmFlags() & NeedInitFlag) == 0
+                         ? quickFieldInstruction(field, getstatic)
+                         : 0;
+    if (quick) {
+      quicken(t, frameMethod(t, frame), ip - 3, quick, field->offset());
+    }
+
     ACQUIRE_FIELD_FOR_READ(t, field);
 
     pushField(t, field->class_()->staticTable(), field);
   }
-    goto loop;
+    NEXT;
+
+  CASE(getstatic_quick_int): {
+    unsigned offset = quickOperand(t, code, ip);
+
+    pushInt(t,
+            fieldAtOffset<int32_t>(
+                frameMethod(t, frame)->class_()->staticTable(), offset));
+  }
+    NEXT;
+
+  CASE(getstatic_quick_long): {
+    unsigned offset = quickOperand(t, code, ip);
+
+    pushLong(t,
+             fieldAtOffset<int64_t>(
+                 frameMethod(t, frame)->class_()->staticTable(), offset));
+  }
+    NEXT;
+
+  CASE(getstatic_quick_object): {
+    unsigned offset = quickOperand(t, code, ip);
+
+    pushObject(t,
+               fieldAtOffset<object>(
+                   frameMethod(t, frame)->class_()->staticTable(), offset));
+  }
+    NEXT;
+
+  CASE(getfield_quick_int): {
+    object o = peekObject(t, sp - 1);
+    if (LIKELY(o)) {
+      unsigned offset = quickOperand(t, code, ip);
+
+      popObject(t);
+      pushInt(t, fieldAtOffset<int32_t>(o, offset));
+    } else {
+      exception = makeThrowable(t, GcNullPointerException::Type);
+      goto throw_;
+    }
+  }
+    NEXT;
+
+  CASE(getfield_quick_long): {
+    object o = peekObject(t, sp - 1);
+    if (LIKELY(o)) {
+      unsigned offset = quickOperand(t, code, ip);
 
-  case goto_: {
+      popObject(t);
+      pushLong(t, fieldAtOffset<int64_t>(o, offset));
+    } else {
+      exception = makeThrowable(t, GcNullPointerException::Type);
+      goto throw_;
+    }
+  }
+    NEXT;
+
+  CASE(getfield_quick_object): {
+    object o = peekObject(t, sp - 1);
+    if (LIKELY(o)) {
+      unsigned offset = quickOperand(t, code, ip);
+
+      popObject(t);
+      pushObject(t, fieldAtOffset<object>(o, offset));
+    } else {
+      exception = makeThrowable(t, GcNullPointerException::Type);
+      goto throw_;
+    }
+  }
+    NEXT;
+
+  CASE(goto_): {
     int16_t offset = codeReadInt16(t, code, ip);
     ip = (ip - 3) + offset;
   }
     goto back_branch;
 
-  case goto_w: {
+  CASE(goto_w): {
     int32_t offset = codeReadInt32(t, code, ip);
     ip = (ip - 5) + offset;
   }
     goto back_branch;
 
-  case i2b: {
+  CASE(i2b): {
     pushInt(t, static_cast<int8_t>(popInt(t)));
   }
-    goto loop;
+    NEXT;
 
-  case i2c: {
+  CASE(i2c): {
     pushInt(t, static_cast<uint16_t>(popInt(t)));
   }
-    goto loop;
+    NEXT;
 
-  case i2d: {
+  CASE(i2d): {
     pushDouble(t, static_cast<double>(static_cast<int32_t>(popInt(t))));
   }
-    goto loop;
+    NEXT;
 
-  case i2f: {
+  CASE(i2f): {
     pushFloat(t, static_cast<float>(static_cast<int32_t>(popInt(t))));
   }
-    goto loop;
+    NEXT;
 
-  case i2l: {
+  CASE(i2l): {
     pushLong(t, static_cast<int32_t>(popInt(t)));
   }
-    goto loop;
+    NEXT;
 
-  case i2s: {
+  CASE(i2s): {
     pushInt(t, static_cast<int16_t>(popInt(t)));
   }
-    goto loop;
+    NEXT;
 
-  case iadd: {
+  CASE(iadd): {
     int32_t b = popInt(t);
     int32_t a = popInt(t);
 
     pushInt(t, a + b);
   }
-    goto loop;
+    NEXT;
 
-  case iaload: {
+  CASE(iaload): {
     int32_t index = popInt(t);
     object array = popObject(t);
 
@@ -1662,17 +1983,17 @@ loop:
       goto throw_;
     }
   }
-    goto loop;
+    NEXT;
 
-  case iand: {
+  CASE(iand): {
     int32_t b = popInt(t);
     int32_t a = popInt(t);
 
     pushInt(t, a & b);
   }
-    goto loop;
+    NEXT;
 
-  case iastore: {
+  CASE(iastore): {
     int32_t value = popInt(t);
     int32_t index = popInt(t);
     object array = popObject(t);
@@ -1694,44 +2015,44 @@ loop:
       goto throw_;
     }
   }
-    goto loop;
+    NEXT;
 
-  case iconst_m1: {
+  CASE(iconst_m1): {
     pushInt(t, static_cast<unsigned>(-1));
   }
-    goto loop;
+    NEXT;
 
-  case iconst_0: {
+  CASE(iconst_0): {
     pushInt(t, 0);
   }
-    goto loop;
+    NEXT;
 
-  case iconst_1: {
+  CASE(iconst_1): {
     pushInt(t, 1);
   }
-    goto loop;
+    NEXT;
 
-  case iconst_2: {
+  CASE(iconst_2): {
     pushInt(t, 2);
   }
-    goto loop;
+    NEXT;
 
-  case iconst_3: {
+  CASE(iconst_3): {
     pushInt(t, 3);
   }
-    goto loop;
+    NEXT;
 
-  case iconst_4: {
+  CASE(iconst_4): {
     pushInt(t, 4);
   }
-    goto loop;
+    NEXT;
 
-  case iconst_5: {
+  CASE(iconst_5): {
     pushInt(t, 5);
   }
-    goto loop;
+    NEXT;
 
-  case idiv: {
+  CASE(idiv): {
     int32_t b = popInt(t);
     int32_t a = popInt(t);
 
@@ -1742,9 +2063,9 @@ loop:
 
     pushInt(t, a / b);
   }
-    goto loop;
+    NEXT;
 
-  case if_acmpeq: {
+  CASE(if_acmpeq): {
     int16_t offset = codeReadInt16(t, code, ip);
 
     object b = popObject(t);
@@ -1756,7 +2077,7 @@ loop:
   }
     goto back_branch;
 
-  case if_acmpne: {
+  CASE(if_acmpne): {
     int16_t offset = codeReadInt16(t, code, ip);
 
     object b = popObject(t);
@@ -1768,7 +2089,7 @@ loop:
   }
     goto back_branch;
 
-  case if_icmpeq: {
+  CASE(if_icmpeq): {
     int16_t offset = codeReadInt16(t, code, ip);
 
     int32_t b = popInt(t);
@@ -1780,7 +2101,7 @@ loop:
   }
     goto back_branch;
 
-  case if_icmpne: {
+  CASE(if_icmpne): {
     int16_t offset = codeReadInt16(t, code, ip);
 
     int32_t b = popInt(t);
@@ -1792,7 +2113,7 @@ loop:
   }
     goto back_branch;
 
-  case if_icmpgt: {
+  CASE(if_icmpgt): {
     int16_t offset = codeReadInt16(t, code, ip);
 
     int32_t b = popInt(t);
@@ -1804,7 +2125,7 @@ loop:
   }
     goto back_branch;
 
-  case if_icmpge: {
+  CASE(if_icmpge): {
     int16_t offset = codeReadInt16(t, code, ip);
 
     int32_t b = popInt(t);
@@ -1816,7 +2137,7 @@ loop:
   }
     goto back_branch;
 
-  case if_icmplt: {
+  CASE(if_icmplt): {
     int16_t offset = codeReadInt16(t, code, ip);
 
     int32_t b = popInt(t);
@@ -1828,7 +2149,7 @@ loop:
   }
     goto back_branch;
 
-  case if_icmple: {
+  CASE(if_icmple): {
     int16_t offset = codeReadInt16(t, code, ip);
 
     int32_t b = popInt(t);
@@ -1840,7 +2161,7 @@ loop:
   }
     goto back_branch;
 
-  case ifeq: {
+  CASE(ifeq): {
     int16_t offset = codeReadInt16(t, code, ip);
 
     if (popInt(t) == 0) {
@@ -1849,7 +2170,7 @@ loop:
   }
     goto back_branch;
 
-  case ifne: {
+  CASE(ifne): {
     int16_t offset = codeReadInt16(t, code, ip);
 
     if (popInt(t)) {
@@ -1858,7 +2179,7 @@ loop:
   }
     goto back_branch;
 
-  case ifgt: {
+  CASE(ifgt): {
     int16_t offset = codeReadInt16(t, code, ip);
 
     if (static_cast<int32_t>(popInt(t)) > 0) {
@@ -1867,7 +2188,7 @@ loop:
   }
     goto back_branch;
 
-  case ifge: {
+  CASE(ifge): {
     int16_t offset = codeReadInt16(t, code, ip);
 
     if (static_cast<int32_t>(popInt(t)) >= 0) {
@@ -1876,7 +2197,7 @@ loop:
   }
     goto back_branch;
 
-  case iflt: {
+  CASE(iflt): {
     int16_t offset = codeReadInt16(t, code, ip);
 
     if (static_cast<int32_t>(popInt(t)) < 0) {
@@ -1885,7 +2206,7 @@ loop:
   }
     goto back_branch;
 
-  case ifle: {
+  CASE(ifle): {
     int16_t offset = codeReadInt16(t, code, ip);
 
     if (static_cast<int32_t>(popInt(t)) <= 0) {
@@ -1894,7 +2215,7 @@ loop:
   }
     goto back_branch;
 
-  case ifnonnull: {
+  CASE(ifnonnull): {
     int16_t offset = codeReadInt16(t, code, ip);
 
     if (popObject(t)) {
@@ -1903,7 +2224,7 @@ loop:
   }
     goto back_branch;
 
-  case ifnull: {
+  CASE(ifnull): {
     int16_t offset = codeReadInt16(t, code, ip);
 
     if (popObject(t) == 0) {
@@ -1912,58 +2233,58 @@ loop:
   }
     goto back_branch;
 
-  case iinc: {
+  CASE(iinc): {
     uint8_t index = code->body()[ip++];
     int8_t c = code->body()[ip++];
 
     setLocalInt(t, index, localInt(t, index) + c);
   }
-    goto loop;
+    NEXT;
 
-  case iload:
-  case fload: {
+  CASE(iload):
+  CASE(fload): {
     pushInt(t, localInt(t, code->body()[ip++]));
   }
-    goto loop;
+    NEXT;
 
-  case iload_0:
-  case fload_0: {
+  CASE(iload_0):
+  CASE(fload_0): {
     pushInt(t, localInt(t, 0));
   }
-    goto loop;
+    NEXT;
 
-  case iload_1:
-  case fload_1: {
+  CASE(iload_1):
+  CASE(fload_1): {
     pushInt(t, localInt(t, 1));
   }
-    goto loop;
+    NEXT;
 
-  case iload_2:
-  case fload_2: {
+  CASE(iload_2):
+  CASE(fload_2): {
     pushInt(t, localInt(t, 2));
   }
-    goto loop;
+    NEXT;
 
-  case iload_3:
-  case fload_3: {
+  CASE(iload_3):
+  CASE(fload_3): {
     pushInt(t, localInt(t, 3));
   }
-    goto loop;
+    NEXT;
 
-  case imul: {
+  CASE(imul): {
     int32_t b = popInt(t);
     int32_t a = popInt(t);
 
     pushInt(t, a * b);
   }
-    goto loop;
+    NEXT;
 
-  case ineg: {
+  CASE(ineg): {
     pushInt(t, -popInt(t));
   }
-    goto loop;
+    NEXT;
 
-  case instanceof: {
+  CASE(instanceof): {
     uint16_t index = codeReadInt16(t, code, ip);
 
     if (peekObject(t, sp - 1)) {
@@ -1979,9 +2300,9 @@ loop:
       pushInt(t, 0);
     }
   }
-    goto loop;
+    NEXT;
 
-  case invokedynamic: {
+  CASE(invokedynamic): {
     uint16_t index = codeReadInt16(t, code, ip);
 
     ip += 2;
@@ -2009,7 +2330,7 @@ loop:
     method = site->target()->method();
   } goto invoke;
 
-  case invokeinterface: {
+  CASE(invokeinterface): {
     uint16_t index = codeReadInt16(t, code, ip);
 
     ip += 2;
@@ -2026,9 +2347,9 @@ loop:
       goto throw_;
     }
   }
-    goto loop;
+    NEXT;
 
-  case invokespecial: {
+  CASE(invokespecial): {
     uint16_t index = codeReadInt16(t, code, ip);
 
     GcMethod* m = resolveMethod(t, frameMethod(t, frame), index - 1);
@@ -2054,9 +2375,9 @@ loop:
       goto throw_;
     }
   }
-    goto loop;
+    NEXT;
 
-  case invokestatic: {
+  CASE(invokestatic): {
     uint16_t index = codeReadInt16(t, code, ip);
 
     GcMethod* m = resolveMethod(t, frameMethod(t, frame), index - 1);
@@ -2068,11 +2389,22 @@ loop:
   }
     goto invoke;
 
-  case invokevirtual: {
+  CASE(invokevirtual): {
     uint16_t index = codeReadInt16(t, code, ip);
 
     GcMethod* m = resolveMethod(t, frameMethod(t, frame), index - 1);
 
+    if (QuickenInstructions) {
+      // the footprint is at least one, for the receiver, and at most
+      // 255, so neither the operand nor its low byte can be zero:
+      PROTECT(t, m);
+      quicken(t,
+              frameMethod(t, frame),
+              ip - 3,
+              invokevirtual_quick,
+              (m->offset() << 8) | m->parameterFootprint());
+    }
+
     unsigned parameterFootprint = m->parameterFootprint();
     if (LIKELY(peekObject(t, sp - parameterFootprint))) {
       GcClass* class_ = objectClass(t, peekObject(t, sp - parameterFootprint));
@@ -2086,17 +2418,34 @@ loop:
       goto throw_;
     }
   }
-    goto loop;
+    NEXT;
+
+  CASE(invokevirtual_quick): {
+    uint32_t operand = quickOperand(t, code, ip);
+
+    object receiver = peekObject(t, sp - (operand & 0xFF));
+    if (LIKELY(receiver)) {
+      method = cast<GcMethod>(
+          t,
+          cast<GcArray>(t, objectClass(t, receiver)->virtualTable())
+              ->body()[operand >> 8]);
+      goto invoke;
+    } else {
+      exception = makeThrowable(t, GcNullPointerException::Type);
+      goto throw_;
+    }
+  }
+    NEXT;
 
-  case ior: {
+  CASE(ior): {
     int32_t b = popInt(t);
     int32_t a = popInt(t);
 
     pushInt(t, a | b);
   }
-    goto loop;
+    NEXT;
 
-  case irem: {
+  CASE(irem): {
     int32_t b = popInt(t);
     int32_t a = popInt(t);
 
@@ -2107,131 +2456,131 @@ loop:
 
     pushInt(t, a % b);
   }
-    goto loop;
+    NEXT;
 
-  case ireturn:
-  case freturn: {
+  CASE(ireturn):
+  CASE(freturn): {
     int32_t result = popInt(t);
     if (frame > base) {
       popFrame(t);
       pushInt(t, result);
-      goto loop;
+      NEXT;
     } else {
       return makeInt(t, result);
     }
   }
-    goto loop;
+    NEXT;
 
-  case ishl: {
+  CASE(ishl): {
     int32_t b = popInt(t);
     int32_t a = popInt(t);
 
     pushInt(t, a << (b & 0x1F));
   }
-    goto loop;
+    NEXT;
 
-  case ishr: {
+  CASE(ishr): {
     int32_t b = popInt(t);
     int32_t a = popInt(t);
 
     pushInt(t, a >> (b & 0x1F));
   }
-    goto loop;
+    NEXT;
 
-  case istore:
-  case fstore: {
+  CASE(istore):
+  CASE(fstore): {
     setLocalInt(t, code->body()[ip++], popInt(t));
   }
-    goto loop;
+    NEXT;
 
-  case istore_0:
-  case fstore_0: {
+  CASE(istore_0):
+  CASE(fstore_0): {
     setLocalInt(t, 0, popInt(t));
   }
-    goto loop;
+    NEXT;
 
-  case istore_1:
-  case fstore_1: {
+  CASE(istore_1):
+  CASE(fstore_1): {
     setLocalInt(t, 1, popInt(t));
   }
-    goto loop;
+    NEXT;
 
-  case istore_2:
-  case fstore_2: {
+  CASE(istore_2):
+  CASE(fstore_2): {
     setLocalInt(t, 2, popInt(t));
   }
-    goto loop;
+    NEXT;
 
-  case istore_3:
-  case fstore_3: {
+  CASE(istore_3):
+  CASE(fstore_3): {
     setLocalInt(t, 3, popInt(t));
   }
-    goto loop;
+    NEXT;
 
-  case isub: {
+  CASE(isub): {
     int32_t b = popInt(t);
     int32_t a = popInt(t);
 
     pushInt(t, a - b);
   }
-    goto loop;
+    NEXT;
 
-  case iushr: {
+  CASE(iushr): {
     int32_t b = popInt(t);
     uint32_t a = popInt(t);
 
     pushInt(t, a >> (b & 0x1F));
   }
-    goto loop;
+    NEXT;
 
-  case ixor: {
+  CASE(ixor): {
     int32_t b = popInt(t);
     int32_t a = popInt(t);
 
     pushInt(t, a ^ b);
   }
-    goto loop;
+    NEXT;
 
-  case jsr: {
+  CASE(jsr): {
     uint16_t offset = codeReadInt16(t, code, ip);
 
     pushInt(t, ip);
     ip = (ip - 3) + static_cast<int16_t>(offset);
   }
-    goto loop;
+    NEXT;
 
-  case jsr_w: {
+  CASE(jsr_w): {
     uint32_t offset = codeReadInt32(t, code, ip);
 
     pushInt(t, ip);
     ip = (ip - 5) + static_cast<int32_t>(offset);
   }
-    goto loop;
+    NEXT;
 
-  case l2d: {
+  CASE(l2d): {
     pushDouble(t, static_cast<double>(static_cast<int64_t>(popLong(t))));
   }
-    goto loop;
+    NEXT;
 
-  case l2f: {
+  CASE(l2f): {
     pushFloat(t, static_cast<float>(static_cast<int64_t>(popLong(t))));
   }
-    goto loop;
+    NEXT;
 
-  case l2i: {
+  CASE(l2i): {
     pushInt(t, static_cast<int32_t>(popLong(t)));
   }
-    goto loop;
+    NEXT;
 
-  case ladd: {
+  CASE(ladd): {
     int64_t b = popLong(t);
     int64_t a = popLong(t);
 
     pushLong(t, a + b);
   }
-    goto loop;
+    NEXT;
 
-  case laload: {
+  CASE(laload): {
     int32_t index = popInt(t);
     object array = popObject(t);
 
@@ -2252,17 +2601,17 @@ loop:
       goto throw_;
     }
   }
-    goto loop;
+    NEXT;
 
-  case land: {
+  CASE(land): {
     int64_t b = popLong(t);
     int64_t a = popLong(t);
 
     pushLong(t, a & b);
   }
-    goto loop;
+    NEXT;
 
-  case lastore: {
+  CASE(lastore): {
     int64_t value = popLong(t);
     int32_t index = popInt(t);
     object array = popObject(t);
@@ -2284,28 +2633,28 @@ loop:
       goto throw_;
     }
   }
-    goto loop;
+    NEXT;
 
-  case lcmp: {
+  CASE(lcmp): {
     int64_t b = popLong(t);
     int64_t a = popLong(t);
 
     pushInt(t, a > b ? 1 : a == b ? 0 : -1);
   }
-    goto loop;
+    NEXT;
 
-  case lconst_0: {
+  CASE(lconst_0): {
     pushLong(t, 0);
   }
-    goto loop;
+    NEXT;
 
-  case lconst_1: {
+  CASE(lconst_1): {
     pushLong(t, 1);
   }
-    goto loop;
+    NEXT;
 
-  case ldc:
-  case ldc_w: {
+  CASE(ldc):
+  CASE(ldc_w): {
     uint16_t index;
 
     if (instruction == ldc) {
@@ -2333,9 +2682,9 @@ loop:
       pushInt(t, singletonValue(t, pool, index - 1));
     }
   }
-    goto loop;
+    NEXT;
 
-  case ldc2_w: {
+  CASE(ldc2_w): {
     uint16_t index = codeReadInt16(t, code, ip);
 
     GcSingleton* pool = code->pool();
@@ -2344,9 +2693,9 @@ loop:
     memcpy(&v, &singletonValue(t, pool, index - 1), 8);
     pushLong(t, v);
   }
-    goto loop;
+    NEXT;
 
-  case ldiv_: {
+  CASE(ldiv_): {
     int64_t b = popLong(t);
     int64_t a = popLong(t);
 
@@ -2357,52 +2706,52 @@ loop:
 
     pushLong(t, a / b);
   }
-    goto loop;
+    NEXT;
 
-  case lload:
-  case dload: {
+  CASE(lload):
+  CASE(dload): {
     pushLong(t, localLong(t, code->body()[ip++]));
   }
-    goto loop;
+    NEXT;
 
-  case lload_0:
-  case dload_0: {
+  CASE(lload_0):
+  CASE(dload_0): {
     pushLong(t, localLong(t, 0));
   }
-    goto loop;
+    NEXT;
 
-  case lload_1:
-  case dload_1: {
+  CASE(lload_1):
+  CASE(dload_1): {
     pushLong(t, localLong(t, 1));
   }
-    goto loop;
+    NEXT;
 
-  case lload_2:
-  case dload_2: {
+  CASE(lload_2):
+  CASE(dload_2): {
     pushLong(t, localLong(t, 2));
   }
-    goto loop;
+    NEXT;
 
-  case lload_3:
-  case dload_3: {
+  CASE(lload_3):
+  CASE(dload_3): {
     pushLong(t, localLong(t, 3));
   }
-    goto loop;
+    NEXT;
 
-  case lmul: {
+  CASE(lmul): {
     int64_t b = popLong(t);
     int64_t a = popLong(t);
 
     pushLong(t, a * b);
   }
-    goto loop;
+    NEXT;
 
-  case lneg: {
+  CASE(lneg): {
     pushLong(t, -popLong(t));
   }
-    goto loop;
+    NEXT;
 
-  case lookupswitch: {
+  CASE(lookupswitch): {
     int32_t base = ip - 1;
 
     ip += 3;
@@ -2427,23 +2776,23 @@ loop:
         bottom = middle + 1;
       } else {
         ip = base + codeReadInt32(t, code, index);
-        goto loop;
+        NEXT;
       }
     }
 
     ip = base + default_;
   }
-    goto loop;
+    NEXT;
 
-  case lor: {
+  CASE(lor): {
     int64_t b = popLong(t);
     int64_t a = popLong(t);
 
     pushLong(t, a | b);
   }
-    goto loop;
+    NEXT;
 
-  case lrem: {
+  CASE(lrem): {
     int64_t b = popLong(t);
     int64_t a = popLong(t);
 
@@ -2454,92 +2803,92 @@ loop:
 
     pushLong(t, a % b);
   }
-    goto loop;
+    NEXT;
 
-  case lreturn:
-  case dreturn: {
+  CASE(lreturn):
+  CASE(dreturn): {
     int64_t result = popLong(t);
     if (frame > base) {
       popFrame(t);
       pushLong(t, result);
-      goto loop;
+      NEXT;
     } else {
       return makeLong(t, result);
     }
   }
-    goto loop;
+    NEXT;
 
-  case lshl: {
+  CASE(lshl): {
     int32_t b = popInt(t);
     int64_t a = popLong(t);
 
     pushLong(t, a << (b & 0x3F));
   }
-    goto loop;
+    NEXT;
 
-  case lshr: {
+  CASE(lshr): {
     int32_t b = popInt(t);
     int64_t a = popLong(t);
 
     pushLong(t, a >> (b & 0x3F));
   }
-    goto loop;
+    NEXT;
 
-  case lstore:
-  case dstore: {
+  CASE(lstore):
+  CASE(dstore): {
     setLocalLong(t, code->body()[ip++], popLong(t));
   }
-    goto loop;
+    NEXT;
 
-  case lstore_0:
-  case dstore_0: {
+  CASE(lstore_0):
+  CASE(dstore_0): {
     setLocalLong(t, 0, popLong(t));
   }
-    goto loop;
+    NEXT;
 
-  case lstore_1:
-  case dstore_1: {
+  CASE(lstore_1):
+  CASE(dstore_1): {
     setLocalLong(t, 1, popLong(t));
   }
-    goto loop;
+    NEXT;
 
-  case lstore_2:
-  case dstore_2: {
+  CASE(lstore_2):
+  CASE(dstore_2): {
     setLocalLong(t, 2, popLong(t));
   }
-    goto loop;
+    NEXT;
 
-  case lstore_3:
-  case dstore_3: {
+  CASE(lstore_3):
+  CASE(dstore_3): {
     setLocalLong(t, 3, popLong(t));
   }
-    goto loop;
+    NEXT;
 
-  case lsub: {
+  CASE(lsub): {
     int64_t b = popLong(t);
     int64_t a = popLong(t);
 
     pushLong(t, a - b);
   }
-    goto loop;
+    NEXT;
 
-  case lushr: {
+  CASE(lushr): {
     int64_t b = popInt(t);
     uint64_t a = popLong(t);
 
     pushLong(t, a >> (b & 0x3F));
   }
-    goto loop;
+    NEXT;
 
-  case lxor: {
+  CASE(lxor): {
     int64_t b = popLong(t);
     int64_t a = popLong(t);
 
     pushLong(t, a ^ b);
   }
-    goto loop;
+    NEXT;
 
-  case monitorenter: {
+  CASE(monitorenter): {
     object o = popObject(t);
     if (LIKELY(o)) {
       acquire(t, o);
@@ -2548,9 +2897,9 @@ loop:
       goto throw_;
     }
   }
-    goto loop;
+    NEXT;
 
-  case monitorexit: {
+  CASE(monitorexit): {
     object o = popObject(t);
     if (LIKELY(o)) {
       release(t, o);
@@ -2559,9 +2908,9 @@ loop:
       goto throw_;
     }
   }
-    goto loop;
+    NEXT;
 
-  case multianewarray: {
+  CASE(multianewarray): {
     uint16_t index = codeReadInt16(t, code, ip);
     uint8_t dimensions = code->body()[ip++];
 
@@ -2588,9 +2937,9 @@ loop:
 
     pushObject(t, array);
   }
-    goto loop;
+    NEXT;
 
-  case new_: {
+  CASE(new_): {
     uint16_t index = codeReadInt16(t, code, ip);
 
     GcClass* class_ = resolveClassInPool(t, frameMethod(t, frame), index - 1);
@@ -2600,9 +2949,9 @@ loop:
 
     pushObject(t, make(t, class_));
   }
-    goto loop;
+    NEXT;
 
-  case newarray: {
+  CASE(newarray): {
     int32_t count = popInt(t);
 
     if (LIKELY(count >= 0)) {
@@ -2654,27 +3003,34 @@ loop:
       goto throw_;
     }
   }
-    goto loop;
+    NEXT;
 
-  case nop:
-    goto loop;
+  CASE(nop):
+    NEXT;
 
-  case pop_: {
+  CASE(pop_): {
     --sp;
   }
-    goto loop;
+    NEXT;
 
-  case pop2: {
+  CASE(pop2): {
     sp -= 2;
   }
-    goto loop;
+    NEXT;
 
-  case putfield: {
+  CASE(putfield): {
     uint16_t index = codeReadInt16(t, code, ip);
 
     GcField* field = resolveField(t, frameMethod(t, frame), index - 1);
 
     assertT(t, (field->flags() & ACC_STATIC) == 0);
+
+    unsigned quick = quickFieldInstruction(field, putfield);
+    if (quick) {
+      PROTECT(t, field);
+      quicken(t, frameMethod(t, frame), ip - 3, quick, field->offset());
+    }
+
     PROTECT(t, field);
 
     {
@@ -2741,9 +3097,51 @@ loop:
       goto throw_;
     }
   }
-    goto loop;
+    NEXT;
+
+  CASE(putfield_quick_int): {
+    unsigned offset = quickOperand(t, code, ip);
 
-  case putstatic: {
+    int32_t value = popInt(t);
+    object o = popObject(t);
+    if (LIKELY(o)) {
+      fieldAtOffset<int32_t>(o, offset) = value;
+    } else {
+      exception = makeThrowable(t, GcNullPointerException::Type);
+      goto throw_;
+    }
+  }
+    NEXT;
+
+  CASE(putfield_quick_long): {
+    unsigned offset = quickOperand(t, code, ip);
+
+    int64_t value = popLong(t);
+    object o = popObject(t);
+    if (LIKELY(o)) {
+      fieldAtOffset<int64_t>(o, offset) = value;
+    } else {
+      exception = makeThrowable(t, GcNullPointerException::Type);
+      goto throw_;
+    }
+  }
+    NEXT;
+
+  CASE(putfield_quick_object): {
+    unsigned offset = quickOperand(t, code, ip);
+
+    object value = popObject(t);
+    object o = popObject(t);
+    if (LIKELY(o)) {
+      setField(t, o, offset, value);
+    } else {
+      exception = makeThrowable(t, GcNullPointerException::Type);
+      goto throw_;
+    }
+  }
+    NEXT;
+
+  CASE(putstatic): {
     uint16_t index = codeReadInt16(t, code, ip);
 
     GcField* field = resolveField(t, frameMethod(t, frame), index - 1);
@@ -2797,14 +3195,14 @@ loop:
       abort(t);
     }
   }
-    goto loop;
+    NEXT;
 
-  case ret: {
+  CASE(ret): {
     ip = localInt(t, code->body()[ip]);
   }
-    goto loop;
+    NEXT;
 
-  case return_: {
+  CASE(return_): {
     GcMethod* method = frameMethod(t, frame);
     if ((method->flags() & ConstructorFlag)
         and (method->class_()->vmFlags() & HasFinalMemberFlag)) {
@@ -2813,14 +3211,14 @@ loop:
 
     if (frame > base) {
       popFrame(t);
-      goto loop;
+      NEXT;
     } else {
       return 0;
     }
   }
-    goto loop;
+    NEXT;
 
-  case saload: {
+  CASE(saload): {
     int32_t index = popInt(t);
     object array = popObject(t);
 
@@ -2841,9 +3239,9 @@ loop:
       goto throw_;
     }
   }
-    goto loop;
+    NEXT;
 
-  case sastore: {
+  CASE(sastore): {
     int16_t value = popInt(t);
     int32_t index = popInt(t);
     object array = popObject(t);
@@ -2865,22 +3263,22 @@ loop:
       goto throw_;
     }
   }
-    goto loop;
+    NEXT;
 
-  case sipush: {
+  CASE(sipush): {
     pushInt(t, static_cast<int16_t>(codeReadInt16(t, code, ip)));
   }
-    goto loop;
+    NEXT;
 
-  case swap: {
+  CASE(swap): {
     uintptr_t tmp[2];
     memcpy(tmp, stack + ((sp - 1) * 2), BytesPerWord * 2);
     memcpy(stack + ((sp - 1) * 2), stack + ((sp - 2) * 2), BytesPerWord * 2);
     memcpy(stack + ((sp - 2) * 2), tmp, BytesPerWord * 2);
   }
-    goto loop;
+    NEXT;
 
-  case tableswitch: {
+  CASE(tableswitch): {
     int32_t base = ip - 1;
 
     ip += 3;
@@ -2899,12 +3297,12 @@ loop:
       ip = base + default_;
     }
   }
-    goto loop;
+    NEXT;
 
-  case wide:
+  CASE(wide):
     goto wide;
 
-  case impdep1: {
+  CASE(impdep1): {
     // this means we're invoking a virtual method on an instance of a
     // bootstrap class, so we need to load the real class to get the
     // real method and call it.
@@ -2912,7 +3310,9 @@ loop:
     assertT(t, frameNext(t, frame) >= base);
     popFrame(t);
 
-    assertT(t, code->body()[ip - 3] == invokevirtual);
+    assertT(t,
+            code->body()[ip - 3] == invokevirtual
+            or code->body()[ip - 3] == invokevirtual_quick);
     ip -= 2;
 
     uint16_t index = codeReadInt16(t, code, ip);
@@ -2926,9 +3326,9 @@ loop:
 
     ip -= 3;
   }
-    goto loop;
+    NEXT;
 
-  default:
+  DEFAULT:
     abort(t);
   }
 
@@ -2937,12 +3337,12 @@ wide:
   case aload: {
     pushObject(t, localObject(t, codeReadInt16(t, code, ip)));
   }
-    goto loop;
+    NEXT;
 
   case astore: {
     setLocalObject(t, codeReadInt16(t, code, ip), popObject(t));
   }
-    goto loop;
+    NEXT;
 
   case iinc: {
     uint16_t index = codeReadInt16(t, code, ip);
@@ -2950,32 +3350,32 @@ wide:
 
     setLocalInt(t, index, localInt(t, index) + count);
   }
-    goto loop;
+    NEXT;
 
   case iload: {
     pushInt(t, localInt(t, codeReadInt16(t, code, ip)));
   }
-    goto loop;
+    NEXT;
 
   case istore: {
     setLocalInt(t, codeReadInt16(t, code, ip), popInt(t));
   }
-    goto loop;
+    NEXT;
 
   case lload: {
     pushLong(t, localLong(t, codeReadInt16(t, code, ip)));
   }
-    goto loop;
+    NEXT;
 
   case lstore: {
     setLocalLong(t, codeReadInt16(t, code, ip), popLong(t));
   }
-    goto loop;
+    NEXT;
 
   case ret: {
     ip = localInt(t, codeReadInt16(t, code, ip));
   }
-    goto loop;
+    NEXT;
 
   default:
     abort(t);
@@ -2983,7 +3383,7 @@ wide:
 
 back_branch:
   safePoint(t);
-  goto loop;
+  NEXT;
 
 invoke : {
   if (method->flags() & ACC_NATIVE) {
@@ -2993,7 +3393,7 @@ invoke : {
     pushFrame(t, method);
   }
 }
-  goto loop;
+  NEXT;
 
 throw_:
   if (DebugRun) {
@@ -3008,13 +3408,17 @@ throw_:
       ip = exceptionHandlerIp(eh);
       pushObject(t, exception);
       exception = 0;
-      goto loop;
+      NEXT;
     }
   }
 
   return 0;
 }
 
+#undef CASE
+#undef DEFAULT
+#undef NEXT
+
 uint64_t interpret2(vm::Thread* t, uintptr_t* arguments)
 {
   int base = arguments[0];
@@ -3304,6 +3708,7 @@ class MyProcessor : public Processor {
                          sourceFile,
                          super,
                          interfaceTable,
+                         0,
                          virtualTable,
                          fieldTable,
                          methodTable,
@@ -3311,6 +3716,7 @@ class MyProcessor : public Processor {
                          staticTable,
                          loader,
                          0,
+                         0,
                          0);
   }
 
@@ -3493,7 +3899,7 @@ class MyProcessor : public Processor {
   virtual object getStackTrace(vm::Thread* t, vm::Thread*)
   {
     // not implemented
-    return makeObjectArray(t, 0);
+    return makeRawTrace(t, 0, 0);
   }
 
   virtual void initialize(BootImage*, avian::util::Slice<uint8_t>)
@@ -3618,6 +3618,11 @@ extern "C" AVIAN_EXPORT jint JNICALL
   const char* classpath = 0;
   const char* javaHome = AVIAN_JAVA_HOME;
   bool reentrant = false;
+  unsigned gcThreads = 1;
+  bool gcCompact = false;
+  const char* gcLog = 0;
+  unsigned gcUncommitDelay = 0;
+  unsigned gcMinFreeRatio = 50;
   const char* embedPrefix = AVIAN_EMBED_PREFIX;
   const char* bootClasspathPrepend = "";
   const char* bootClasspath = 0;
@@ -3671,6 +3676,23 @@ extern "C" AVIAN_EXPORT jint JNICALL
       } else if (strncmp(p, REENTRANT_PROPERTY "=", sizeof(REENTRANT_PROPERTY))
                  == 0) {
         reentrant = strcmp(p + sizeof(REENTRANT_PROPERTY), "true") == 0;
+      } else if (strncmp(p, GC_THREADS_PROPERTY "=", sizeof(GC_THREADS_PROPERTY))
+                 == 0) {
+        gcThreads = atoi(p + sizeof(GC_THREADS_PROPERTY));
+      } else if (strncmp(p, GC_COMPACT_PROPERTY "=", sizeof(GC_COMPACT_PROPERTY))
+                 == 0) {
+        gcCompact = strcmp(p + sizeof(GC_COMPACT_PROPERTY), "true") == 0;
+      } else if (strncmp(p, GC_LOG_PROPERTY "=", sizeof(GC_LOG_PROPERTY))
+                 == 0) {
+        gcLog = p + sizeof(GC_LOG_PROPERTY);
+      } else if (strncmp(p,
+                         GC_UNCOMMIT_DELAY_PROPERTY "=",
+                         sizeof(GC_UNCOMMIT_DELAY_PROPERTY)) == 0) {
+        gcUncommitDelay = atoi(p + sizeof(GC_UNCOMMIT_DELAY_PROPERTY));
+      } else if (strncmp(p,
+                         GC_MIN_FREE_RATIO_PROPERTY "=",
+                         sizeof(GC_MIN_FREE_RATIO_PROPERTY)) == 0) {
+        gcMinFreeRatio = atoi(p + sizeof(GC_MIN_FREE_RATIO_PROPERTY));
       } else if (strncmp(p,
                          EMBED_PREFIX_PROPERTY "=",
                          sizeof(EMBED_PREFIX_PROPERTY)) == 0) {
@@ -3694,7 +3716,12 @@ extern "C" AVIAN_EXPORT jint JNICALL
   }
 
   System* s = makeSystem(reentrant);
-  Heap* h = makeHeap(s, heapLimit);
+  Heap* h = makeHeap(s, heapLimit, gcThreads, gcCompact);
+  h->setUncommitPolicy(gcUncommitDelay, gcMinFreeRatio);
+  if (gcLog) {
+    h->setLog(gcLog);
+  }
+
   Classpath* c = makeClasspath(s, h, javaHome, embedPrefix);
 
   if (bootClasspath == 0) {
@@ -14,6 +14,7 @@
 #include <avian/util/stream.h>
 #include "avian/constants.h"
 #include "avian/processor.h"
+#include "avian/process.h"
 #include "avian/arch.h"
 #include "avian/lzma.h"
 
@@ -663,8 +664,97 @@ void postVisit(Thread* t, Heap::Visitor* v)
   }
 }
 
+void visitFinalizers(Heap::Visitor* v, GcFinalizer** p)
+{
+  while (*p) {
+    GcFinalizer* finalizer = *p;
+    v->visit(p);
+    v->visit(&finalizer->target());
+    p = reinterpret_cast<GcFinalizer**>(&finalizer->next());
+  }
+}
+
+void visitWeakReferences(Heap::Visitor* v, GcJreference** p)
+{
+  while (*p) {
+    GcJreference* reference = *p;
+    v->visit(p);
+    v->visit(&reference->target());
+    v->visit(&reference->queue());
+    p = reinterpret_cast<GcJreference**>(&reference->vmNext());
+  }
+}
+
+// visit everything visitRoots and postVisit visited, in their final
+// locations, without following any of them
+void updateRoots(Machine* m, Heap::Visitor* v)
+{
+  visitRoots(m, v);
+
+  visitFinalizers(v, &(m->finalizers));
+  visitFinalizers(v, &(m->tenuredFinalizers));
+  visitFinalizers(v, &(m->finalizeQueue));
+
+  visitWeakReferences(v, &(m->weakReferences));
+  visitWeakReferences(v, &(m->tenuredWeakReferences));
+
+  for (Reference* r = m->jniReferences; r; r = r->next) {
+    if (r->weak) {
+      v->visit(&(r->target));
+    }
+  }
+}
+
+uintptr_t* tryAllocateThreadHeap(Thread* t, unsigned sizeInWords)
+{
+  Machine* m = t->m;
+  unsigned sizeInBytes = (ThreadHeapHeaderSizeInWords + sizeInWords)
+                         * BytesPerWord;
+
+  if (m->heapPoolFootprint + sizeInBytes > m->youngFootprintLimit) {
+    return 0;
+  }
+
+  uintptr_t* p = static_cast<uintptr_t*>(m->heap->tryAllocate(sizeInBytes));
+
+  if (p) {
+    memset(p, 0, sizeInBytes);
+
+    p[0] = reinterpret_cast<uintptr_t>(m->heapPool);
+    p[1] = sizeInBytes;
+    m->heapPool = p;
+    m->heapPoolFootprint += sizeInBytes;
+
+    return p + ThreadHeapHeaderSizeInWords;
+  } else {
+    return 0;
+  }
+}
+
+void disposeHeapPool(Machine* m)
+{
+  for (uintptr_t* p = m->heapPool; p;) {
+    uintptr_t* next = reinterpret_cast<uintptr_t*>(p[0]);
+    m->heap->free(p, p[1]);
+    p = next;
+  }
+
+  m->heapPool = 0;
+  m->heapPoolFootprint = 0;
+}
+
 void postCollect(Thread* t)
 {
+  // size future thread-local heaps so that, if this thread keeps
+  // allocating at the rate it did since the last collection, it will
+  // refill about ThreadHeapRefillsPerCollection times before the next
+  // one:
+  t->heapRefillSize = max(
+      ThreadHeapSizeInWords,
+      min(MaxThreadHeapSizeInWords,
+          nextPowerOfTwo((t->heapOffset + t->heapIndex)
+                         / ThreadHeapRefillsPerCollection)));
+
 #ifdef VM_STRESS
   t->m->heap->free(t->defaultHeap, ThreadHeapSizeInBytes);
   t->defaultHeap
@@ -680,11 +770,14 @@ void postCollect(Thread* t)
   }
 
   t->heapOffset = 0;
+  t->heapLimit = ThreadHeapSizeInWords;
+
+  clearMonitorCache(t);
 
   if (t->m->heap->limitExceeded()) {
     // if we're out of memory, pretend the thread-local heap is
     // already full so we don't make things worse:
-    t->heapIndex = ThreadHeapSizeInWords;
+    t->heapIndex = t->heapLimit;
   } else {
     t->heapIndex = 0;
   }
@@ -2294,7 +2387,7 @@ GcCode* parseCode(Thread* t, Stream& s, GcSingleton* pool)
             length);
   }
 
-  GcCode* code = makeCode(t, pool, 0, 0, 0, 0, 0, maxStack, maxLocals, length);
+  GcCode* code = makeCode(t, pool, 0, 0, 0, 0, 0, 0, maxStack, maxLocals, length);
   s.read(code->body().begin(), length);
   PROTECT(t, code);
 
@@ -2406,6 +2499,46 @@ GcList* addInterfaceMethods(Thread* t,
   return 0;
 }
 
+void makeInterfaceMethodTable(Thread* t, GcClass* class_)
+{
+  GcArray* itable = cast<GcArray>(t, class_->interfaceTable());
+  if (itable == 0 or itable->length() == 0) {
+    return;
+  }
+
+  PROTECT(t, class_);
+  PROTECT(t, itable);
+
+  GcArray* imt = makeArray(t, InterfaceMethodTableSize);
+
+  bool conflicts[InterfaceMethodTableSize];
+  memset(conflicts, 0, sizeof(conflicts));
+
+  for (unsigned i = 0; i < itable->length(); i += 2) {
+    GcArray* vtable = cast<GcArray>(t, itable->body()[i + 1]);
+    if (vtable) {
+      for (unsigned j = 0; j < vtable->length(); ++j) {
+        GcMethod* method = cast<GcMethod>(t, vtable->body()[j]);
+        unsigned index = interfaceMethodTableIndex(t, method);
+
+        // methods sharing a selector have the same implementation,
+        // so any other occupant of the slot is a true conflict:
+        if (not conflicts[index]) {
+          object occupant = imt->body()[index];
+          if (occupant == 0) {
+            imt->setBodyElement(t, index, method);
+          } else if (occupant != method) {
+            imt->setBodyElement(t, index, 0);
+            conflicts[index] = true;
+          }
+        }
+      }
+    }
+  }
+
+  class_->setInterfaceMethodTable(t, imt);
+}
+
 void parseMethodTable(Thread* t, Stream& s, GcClass* class_, GcSingleton* pool)
 {
   PROTECT(t, class_);
@@ -2746,7 +2879,15 @@ void parseMethodTable(Thread* t, Stream& s, GcClass* class_, GcSingleton* pool)
           }
         }
       }
+
+      makeInterfaceMethodTable(t, class_);
     }
+  } else if (class_->super() and class_->interfaceTable()
+                                    == class_->super()->interfaceTable()) {
+    // same virtual and interface tables as the superclass, so the
+    // same interface method table as well
+    class_->setInterfaceMethodTable(t,
+                                    class_->super()->interfaceMethodTable());
   }
 }
 
@@ -2887,6 +3028,35 @@ void updateClassTables(Thread* t, GcClass* newClass, GcClass* oldClass)
   }
 }
 
+void makePrimarySupers(Thread* t, GcClass* class_)
+{
+  if (class_->flags() & ACC_INTERFACE) {
+    return;
+  }
+
+  GcArray* superSupers = 0;
+  if (class_->super()) {
+    superSupers = cast<GcArray>(t, class_->super()->primarySupers());
+    if (superSupers == 0) {
+      // the superclass doesn't have a display yet, so neither can we;
+      // isAssignableFrom will walk the hierarchy instead
+      return;
+    }
+  }
+
+  PROTECT(t, class_);
+  PROTECT(t, superSupers);
+
+  unsigned depth = superSupers ? superSupers->length() : 0;
+  GcArray* supers = makeArray(t, depth + 1);
+  for (unsigned i = 0; i < depth; ++i) {
+    supers->setBodyElement(t, i, superSupers->body()[i]);
+  }
+  supers->setBodyElement(t, depth, class_);
+
+  class_->setPrimarySupers(t, supers);
+}
+
 void updateBootstrapClass(Thread* t, GcClass* bootstrapClass, GcClass* class_)
 {
   expect(t, bootstrapClass != class_);
@@ -2910,12 +3080,15 @@ void updateBootstrapClass(Thread* t, GcClass* bootstrapClass, GcClass* class_)
   bootstrapClass->setArrayElementClass(t, class_->arrayElementClass());
   bootstrapClass->setSuper(t, class_->super());
   bootstrapClass->setInterfaceTable(t, class_->interfaceTable());
+  bootstrapClass->setInterfaceMethodTable(t, class_->interfaceMethodTable());
   bootstrapClass->setVirtualTable(t, class_->virtualTable());
   bootstrapClass->setFieldTable(t, class_->fieldTable());
   bootstrapClass->setMethodTable(t, class_->methodTable());
   bootstrapClass->setStaticTable(t, class_->staticTable());
   bootstrapClass->setAddendum(t, class_->addendum());
 
+  makePrimarySupers(t, bootstrapClass);
+
   updateClassTables(t, bootstrapClass, class_);
 }
 
@@ -3112,11 +3285,6 @@ void removeMonitor(Thread* t, object o)
   }
 }
 
-void removeString(Thread* t, object o)
-{
-  hashMapRemove(t, roots(t)->stringMap(), o, stringHash, objectEqual);
-}
-
 void bootClass(Thread* t,
                Gc::Type type,
                int superType,
@@ -3351,7 +3519,7 @@ void boot(Thread* t)
   m->processor->boot(t, 0, 0);
 
   {
-    GcCode* bootCode = makeCode(t, 0, 0, 0, 0, 0, 0, 0, 0, 1);
+    GcCode* bootCode = makeCode(t, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1);
     bootCode->body()[0] = impdep1;
     object bootMethod
         = makeMethod(t, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, bootCode);
@@ -3441,6 +3609,30 @@ class HeapClient : public Heap::Client {
     }
   }
 
+  virtual void updateRoots(Heap::Visitor* v)
+  {
+    ::updateRoots(m, v);
+  }
+
+  virtual void move(void* srcp, void* dstp, unsigned sizeInWords)
+  {
+    Thread* t = m->rootThread;
+
+    object src = static_cast<object>(srcp);
+    object dst = static_cast<object>(dstp);
+
+    // the header may be overwritten by the move, so check it first
+    bool extend = hashTaken(t, src);
+
+    memmove(dst, src, sizeInWords * BytesPerWord);
+
+    if (extend) {
+      alias(dst, 0) &= PointerMask;
+      alias(dst, 0) |= ExtendedMark;
+      extendedWord(t, dst, sizeInWords) = takeHash(t, src);
+    }
+  }
+
   virtual void walk(void* p, Heap::Walker* w)
   {
     object o = static_cast<object>(m->heap->follow(maskAlignedPointer(p)));
@@ -3471,26 +3663,37 @@ void doCollect(Thread* t, Heap::CollectionType type, int pendingAllocation)
 
   Machine* m = t->m;
 
+  resolveAllocationSamples(t);
+
   m->unsafe = true;
-  m->heap->collect(
-      type,
-      footprint(m->rootThread),
-      pendingAllocation - (t->m->heapPoolIndex * ThreadHeapSizeInWords));
+  m->heap->collect(type,
+                   footprint(m->rootThread),
+                   pendingAllocation - (m->heapPoolFootprint / BytesPerWord));
   m->unsafe = false;
 
   postCollect(m->rootThread);
 
+  // the collector clears the weak keys of interned strings which are
+  // no longer reachable, but leaves their entries in place.  Tenured
+  // keys are only cleared by major collections, so after a minor one
+  // we only bother sweeping if enough strings have been interned
+  // since the last sweep to make it worthwhile:
+  GcHashMap* strings = m->roots ? m->roots->stringMap() : 0;
+  if (strings
+      and (m->heap->collectionType() == Heap::MajorCollection
+           or m->internedSinceSweep * 4 >= strings->size())) {
+    hashMapSweep(t, strings);
+    m->internedSinceSweep = 0;
+  }
+
   killZombies(t, m->rootThread);
 
-  for (unsigned i = 0; i < m->heapPoolIndex; ++i) {
-    m->heap->free(m->heapPool[i], ThreadHeapSizeInBytes);
-  }
-  m->heapPoolIndex = 0;
+  disposeHeapPool(m);
 
   if (m->heap->limitExceeded()) {
     // if we're out of memory, disallow further allocations of fixed
     // objects:
-    m->fixedFootprint = FixedFootprintThresholdInBytes;
+    m->fixedFootprint = m->youngFootprintLimit;
   } else {
     m->fixedFootprint = 0;
   }
@@ -3663,10 +3866,14 @@ Machine::Machine(System* system,
       liveCount(0),
       daemonCount(0),
       fixedFootprint(0),
+      internedSinceSweep(0),
+      youngFootprintLimit(
+          max(MinYoungFootprintInBytes,
+              min(MaxYoungFootprintInBytes,
+                  heap->limit() / YoungFootprintDivisor))),
       stackSizeInBytes(stackSizeInBytes),
       localThread(0),
       stateLock(0),
-      heapLock(0),
       classLock(0),
       referenceLock(0),
       shutdownLock(0),
@@ -3685,7 +3892,9 @@ Machine::Machine(System* system,
       triedBuiltinOnLoad(false),
       dumpedHeapOnOOM(false),
       alive(true),
-      heapPoolIndex(0)
+      heapPool(0),
+      heapPoolFootprint(0),
+      allocationProfile(0)
 {
   heap->setClient(heapClient);
 
@@ -3713,7 +3922,6 @@ Machine::Machine(System* system,
 
   if (not system->success(system->make(&localThread))
       or not system->success(system->make(&stateLock))
-      or not system->success(system->make(&heapLock))
       or not system->success(system->make(&classLock))
       or not system->success(system->make(&referenceLock))
       or not system->success(system->make(&shutdownLock))
@@ -3735,13 +3943,19 @@ Machine::Machine(System* system,
 
   if (bootstrapPropertyDup)
     free((void*)bootstrapPropertyDup);
+
+  const char* sampleInterval
+      = findProperty(this, ALLOCATION_SAMPLE_INTERVAL_PROPERTY);
+  if (sampleInterval and atoi(sampleInterval) > 0) {
+    allocationProfile
+        = makeAllocationProfile(system, heap, atoi(sampleInterval));
+  }
 }
 
 void Machine::dispose()
 {
   localThread->dispose();
   stateLock->dispose();
-  heapLock->dispose();
   classLock->dispose();
   referenceLock->dispose();
   shutdownLock->dispose();
@@ -3756,8 +3970,10 @@ void Machine::dispose()
     heap->free(tmp, sizeof(*tmp));
   }
 
-  for (unsigned i = 0; i < heapPoolIndex; ++i) {
-    heap->free(heapPool[i], ThreadHeapSizeInBytes);
+  disposeHeapPool(this);
+
+  if (allocationProfile) {
+    disposeAllocationProfile(allocationProfile);
   }
 
   if (bootimage) {
@@ -3791,6 +4007,8 @@ Thread::Thread(Machine* m, GcThread* javaThread, Thread* parent)
       exception(0),
       heapIndex(0),
       heapOffset(0),
+      heapLimit(ThreadHeapSizeInWords),
+      heapRefillSize(ThreadHeapSizeInWords),
       protector(0),
       classInitStack(0),
       libraryLoadStack(0),
@@ -3798,6 +4016,13 @@ Thread::Thread(Machine* m, GcThread* javaThread, Thread* parent)
       defaultHeap(
           static_cast<uintptr_t*>(m->heap->allocate(ThreadHeapSizeInBytes))),
       heap(defaultHeap),
+      sampledObject(0),
+      sampledStack(0),
+      sampledSize(0),
+      allocationSampleCountdown(
+          m->allocationProfile
+              ? initialSampleCountdown(m->allocationProfile, this)
+              : 0),
       backupHeapIndex(0),
       flags(ActiveFlag)
 {
@@ -3807,6 +4032,7 @@ void Thread::init()
 {
   memset(defaultHeap, 0, ThreadHeapSizeInBytes);
   memset(backupHeap, 0, ThreadBackupHeapSizeInBytes);
+  clearMonitorCache(this);
 
   if (parent == 0) {
     assertT(this, m->rootThread == 0);
@@ -4221,7 +4447,7 @@ object allocate3(Thread* t,
   } else if (UNLIKELY(t->getFlags() & Thread::TracingFlag)) {
     expect(t,
            t->heapIndex + ceilingDivide(sizeInBytes, BytesPerWord)
-           <= ThreadHeapSizeInWords);
+           <= t->heapLimit);
     return allocateSmall(t, sizeInBytes);
   }
 
@@ -4241,26 +4467,30 @@ object allocate3(Thread* t,
     switch (type) {
     case Machine::MovableAllocation:
       if (t->heapIndex + ceilingDivide(sizeInBytes, BytesPerWord)
-          > ThreadHeapSizeInWords) {
+          > t->heapLimit) {
         t->heap = 0;
-        if ((not t->m->heap->limitExceeded())
-            and t->m->heapPoolIndex < ThreadHeapPoolSize) {
-          t->heap = static_cast<uintptr_t*>(
-              t->m->heap->tryAllocate(ThreadHeapSizeInBytes));
+        if (not t->m->heap->limitExceeded()) {
+          // try a heap sized for this thread's allocation rate first,
+          // falling back to the minimum size if that would exceed
+          // the young generation budget:
+          unsigned size = t->heapRefillSize;
+          t->heap = tryAllocateThreadHeap(t, size);
+          if (t->heap == 0 and size > ThreadHeapSizeInWords) {
+            size = ThreadHeapSizeInWords;
+            t->heap = tryAllocateThreadHeap(t, size);
+          }
 
           if (t->heap) {
-            memset(t->heap, 0, ThreadHeapSizeInBytes);
-
-            t->m->heapPool[t->m->heapPoolIndex++] = t->heap;
             t->heapOffset += t->heapIndex;
             t->heapIndex = 0;
+            t->heapLimit = size;
           }
         }
       }
       break;
 
     case Machine::FixedAllocation:
-      if (t->m->fixedFootprint + sizeInBytes > FixedFootprintThresholdInBytes) {
+      if (t->m->fixedFootprint + sizeInBytes > t->m->youngFootprintLimit) {
         t->heap = 0;
       }
       break;
@@ -4283,7 +4513,7 @@ object allocate3(Thread* t,
     }
   } while (type == Machine::MovableAllocation
            and t->heapIndex + ceilingDivide(sizeInBytes, BytesPerWord)
-               > ThreadHeapSizeInWords);
+               > t->heapLimit);
 
   switch (type) {
   case Machine::MovableAllocation: {
@@ -4301,6 +4531,10 @@ object allocate3(Thread* t,
     t->m->fixedFootprint += t->m->heap->fixedFootprint(
         ceilingDivide(sizeInBytes, BytesPerWord), objectMask);
 
+    if (UNLIKELY(t->m->allocationProfile)) {
+      sampleAllocation(t, o, sizeInBytes);
+    }
+
     return o;
   }
 
@@ -4325,7 +4559,7 @@ void collect(Thread* t, Heap::CollectionType type, int pendingAllocation)
   ENTER(t, Thread::ExclusiveState);
 
   unsigned pending = pendingAllocation
-                     - (t->m->heapPoolIndex * ThreadHeapSizeInWords);
+                     - (t->m->heapPoolFootprint / BytesPerWord);
 
   if (t->m->heap->limitExceeded(pending)) {
     type = Heap::MajorCollection;
@@ -4553,6 +4787,15 @@ bool isAssignableFrom(Thread* t, GcClass* a, GcClass* b)
     return true;
 
   if (a->flags() & ACC_INTERFACE) {
+    // The last interface found to be implemented by b is cached in
+    // its runtime data rather than in b itself, since b may be an
+    // immortal boot image object.  We don't create the runtime data
+    // here, since some callers can't tolerate a collection:
+    GcClassRuntimeData* runtimeData = getClassRuntimeDataIfExists(t, b);
+    if (runtimeData and runtimeData->secondarySuperCache() == a) {
+      return true;
+    }
+
     if (b->vmFlags() & BootstrapFlag) {
       uintptr_t arguments[] = {reinterpret_cast<uintptr_t>(b->name())};
 
@@ -4567,6 +4810,12 @@ bool isAssignableFrom(Thread* t, GcClass* a, GcClass* b)
       unsigned stride = (b->flags() & ACC_INTERFACE) ? 1 : 2;
       for (unsigned i = 0; i < itable->length(); i += stride) {
         if (itable->body()[i] == a) {
+          // resolveBootstrap may have moved the runtime data, so we
+          // look it up again:
+          runtimeData = getClassRuntimeDataIfExists(t, b);
+          if (runtimeData) {
+            runtimeData->setSecondarySuperCache(t, a);
+          }
           return true;
         }
       }
@@ -4577,6 +4826,15 @@ bool isAssignableFrom(Thread* t, GcClass* a, GcClass* b)
           t, a->arrayElementClass(), b->arrayElementClass());
     }
   } else if ((a->vmFlags() & PrimitiveFlag) == (b->vmFlags() & PrimitiveFlag)) {
+    // if both classes have supertype displays, b is a subclass of a
+    // exactly when a appears in b's display at a's own depth:
+    GcArray* aSupers = cast<GcArray>(t, a->primarySupers());
+    GcArray* bSupers = cast<GcArray>(t, b->primarySupers());
+    if (aSupers and bSupers) {
+      unsigned depth = aSupers->length() - 1;
+      return depth < bSupers->length() and bSupers->body()[depth] == a;
+    }
+
     for (; b; b = b->super()) {
       if (b == a) {
         return true;
@@ -4744,6 +5002,7 @@ GcClass* parseClass(Thread* t,
       0,  // source file
       0,  // super
       0,  // interfaces
+      0,  // interface method table
       0,  // vtable
       0,  // fields
       0,  // methods
@@ -4751,6 +5010,7 @@ GcClass* parseClass(Thread* t,
       0,  // static table
       loader,
       0,   // source
+      0,   // primary supers
       0);  // vtable length
   PROTECT(t, class_);
 
@@ -4806,6 +5066,10 @@ GcClass* parseClass(Thread* t,
 
   PROTECT(t, real);
 
+  real->setInterfaceMethodTable(t, class_->interfaceMethodTable());
+
+  makePrimarySupers(t, real);
+
   t->m->processor->initVtable(t, real);
 
   updateClassTables(t, real, class_);
@@ -5206,6 +5470,233 @@ void postInitClass(Thread* t, GcClass* c)
   t->m->classLock->notifyAll(t->systemThread);
 }
 
+// Most static initializers do nothing but store constants into
+// static fields of their own class, and since they run exactly once,
+// handing them to the processor (which may compile them to machine
+// code first) costs more than the work they do.  Here we recognize
+// such straight-line initializers and run them directly, returning
+// false without side effects if the method does anything else.
+bool runConstantInitializer(Thread* t, GcClass* c, GcMethod* method)
+{
+  const unsigned MaxStack = 4;
+
+  PROTECT(t, c);
+  PROTECT(t, method);
+
+  GcCode* code = method->code();
+  if (code->exceptionHandlerTable()) {
+    return false;
+  }
+
+  // first pass: make sure we understand every instruction and can
+  // resolve every field without triggering class loading elsewhere
+  unsigned depth = 0;
+  bool done = false;
+  for (unsigned ip = 0; ip < code->length() and not done;) {
+    uint8_t instruction = code->body()[ip++];
+
+    switch (instruction) {
+    case aconst_null:
+    case iconst_m1:
+    case iconst_0:
+    case iconst_1:
+    case iconst_2:
+    case iconst_3:
+    case iconst_4:
+    case iconst_5:
+    case lconst_0:
+    case lconst_1:
+    case fconst_0:
+    case fconst_1:
+    case fconst_2:
+    case dconst_0:
+    case dconst_1:
+      ++depth;
+      break;
+
+    case bipush:
+      ++ip;
+      ++depth;
+      break;
+
+    case sipush:
+    case ldc2_w:
+      ip += 2;
+      ++depth;
+      break;
+
+    case ldc:
+    case ldc_w: {
+      unsigned index = instruction == ldc ? code->body()[ip++]
+                                          : codeReadInt16(t, code, ip);
+
+      GcSingleton* pool = code->pool();
+      if (singletonIsObject(t, pool, index - 1)
+          and objectClass(t, singletonObject(t, pool, index - 1))
+              != type(t, GcString::Type)) {
+        return false;
+      }
+      ++depth;
+    } break;
+
+    case putstatic: {
+      uint16_t index = codeReadInt16(t, code, ip);
+
+      // resolving a reference to another class would load it, so
+      // check the name first
+      object o = singletonObject(t, code->pool(), index - 1);
+      if (objectClass(t, o) == type(t, GcReference::Type)
+          and not byteArrayEqual(
+                  t, cast<GcReference>(t, o)->class_(), c->name())) {
+        return false;
+      }
+
+      GcField* field = resolveField(t, method, index - 1, false);
+      if (field == 0 or field->class_() != c
+          or (field->flags() & ACC_STATIC) == 0 or depth == 0) {
+        return false;
+      }
+      code = method->code();
+      --depth;
+    } break;
+
+    case return_:
+      done = true;
+      break;
+
+    default:
+      return false;
+    }
+
+    if (depth > MaxStack) {
+      return false;
+    }
+  }
+
+  if (not done) {
+    return false;
+  }
+
+  // second pass: nothing below allocates, so the raw values on our
+  // private stack need no protection from the collector
+  code = method->code();
+  uint64_t stack[MaxStack];
+  depth = 0;
+  for (unsigned ip = 0;;) {
+    uint8_t instruction = code->body()[ip++];
+
+    switch (instruction) {
+    case aconst_null:
+      stack[depth++] = 0;
+      break;
+
+    case iconst_m1:
+    case iconst_0:
+    case iconst_1:
+    case iconst_2:
+    case iconst_3:
+    case iconst_4:
+    case iconst_5:
+      stack[depth++] = static_cast<int32_t>(instruction - iconst_0);
+      break;
+
+    case lconst_0:
+    case lconst_1:
+      stack[depth++] = instruction - lconst_0;
+      break;
+
+    case fconst_0:
+    case fconst_1:
+    case fconst_2:
+      stack[depth++] = floatToBits(static_cast<float>(instruction - fconst_0));
+      break;
+
+    case dconst_0:
+    case dconst_1:
+      stack[depth++]
+          = doubleToBits(static_cast<double>(instruction - dconst_0));
+      break;
+
+    case bipush:
+      stack[depth++] = static_cast<int8_t>(code->body()[ip++]);
+      break;
+
+    case sipush:
+      stack[depth++] = codeReadInt16(t, code, ip);
+      break;
+
+    case ldc:
+    case ldc_w: {
+      unsigned index = instruction == ldc ? code->body()[ip++]
+                                          : codeReadInt16(t, code, ip);
+
+      GcSingleton* pool = code->pool();
+      if (singletonIsObject(t, pool, index - 1)) {
+        stack[depth++] = reinterpret_cast<uintptr_t>(
+            singletonObject(t, pool, index - 1));
+      } else {
+        stack[depth++] = singletonValue(t, pool, index - 1);
+      }
+    } break;
+
+    case ldc2_w: {
+      uint16_t index = codeReadInt16(t, code, ip);
+
+      uint64_t v;
+      memcpy(&v, &singletonValue(t, code->pool(), index - 1), 8);
+      stack[depth++] = v;
+    } break;
+
+    case putstatic: {
+      uint16_t index = codeReadInt16(t, code, ip);
+
+      GcField* field = cast<GcField>(
+          t, singletonObject(t, code->pool(), index - 1));
+      GcSingleton* table = c->staticTable();
+      uint64_t value = stack[--depth];
+
+      switch (field->code()) {
+      case ByteField:
+      case BooleanField:
+        fieldAtOffset<int8_t>(table, field->offset()) = value;
+        break;
+
+      case CharField:
+      case ShortField:
+        fieldAtOffset<int16_t>(table, field->offset()) = value;
+        break;
+
+      case FloatField:
+      case IntField:
+        fieldAtOffset<int32_t>(table, field->offset()) = value;
+        break;
+
+      case DoubleField:
+      case LongField:
+        fieldAtOffset<int64_t>(table, field->offset()) = value;
+        break;
+
+      case ObjectField:
+        setField(t,
+                 table,
+                 field->offset(),
+                 reinterpret_cast<object>(static_cast<uintptr_t>(value)));
+        break;
+
+      default:
+        abort(t);
+      }
+    } break;
+
+    case return_:
+      return true;
+
+    default:
+      abort(t);
+    }
+  }
+}
+
 void initClass(Thread* t, GcClass* c)
 {
   PROTECT(t, c);
@@ -5223,7 +5714,9 @@ void initClass(Thread* t, GcClass* c)
     if (initializer) {
       Thread::ClassInitStack stack(t, c);
 
-      t->m->processor->invoke(t, initializer, 0);
+      if (not runConstantInitializer(t, c, initializer)) {
+        t->m->processor->invoke(t, initializer, 0);
+      }
     }
   }
 }
@@ -5398,34 +5891,26 @@ void addFinalizer(Thread* t, object target, void (*finalize)(Thread*, object))
   t->m->finalizers = f;
 }
 
-GcMonitor* objectMonitor(Thread* t, object o, bool createNew)
+GcMonitor* objectMonitor2(Thread* t, object o, bool createNew)
 {
   assertT(t, t->state == Thread::ActiveState);
 
+  // monitors are added to the map while holding referenceLock, and
+  // only removed by finalizers while the world is stopped, so we may
+  // search for an existing monitor without the lock and only need to
+  // acquire it if we appear to come up empty:
   object m = hashMapFind(t, roots(t)->monitorMap(), o, objectHash, objectEqual);
 
-  if (m) {
-    if (DebugMonitors) {
-      fprintf(stderr, "found monitor %p for object %x\n", m, objectHash(t, o));
-    }
-
-    return cast<GcMonitor>(t, m);
-  } else if (createNew) {
+  if (m == 0) {
     PROTECT(t, o);
-    PROTECT(t, m);
-
-    {
-      ENTER(t, Thread::ExclusiveState);
 
-      m = hashMapFind(t, roots(t)->monitorMap(), o, objectHash, objectEqual);
+    ACQUIRE(t, t->m->referenceLock);
 
-      if (m) {
-        if (DebugMonitors) {
-          fprintf(
-              stderr, "found monitor %p for object %x\n", m, objectHash(t, o));
-        }
+    m = hashMapFind(t, roots(t)->monitorMap(), o, objectHash, objectEqual);
 
-        return cast<GcMonitor>(t, m);
+    if (m == 0) {
+      if (not createNew) {
+        return 0;
       }
 
       object head = makeMonitorNode(t, 0, 0);
@@ -5435,33 +5920,53 @@ GcMonitor* objectMonitor(Thread* t, object o, bool createNew)
         fprintf(stderr, "made monitor %p for object %x\n", m, objectHash(t, o));
       }
 
+      PROTECT(t, m);
+
       hashMapInsert(t, roots(t)->monitorMap(), o, m, objectHash);
 
       addFinalizer(t, o, removeMonitor);
+    } else if (DebugMonitors) {
+      fprintf(stderr, "found monitor %p for object %x\n", m, objectHash(t, o));
     }
-
-    return cast<GcMonitor>(t, m);
-  } else {
-    return 0;
+  } else if (DebugMonitors) {
+    fprintf(stderr, "found monitor %p for object %x\n", m, objectHash(t, o));
   }
+
+  unsigned index = monitorCacheIndex(o);
+  t->monitorCacheKeys[index] = o;
+  t->monitorCacheValues[index] = cast<GcMonitor>(t, m);
+
+  return cast<GcMonitor>(t, m);
 }
 
 object intern(Thread* t, object s)
 {
-  PROTECT(t, s);
-
-  ACQUIRE(t, t->m->referenceLock);
+  assertT(t, t->state == Thread::ActiveState);
 
+  // strings are added to the map while holding referenceLock, and
+  // their entries are only removed while the world is stopped (see
+  // doCollect), so, as with the monitor map, we may search for an
+  // existing string without the lock and only need to acquire it if
+  // we appear to come up empty:
   GcTriple* n
       = hashMapFindNode(t, roots(t)->stringMap(), s, stringHash, stringEqual);
 
-  if (n) {
-    return cast<GcJreference>(t, n->first())->target();
-  } else {
-    hashMapInsert(t, roots(t)->stringMap(), s, 0, stringHash);
-    addFinalizer(t, s, removeString);
-    return s;
+  if (n == 0) {
+    PROTECT(t, s);
+
+    ACQUIRE(t, t->m->referenceLock);
+
+    n = hashMapFindNode(
+        t, roots(t)->stringMap(), s, stringHash, stringEqual);
+
+    if (n == 0) {
+      hashMapInsert(t, roots(t)->stringMap(), s, 0, stringHash);
+      ++t->m->internedSinceSweep;
+      return s;
+    }
   }
+
+  return cast<GcJreference>(t, n->first())->target();
 }
 
 object clone(Thread* t, object o)
@@ -5629,15 +6134,18 @@ void printTrace(Thread* t, GcThrowable* exception)
       logTrace(errorLog(t), "\n");
     }
 
-    object trace = e->trace();
-    if (trace) {
-      for (unsigned i = 0; i < objectArrayLength(t, trace); ++i) {
-        GcTraceElement* e
-            = cast<GcTraceElement>(t, objectArrayBody(t, trace, i));
-        GcMethod* m = cast<GcMethod>(t, e->method());
+    // the trace may have been replaced by an array of
+    // StackTraceElements via Throwable.setStackTrace or
+    // Throwable.getStackTrace, in which case we skip it:
+    object o = e->trace();
+    if (o and objectClass(t, o) == type(t, GcRawTrace::Type)) {
+      GcRawTrace* trace = cast<GcRawTrace>(t, o);
+      for (unsigned i = 0; i < trace->length(); ++i) {
+        GcMethod* m = cast<GcMethod>(t, trace->method()[i]);
         const int8_t* class_ = m->class_()->name()->body().begin();
         const int8_t* method = m->name()->body().begin();
-        int line = t->m->processor->lineNumber(t, m, e->ip());
+        int line
+            = t->m->processor->lineNumber(t, m, trace->ip()->body()[i]);
 
         logTrace(errorLog(t), "  at %s.%s ", class_, method);
 
@@ -5673,26 +6181,26 @@ object makeTrace(Thread* t, Processor::StackWalker* walker)
     virtual bool visit(Processor::StackWalker* walker)
     {
       if (trace == 0) {
-        trace = makeObjectArray(t, walker->count());
-        assertT(t, trace);
+        unsigned count = walker->count();
+        trace = makeRawTrace(t, makeIntArray(t, count), count);
       }
 
-      GcTraceElement* e = makeTraceElement(t, walker->method(), walker->ip());
-      assertT(t, index < objectArrayLength(t, trace));
-      reinterpret_cast<GcArray*>(trace)->setBodyElement(t, index, e);
+      assertT(t, index < trace->length());
+      trace->setMethodElement(t, index, walker->method());
+      trace->ip()->body()[index] = walker->ip();
       ++index;
       return true;
     }
 
     Thread* t;
-    object trace;
+    GcRawTrace* trace;
     unsigned index;
     Thread::SingleProtector protector;
   } v(t);
 
   walker->walk(&v);
 
-  return v.trace ? v.trace : makeObjectArray(t, 0);
+  return v.trace ? v.trace : makeRawTrace(t, 0, 0);
 }
 
 object makeTrace(Thread* t, Thread* target)
@@ -5715,7 +6223,7 @@ object makeTrace(Thread* t, Thread* target)
 
   t->m->processor->walkStack(target, &v);
 
-  return v.trace ? v.trace : makeObjectArray(t, 0);
+  return v.trace ? v.trace : makeRawTrace(t, 0, 0);
 }
 
 void runFinalizeThread(Thread* t)
@@ -925,6 +925,20 @@ class MySystem : public System {
            + (static_cast<int64_t>(tv.tv_usec) / 1000);
   }
 
+  virtual int64_t nowMicroseconds()
+  {
+#ifdef CLOCK_MONOTONIC
+    timespec ts = {0, 0};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (static_cast<int64_t>(ts.tv_sec) * 1000000)
+           + (static_cast<int64_t>(ts.tv_nsec) / 1000);
+#else
+    timeval tv = {0, 0};
+    gettimeofday(&tv, 0);
+    return (static_cast<int64_t>(tv.tv_sec) * 1000000) + tv.tv_usec;
+#endif
+  }
+
   virtual void yield()
   {
     sched_yield();
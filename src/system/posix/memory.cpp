@@ -59,5 +59,10 @@ void Memory::free(util::Slice<uint8_t> pages)
   munmap(const_cast<uint8_t*>(pages.begin()), pages.count);
 }
 
+void Memory::decommit(util::Slice<uint8_t> pages)
+{
+  madvise(const_cast<uint8_t*>(pages.begin()), pages.count, MADV_DONTNEED);
+}
+
 }  // namespace system
 }  // namespace avian
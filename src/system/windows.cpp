@@ -988,6 +988,17 @@ class MySystem : public System {
              | time.dwLowDateTime) / 10000) - 11644473600000LL;
   }
 
+  virtual int64_t nowMicroseconds()
+  {
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return ((counter.QuadPart / frequency.QuadPart) * 1000000)
+           + ((counter.QuadPart % frequency.QuadPart) * 1000000
+              / frequency.QuadPart);
+  }
+
   virtual void yield()
   {
 #if !defined(WINAPI_FAMILY) || WINAPI_FAMILY_PARTITION(WINAPI_PARTITION_DESKTOP)
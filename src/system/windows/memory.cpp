@@ -51,5 +51,12 @@ void Memory::free(util::Slice<uint8_t> pages)
   ASSERT(r);
 }
 
+void Memory::decommit(util::Slice<uint8_t> pages)
+{
+  void* r = VirtualAlloc(pages.begin(), pages.count, MEM_RESET, PAGE_READWRITE);
+  (void) r;
+  ASSERT(r);
+}
+
 }  // namespace system
 }  // namespace avian
@@ -1,9 +1,11 @@
 THUNK(tryInitClass)
 THUNK(findInterfaceMethodFromInstance)
 THUNK(findInterfaceMethodFromInstanceAndReference)
+THUNK(findInterfaceMethodFromCache)
 THUNK(findSpecialMethodFromReference)
 THUNK(findStaticMethodFromReference)
 THUNK(findVirtualMethodFromReference)
+THUNK(findVirtualMethodFromCache)
 THUNK(getMethodAddress)
 THUNK(compareDoublesG)
 THUNK(compareDoublesL)
@@ -67,7 +69,9 @@ THUNK(instanceOf64)
 THUNK(instanceOfFromReference)
 THUNK(makeNewGeneral64)
 THUNK(makeNew64)
+THUNK(makeNewInitialized64)
 THUNK(makeNewFromReference)
+THUNK(identityHash64)
 THUNK(setObject)
 THUNK(getJClass64)
 THUNK(getJClassFromReference)
@@ -387,6 +387,8 @@ void hashMapResize(Thread* t,
     }
   }
 
+  storeStoreMemoryBarrier();
+
   map->setArray(t, newArray);
 }
 
@@ -442,12 +444,20 @@ void hashMapInsert(Thread* t,
   unsigned index = h & (array->length() - 1);
 
   n->setThird(t, array->body()[index]);
+
+  // some tables (e.g. the monitor map) are searched without holding
+  // the lock used to serialize insertions, so make sure the node is
+  // fully initialized before publishing it:
+  storeStoreMemoryBarrier();
+
   array->setBodyElement(t, index, n);
 
   if (map->size() <= array->length() / 3) {
-    // this might happen if nodes were removed during GC in which case
-    // we weren't able to resize at the time
-    hashMapResize(t, map, hash, array->length() / 2);
+    // this might happen if nodes were removed during GC (e.g. by
+    // hashMapSweep) in which case we weren't able to resize at the
+    // time, and since many may have been removed at once, shrink
+    // straight to the size of what remains rather than halving
+    hashMapResize(t, map, hash, map->size());
   }
 }
 
@@ -508,6 +518,26 @@ object hashMapRemove(Thread* t,
   return o;
 }
 
+void hashMapSweep(Thread* t, GcHashMap* map)
+{
+  assertT(t, objectClass(t, map) == type(t, GcWeakHashMap::Type));
+
+  GcArray* array = map->array();
+  if (array) {
+    for (unsigned i = 0; i < array->length(); ++i) {
+      GcTriple* p = 0;
+      for (GcTriple* n = cast<GcTriple>(t, array->body()[i]); n;) {
+        if (cast<GcJreference>(t, n->first())->target() == 0) {
+          n = cast<GcTriple>(t, hashMapRemoveNode(t, map, i, p, n)->third());
+        } else {
+          p = n;
+          n = cast<GcTriple>(t, n->third());
+        }
+      }
+    }
+  }
+}
+
 void listAppend(Thread* t, GcList* list, object value)
 {
   PROTECT(t, list);
@@ -0,0 +1,145 @@
+public class Allocation {
+  private static void expect(boolean v) {
+    if (! v) throw new RuntimeException();
+  }
+
+  private static class Point {
+    public int x;
+    public long y;
+    public Object z;
+  }
+
+  private static class Pair {
+    public Object first;
+    public Object second;
+  }
+
+  private static Point point(int x) {
+    Point p = new Point();
+    expect(p.x == 0);
+    expect(p.y == 0);
+    expect(p.z == null);
+    p.x = x;
+    return p;
+  }
+
+  private static void objects() {
+    // allocate enough to exhaust several thread-local heaps, so both
+    // the inline bump and the refill in the slow path are exercised:
+    Pair list = null;
+    for (int i = 0; i < 1000000; ++i) {
+      Pair p = new Pair();
+      expect(p.getClass() == Pair.class);
+      expect(p.first == null && p.second == null);
+      p.first = point(i);
+      if (i % 1000 == 0) {
+        p.second = list;
+        list = p;
+      }
+    }
+
+    int count = 0;
+    for (Pair p = list; p != null; p = (Pair) p.second) {
+      expect(((Point) p.first).x % 1000 == 0);
+      ++count;
+    }
+    expect(count == 1000);
+  }
+
+  private static void arrays(int length) {
+    boolean[] z = new boolean[length];
+    expect(z.length == length);
+    expect(z.getClass() == boolean[].class);
+    byte[] b = new byte[length];
+    expect(b.length == length);
+    expect(b.getClass() == byte[].class);
+    char[] c = new char[length];
+    expect(c.length == length);
+    expect(c.getClass() == char[].class);
+    short[] s = new short[length];
+    expect(s.length == length);
+    expect(s.getClass() == short[].class);
+    int[] i = new int[length];
+    expect(i.length == length);
+    expect(i.getClass() == int[].class);
+    float[] f = new float[length];
+    expect(f.length == length);
+    expect(f.getClass() == float[].class);
+    long[] j = new long[length];
+    expect(j.length == length);
+    expect(j.getClass() == long[].class);
+    double[] d = new double[length];
+    expect(d.length == length);
+    expect(d.getClass() == double[].class);
+
+    for (int k = 0; k < length; ++k) {
+      expect(! z[k]);
+      expect(b[k] == 0);
+      expect(c[k] == 0);
+      expect(s[k] == 0);
+      expect(i[k] == 0);
+      expect(f[k] == 0);
+      expect(j[k] == 0);
+      expect(d[k] == 0);
+    }
+
+    if (length > 0) {
+      b[length - 1] = 1;
+      j[length - 1] = -1;
+      expect(b[length - 1] == 1);
+      expect(j[length - 1] == -1);
+    }
+  }
+
+  private static int[] outsideTry(int length) {
+    return new int[length];
+  }
+
+  private static int lineOf(Throwable t, String method) {
+    for (StackTraceElement e: t.getStackTrace()) {
+      if (e.getMethodName().equals(method)) {
+        return e.getLineNumber();
+      }
+    }
+    throw new RuntimeException();
+  }
+
+  private static void negativeLength(int length) {
+    Throwable here = null;
+    try {
+      here = new Throwable(); long[] array = new long[length];
+      expect(false);
+    } catch (NegativeArraySizeException e) {
+      // the exception is thrown from the out-of-line slow path, which
+      // must still be covered by this handler and map to this line:
+      expect(lineOf(e, "negativeLength") == lineOf(here, "negativeLength"));
+    }
+
+    try {
+      outsideTry(length);
+      expect(false);
+    } catch (NegativeArraySizeException e) { }
+  }
+
+  public static void main(String[] args) {
+    objects();
+
+    for (int i = 0; i < 100; ++i) {
+      arrays(i);
+    }
+
+    // around the largest length allocated inline:
+    arrays(65535);
+    arrays(65536);
+
+    // large enough to be allocated outside the thread-local heap:
+    arrays(1024 * 1024);
+
+    for (int i = 0; i < 10000; ++i) {
+      arrays(i % 37);
+    }
+
+    negativeLength(-1);
+    negativeLength(Integer.MIN_VALUE);
+  }
+}
@@ -40,6 +40,77 @@ public class ArraysTest {
     }
   }
 
+  private static long sum(int[] array) {
+    long sum = 0;
+    for (int i = 0; i < array.length; ++i) {
+      sum += array[i];
+    }
+    return sum;
+  }
+
+  private static void reverse(long[] array) {
+    for (int i = 0; i < array.length; ++i) {
+      array[i] = array[array.length - i - 1] * 2;
+    }
+  }
+
+  private static int sumShifted(int[] array) {
+    int sum = 0;
+    for (int i = 0; i < array.length; ++i) {
+      sum += array[i + 1];
+    }
+    return sum;
+  }
+
+  private static int sumSwapped(int[] array, int[] other) {
+    int sum = 0;
+    for (int i = 0; i < array.length; ++i) {
+      sum += array[i];
+      array = other;
+    }
+    return sum;
+  }
+
+  public static void testCountedLoops() {
+    int[] ints = new int[] { 1, 2, 3, 4 };
+    expect(sum(ints) == 10);
+    expect(sum(new int[0]) == 0);
+
+    long[] longs = new long[] { 1, 2, 3 };
+    reverse(longs);
+    expect(longs[0] == 6 && longs[1] == 4 && longs[2] == 12);
+
+    { Exception exception = null;
+      try {
+        sum(null);
+      } catch (NullPointerException e) {
+        exception = e;
+      }
+
+      expect(exception != null);
+    }
+
+    { Exception exception = null;
+      try {
+        sumShifted(ints);
+      } catch (ArrayIndexOutOfBoundsException e) {
+        exception = e;
+      }
+
+      expect(exception != null);
+    }
+
+    { Exception exception = null;
+      try {
+        sumSwapped(ints, new int[1]);
+      } catch (ArrayIndexOutOfBoundsException e) {
+        exception = e;
+      }
+
+      expect(exception != null);
+    }
+  }
+
   public static void main(String[] args) {
     { int[] array = new int[0];
       Exception exception = null;
@@ -170,5 +241,7 @@ public class ArraysTest {
     }
 
     testSort();
+
+    testCountedLoops();
   }
 }
@@ -0,0 +1,50 @@
+public class Boxing {
+  private static void expect(boolean v) {
+    if (! v) throw new RuntimeException();
+  }
+
+  private static Object box(int i) {
+    return i;
+  }
+
+  private static void cached() {
+    // boxing conversions of small values must yield identical objects:
+    for (int i = -128; i <= 127; ++i) {
+      expect(Integer.valueOf(i) == Integer.valueOf(i));
+      expect(Integer.valueOf(i).intValue() == i);
+      expect(box(i) == box(i));
+      expect(Long.valueOf(i) == Long.valueOf(i));
+      expect(Long.valueOf(i).longValue() == i);
+      expect(Short.valueOf((short) i) == Short.valueOf((short) i));
+      expect(Short.valueOf((short) i).shortValue() == i);
+      expect(Byte.valueOf((byte) i) == Byte.valueOf((byte) i));
+      expect(Byte.valueOf((byte) i).byteValue() == i);
+    }
+
+    for (char c = 0; c <= 127; ++c) {
+      expect(Character.valueOf(c) == Character.valueOf(c));
+      expect(Character.valueOf(c).charValue() == c);
+    }
+  }
+
+  private static void uncached() {
+    // values outside the cache still box and unbox correctly:
+    int[] values = { -129, 128, 1000, Integer.MIN_VALUE, Integer.MAX_VALUE };
+    for (int i = 0; i < values.length; ++i) {
+      expect(Integer.valueOf(values[i]).intValue() == values[i]);
+      expect(Integer.valueOf(values[i]).equals(Integer.valueOf(values[i])));
+      expect(Long.valueOf(values[i]).longValue() == values[i]);
+    }
+
+    expect(Long.valueOf(Long.MIN_VALUE).longValue() == Long.MIN_VALUE);
+    expect(Short.valueOf((short) 300).shortValue() == 300);
+    expect(Short.valueOf(Short.MIN_VALUE).shortValue() == Short.MIN_VALUE);
+    expect(Character.valueOf('\u00e9').charValue() == '\u00e9');
+    expect(Character.valueOf('\uffff').charValue() == '\uffff');
+  }
+
+  public static void main(String[] args) {
+    cached();
+    uncached();
+  }
+}
@@ -0,0 +1,54 @@
+import avian.Machine;
+
+public class GcStatistics {
+  private static void expect(boolean v) {
+    if (! v) throw new RuntimeException();
+  }
+
+  private static void percentiles() {
+    long median = Machine.gcPauseTime(50);
+    long p99 = Machine.gcPauseTime(99);
+    long max = Machine.gcPauseTime(100);
+
+    expect(Machine.gcPauseTime(0) >= 0);
+    expect(Machine.gcPauseTime(0) <= median);
+    expect(median <= p99);
+    expect(p99 <= max);
+  }
+
+  public static void main(String[] args) {
+    long count = Machine.gcCount();
+    expect(count >= 0);
+    percentiles();
+
+    for (int i = 0; i < 10; ++i) {
+      System.gc();
+    }
+
+    expect(Machine.gcCount() >= count + 10);
+    percentiles();
+
+    // pauses are in microseconds, so ten full collections can't all
+    // round down to nothing:
+    expect(Machine.gcPauseTime(100) > 0);
+
+    // generate enough garbage for some minor collections too:
+    count = Machine.gcCount();
+    Object[] keep = new Object[16];
+    for (int i = 0; i < 1000000; ++i) {
+      keep[i % keep.length] = new int[16];
+    }
+    expect(Machine.gcCount() > count);
+    percentiles();
+
+    try {
+      Machine.gcPauseTime(-1);
+      expect(false);
+    } catch (IllegalArgumentException e) { }
+
+    try {
+      Machine.gcPauseTime(101);
+      expect(false);
+    } catch (IllegalArgumentException e) { }
+  }
+}
@@ -0,0 +1,85 @@
+public class HandlerRanges {
+  private static void expect(boolean v) {
+    if (! v) throw new RuntimeException();
+  }
+
+  private static class MyException extends RuntimeException { }
+
+  private static int thrower(int x) {
+    if (x < 0) {
+      throw new MyException();
+    }
+    return x;
+  }
+
+  // calls thrower before, inside, and after its only try block, so the
+  // return addresses of the first and last calls lie below the lowest
+  // and above the highest offset covered by any handler:
+  private static int around(int before, int inside, int after) {
+    int result = thrower(before);
+
+    try {
+      result += thrower(inside);
+    } catch (MyException e) {
+      result += 1000;
+    }
+
+    return result + thrower(after);
+  }
+
+  // two try blocks with a gap between them, where the gap is inside
+  // [lowest, highest] but not covered by either handler:
+  private static int gap(int first, int between, int second) {
+    int result = 0;
+
+    try {
+      result += thrower(first);
+    } catch (MyException e) {
+      result += 100;
+    }
+
+    result += thrower(between);
+
+    try {
+      result += thrower(second);
+    } catch (MyException e) {
+      result += 200;
+    }
+
+    return result;
+  }
+
+  private static int caught(int before, int inside, int after) {
+    try {
+      return around(before, inside, after);
+    } catch (MyException e) {
+      return -1;
+    }
+  }
+
+  private static int caughtGap(int first, int between, int second) {
+    try {
+      return gap(first, between, second);
+    } catch (MyException e) {
+      return -1;
+    }
+  }
+
+  public static void main(String[] args) {
+    for (int i = 0; i < 1000; ++i) {
+      expect(caught(1, 2, 3) == 6);
+      expect(caught(1, -1, 3) == 1004);
+
+      // thrown below and above the handler range, so the exception
+      // must pass through around() to its caller:
+      expect(caught(-1, 2, 3) == -1);
+      expect(caught(1, 2, -1) == -1);
+      expect(caught(-1, -1, -1) == -1);
+
+      expect(caughtGap(1, 2, 3) == 6);
+      expect(caughtGap(-1, 2, -1) == 302);
+      expect(caughtGap(1, -1, 3) == -1);
+      expect(caughtGap(-1, -1, 3) == -1);
+    }
+  }
+}
@@ -1,4 +1,31 @@
 public class Initializers {
+  private static void expect(boolean v) {
+    if (! v) throw new RuntimeException();
+  }
+
+  private static class Constants {
+    public static int i = 42;
+    public static int small = -1;
+    public static long j = 0x123456789ABCDEFL;
+    public static double d = 3.5;
+    public static float f = 2.25f;
+    public static String s = "foo";
+    public static Object o = null;
+  }
+
+  private static class Target {
+    public static int value;
+  }
+
+  private static class NotConstant {
+    public static int i = 7;
+    public static Object o = new Object();
+
+    static {
+      Target.value = 9;
+    }
+  }
+
   private static class Static2 {
     public static String foo = "Static2.foo";
 
@@ -20,5 +47,17 @@ public class Initializers {
     Object x = new Object();
     System.out.println(Static1.foo);
     x.toString();
+
+    expect(Constants.i == 42);
+    expect(Constants.small == -1);
+    expect(Constants.j == 0x123456789ABCDEFL);
+    expect(Constants.d == 3.5);
+    expect(Constants.f == 2.25f);
+    expect(Constants.s.equals("foo"));
+    expect(Constants.o == null);
+
+    expect(NotConstant.i == 7);
+    expect(NotConstant.o != null);
+    expect(Target.value == 9);
   }
 }
@@ -0,0 +1,245 @@
+public class InlineCaches {
+  private static void expect(boolean v) {
+    if (! v) throw new RuntimeException();
+  }
+
+  private static class A {
+    public int f() { return 1; }
+    public long add(long x, int y, double z) { return x + y + (long) z; }
+  }
+
+  private static class B extends A {
+    public int f() { return 2; }
+  }
+
+  private static class C extends A {
+    public int f() { return 3; }
+    public long add(long x, int y, double z) { return -1; }
+  }
+
+  // inherits both methods, and so shares A's vtable:
+  private static class D extends A { }
+
+  private static class E extends B {
+    public int f() { return 5; }
+  }
+
+  private static class F extends C {
+    public int f() { return 6; }
+  }
+
+  private static interface Shape {
+    public int sides();
+    public String name();
+  }
+
+  private static class Triangle implements Shape {
+    public int sides() { return 3; }
+    public String name() { return "triangle"; }
+  }
+
+  private static class Square implements Shape {
+    public int sides() { return 4; }
+    public String name() { return "square"; }
+  }
+
+  private static class Pentagon implements Shape {
+    public int sides() { return 5; }
+    public String name() { return "pentagon"; }
+  }
+
+  private static class Hexagon extends Pentagon {
+    public int sides() { return 6; }
+  }
+
+  private static abstract class Base implements Shape {
+    public String name() { return "base"; }
+  }
+
+  private static class Heptagon extends Base {
+    public int sides() { return 7; }
+  }
+
+  private static class Octagon extends Base {
+    public int sides() { return 8; }
+  }
+
+  private static class Hashed {
+    public int hashCode() { return 42; }
+  }
+
+  private static int virtualSite(A a) {
+    return a.f();
+  }
+
+  private static long virtualArguments(A a, long x) {
+    return a.add(x, 2, 3.0);
+  }
+
+  private static int interfaceSite(Shape s) {
+    return s.sides();
+  }
+
+  private static String interfaceNames(Shape s) {
+    return s.name();
+  }
+
+  private static int nativeSite(Object o) {
+    return o.hashCode();
+  }
+
+  private static int expected(A a) {
+    if (a instanceof F) return 6;
+    if (a instanceof E) return 5;
+    if (a instanceof C) return 3;
+    if (a instanceof B) return 2;
+    return 1;
+  }
+
+  private static void virtualStates() {
+    A a = new A();
+    A b = new B();
+    A c = new C();
+    A[] all = { new D(), a, b, c, new E(), new F() };
+
+    // the first call binds the empty site to A:
+    expect(virtualSite(a) == 1);
+
+    // monomorphic:
+    for (int i = 0; i < 1000; ++i) {
+      expect(virtualSite(a) == 1);
+    }
+
+    // polymorphic, with A still bound:
+    for (int i = 0; i < 1000; ++i) {
+      expect(virtualSite(a) == 1);
+      expect(virtualSite(b) == 2);
+      expect(virtualSite(c) == 3);
+    }
+
+    // megamorphic:
+    for (int i = 0; i < 1000; ++i) {
+      for (int j = 0; j < all.length; ++j) {
+        expect(virtualSite(all[j]) == expected(all[j]));
+      }
+    }
+
+    // arguments and a long result pass through both paths the same:
+    for (int i = 0; i < 1000; ++i) {
+      expect(virtualArguments(a, i) == i + 5);
+      expect(virtualArguments(all[0], i) == i + 5);
+      expect(virtualArguments(c, i) == -1);
+    }
+  }
+
+  private static void interfaceStates() {
+    Shape[] all = {
+      new Triangle(), new Square(), new Pentagon(), new Hexagon(),
+      new Heptagon(), new Octagon()
+    };
+
+    expect(interfaceSite(all[1]) == 4);
+
+    for (int i = 0; i < 1000; ++i) {
+      expect(interfaceSite(all[1]) == 4);
+    }
+
+    for (int i = 0; i < 1000; ++i) {
+      expect(interfaceSite(all[1]) == 4);
+      expect(interfaceSite(all[0]) == 3);
+    }
+
+    for (int i = 0; i < 1000; ++i) {
+      for (int j = 0; j < all.length; ++j) {
+        expect(interfaceSite(all[j]) == j + 3);
+      }
+    }
+
+    // bound to a class whose implementation is inherited:
+    for (int i = 0; i < 1000; ++i) {
+      expect(interfaceNames(all[3]).equals("pentagon"));
+      expect(interfaceNames(all[5]).equals("base"));
+      expect(interfaceNames(all[0]).equals("triangle"));
+    }
+  }
+
+  private static void nativeTargets() {
+    // the first receiver's implementation is native, so the site is
+    // never bound and every call goes through the stub:
+    Object o = new Object();
+    int h = nativeSite(o);
+    for (int i = 0; i < 1000; ++i) {
+      expect(nativeSite(o) == h);
+      expect(nativeSite(new Hashed()) == 42);
+    }
+  }
+
+  private static int nullVirtualSite(A a) {
+    return a.f();
+  }
+
+  private static int nullInterfaceSite(Shape s) {
+    return s.sides();
+  }
+
+  private static void nullReceivers() {
+    // first while the sites are empty, then once they're bound:
+    for (int i = 0; i < 3; ++i) {
+      try {
+        nullVirtualSite(null);
+        expect(false);
+      } catch (NullPointerException e) { }
+
+      try {
+        nullInterfaceSite(null);
+        expect(false);
+      } catch (NullPointerException e) { }
+
+      expect(nullVirtualSite(new B()) == 2);
+      expect(nullInterfaceSite(new Square()) == 4);
+    }
+  }
+
+  private static int racedSite(A a) {
+    return a.f();
+  }
+
+  private static void concurrentBinding() throws Exception {
+    // several threads miss on the same empty site at once, each with
+    // its own receiver class, so only one of them may bind it:
+    final A[] all = { new A(), new B(), new C(), new D(), new E(), new F() };
+    Thread[] threads = new Thread[all.length];
+    final boolean[] failed = new boolean[1];
+
+    for (int i = 0; i < threads.length; ++i) {
+      final A a = all[i];
+      threads[i] = new Thread() {
+          public void run() {
+            for (int j = 0; j < 10000; ++j) {
+              if (racedSite(a) != expected(a)) {
+                failed[0] = true;
+              }
+            }
+          }
+        };
+    }
+
+    for (int i = 0; i < threads.length; ++i) {
+      threads[i].start();
+    }
+
+    for (int i = 0; i < threads.length; ++i) {
+      threads[i].join();
+    }
+
+    expect(! failed[0]);
+  }
+
+  public static void main(String[] args) throws Exception {
+    virtualStates();
+    interfaceStates();
+    nativeTargets();
+    nullReceivers();
+    concurrentBinding();
+  }
+}
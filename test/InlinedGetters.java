@@ -0,0 +1,123 @@
+public class InlinedGetters {
+  private static void expect(boolean v) {
+    if (! v) throw new RuntimeException();
+  }
+
+  private static class Fields {
+    private boolean z = true;
+    private byte b = -2;
+    private char c = 'c';
+    private short s = -3;
+    private int i = 42;
+    private float f = 4.5f;
+    private long j = 0x123456789ABCDEFL;
+    private double d = 8.25;
+    private Object o = "o";
+
+    private boolean z() { return z; }
+    private byte b() { return b; }
+    private char c() { return c; }
+    private short s() { return s; }
+    private int i() { return i; }
+    private float f() { return f; }
+    private long j() { return j; }
+    private double d() { return d; }
+    private Object o() { return o; }
+  }
+
+  private static final class Final {
+    private long value = -5L;
+
+    public long value() { return value; }
+  }
+
+  private static class Uninitialized {
+    private static int value = InlinedGetters.initialize();
+
+    private static int value() { return value; }
+  }
+
+  private static boolean initialized;
+
+  private static int initialize() {
+    initialized = true;
+    return 7;
+  }
+
+  private static int getOutsideTry(Fields fields) {
+    return fields.i();
+  }
+
+  private static long getFinalOutsideTry(Final f) {
+    return f.value();
+  }
+
+  public static void main(String[] args) {
+    Fields fields = new Fields();
+    expect(fields.z());
+    expect(fields.b() == -2);
+    expect(fields.c() == 'c');
+    expect(fields.s() == -3);
+    expect(fields.i() == 42);
+    expect(fields.f() == 4.5f);
+    expect(fields.j() == 0x123456789ABCDEFL);
+    expect(fields.d() == 8.25);
+    expect(fields.o() == "o");
+
+    Final f = new Final();
+    expect(f.value() == -5L);
+
+    expect(! initialized);
+    expect(Uninitialized.value() == 7);
+    expect(initialized);
+    expect(Uninitialized.value() == 7);
+
+    Fields nullFields = null;
+    try {
+      nullFields.i();
+      throw new RuntimeException();
+    } catch (NullPointerException e) {
+      // cool
+    }
+
+    try {
+      nullFields.j();
+      throw new RuntimeException();
+    } catch (NullPointerException e) {
+      // cool
+    }
+
+    try {
+      nullFields.d();
+      throw new RuntimeException();
+    } catch (NullPointerException e) {
+      // cool
+    }
+
+    try {
+      getOutsideTry(null);
+      throw new RuntimeException();
+    } catch (NullPointerException e) {
+      // cool
+    }
+
+    Final nullFinal = null;
+    try {
+      nullFinal.value();
+      throw new RuntimeException();
+    } catch (NullPointerException e) {
+      // cool
+    }
+
+    try {
+      getFinalOutsideTry(null);
+      throw new RuntimeException();
+    } catch (NullPointerException e) {
+      // cool
+    }
+
+    // the getters must still work after the exceptions above
+    expect(getOutsideTry(fields) == 42);
+    expect(getFinalOutsideTry(f) == -5L);
+  }
+}
@@ -0,0 +1,177 @@
+public class InterfaceDispatch {
+  private static void expect(boolean v) {
+    if (! v) throw new RuntimeException();
+  }
+
+  // more selectors than there are interface method table slots, so
+  // some of them must share a slot:
+  private interface Wide {
+    int m00();
+    int m01();
+    int m02();
+    int m03();
+    int m04();
+    int m05();
+    int m06();
+    int m07();
+    int m08();
+    int m09();
+    int m10();
+    int m11();
+    int m12();
+    int m13();
+    int m14();
+    int m15();
+    int m16();
+    int m17();
+    int m18();
+    int m19();
+    int m20();
+    int m21();
+    int m22();
+    int m23();
+    int m24();
+    int m25();
+    int m26();
+    int m27();
+    int m28();
+    int m29();
+    int m30();
+    int m31();
+    int m32();
+    int m33();
+    int m34();
+    int m35();
+    int m36();
+    int m37();
+    int m38();
+    int m39();
+  }
+
+  private static class WideImpl implements Wide {
+    public int m00() { return 0; }
+    public int m01() { return 1; }
+    public int m02() { return 2; }
+    public int m03() { return 3; }
+    public int m04() { return 4; }
+    public int m05() { return 5; }
+    public int m06() { return 6; }
+    public int m07() { return 7; }
+    public int m08() { return 8; }
+    public int m09() { return 9; }
+    public int m10() { return 10; }
+    public int m11() { return 11; }
+    public int m12() { return 12; }
+    public int m13() { return 13; }
+    public int m14() { return 14; }
+    public int m15() { return 15; }
+    public int m16() { return 16; }
+    public int m17() { return 17; }
+    public int m18() { return 18; }
+    public int m19() { return 19; }
+    public int m20() { return 20; }
+    public int m21() { return 21; }
+    public int m22() { return 22; }
+    public int m23() { return 23; }
+    public int m24() { return 24; }
+    public int m25() { return 25; }
+    public int m26() { return 26; }
+    public int m27() { return 27; }
+    public int m28() { return 28; }
+    public int m29() { return 29; }
+    public int m30() { return 30; }
+    public int m31() { return 31; }
+    public int m32() { return 32; }
+    public int m33() { return 33; }
+    public int m34() { return 34; }
+    public int m35() { return 35; }
+    public int m36() { return 36; }
+    public int m37() { return 37; }
+    public int m38() { return 38; }
+    public int m39() { return 39; }
+  }
+
+  // adds no methods, so it shares WideImpl's tables:
+  private static class WideSub extends WideImpl { }
+
+  // overrides some methods, so it gets tables of its own:
+  private static class WideOverride extends WideImpl {
+    public int m07() { return 107; }
+    public int m31() { return 131; }
+  }
+
+  private static int callAll(Wide w) {
+    return w.m00() + w.m01() + w.m02() + w.m03() + w.m04() + w.m05()
+      + w.m06() + w.m07() + w.m08() + w.m09() + w.m10() + w.m11()
+      + w.m12() + w.m13() + w.m14() + w.m15() + w.m16() + w.m17()
+      + w.m18() + w.m19() + w.m20() + w.m21() + w.m22() + w.m23()
+      + w.m24() + w.m25() + w.m26() + w.m27() + w.m28() + w.m29()
+      + w.m30() + w.m31() + w.m32() + w.m33() + w.m34() + w.m35()
+      + w.m36() + w.m37() + w.m38() + w.m39();
+  }
+
+  // abxa and acxa have the same length and agree at every position
+  // the slot hash looks at, so they always collide, and the slot is
+  // left empty in any class implementing both:
+  private interface Conflict {
+    int abxa();
+    int acxa();
+  }
+
+  private static class ConflictImpl implements Conflict {
+    public int abxa() { return 1; }
+    public int acxa() { return 2; }
+  }
+
+  // a class implementing just one of them has the slot to itself:
+  private interface Half {
+    int acxa();
+  }
+
+  private static class HalfImpl implements Half {
+    public int abxa() { return 3; }
+    public int acxa() { return 4; }
+  }
+
+  private interface Arguments {
+    long combine(long a, int b, Object c);
+  }
+
+  private static class ArgumentsImpl implements Arguments {
+    public long combine(long a, int b, Object c) {
+      return a * b + (c == null ? 0 : c.hashCode());
+    }
+  }
+
+  private static int callConflict(Conflict c) {
+    return (c.abxa() * 10) + c.acxa();
+  }
+
+  private static int callHalf(Half h) {
+    return h.acxa();
+  }
+
+  private static long callArguments(Arguments a, long x, int y) {
+    return a.combine(x, y, null);
+  }
+
+  public static void main(String[] args) {
+    Wide[] wides = { new WideImpl(), new WideSub(), new WideOverride() };
+    int[] sums = { 780, 780, 980 };
+
+    for (int i = 0; i < 1000; ++i) {
+      for (int j = 0; j < wides.length; ++j) {
+        expect(callAll(wides[j]) == sums[j]);
+      }
+
+      expect(callConflict(new ConflictImpl()) == 12);
+      expect(callHalf(new HalfImpl()) == 4);
+      expect(callArguments(new ArgumentsImpl(), 1L << 40, i) == (1L << 40) * i);
+    }
+
+    try {
+      callHalf(null);
+      expect(false);
+    } catch (NullPointerException e) { }
+  }
+}
@@ -0,0 +1,201 @@
+public class QuickInstructions {
+  private static void expect(boolean v) {
+    if (! v) throw new RuntimeException();
+  }
+
+  private static int staticInt = 1;
+  private static float staticFloat = 2.5f;
+  private static long staticLong = 1L << 40;
+  private static double staticDouble = 3.25;
+  private static Object staticObject = "static";
+  private static short staticShort = 7;
+  private static volatile int staticVolatile = 8;
+
+  private static class Fields {
+    public int i;
+    public float f;
+    public long j;
+    public double d;
+    public Object o;
+    public byte b;
+    public char c;
+    public volatile long v;
+  }
+
+  private static class Other {
+    public static int count = 42;
+  }
+
+  private static class Base {
+    public int get(int x) { return x; }
+    public long mix(long a, double b, Object c, int d) {
+      return a + (long) b + d + (c == null ? 0 : 1);
+    }
+  }
+
+  private static class Derived extends Base {
+    public int get(int x) { return x * 2; }
+  }
+
+  private static class MoreDerived extends Derived {
+    public long mix(long a, double b, Object c, int d) { return -a; }
+  }
+
+  private static class Initializing {
+    public static int value = 5;
+    public static int copy;
+
+    static {
+      // runs before the class is marked initialized, so these are not
+      // quickened yet:
+      for (int i = 0; i < 3; ++i) {
+        copy += value;
+      }
+    }
+
+    public static int twice() {
+      return value + value;
+    }
+  }
+
+  private static void fields(Fields x, int n) {
+    x.i = n;
+    x.f = n + 0.5f;
+    x.j = ((long) n) << 33;
+    x.d = n + 0.25;
+    x.o = x;
+    x.b = (byte) n;
+    x.c = (char) n;
+    x.v = n;
+
+    expect(x.i == n);
+    expect(x.f == n + 0.5f);
+    expect(x.j == ((long) n) << 33);
+    expect(x.d == n + 0.25);
+    expect(x.o == x);
+    expect(x.b == (byte) n);
+    expect(x.c == (char) n);
+    expect(x.v == n);
+  }
+
+  // reads the same fields as fields(), so shares their quick operands:
+  private static long sum(Fields x) {
+    return x.i + (long) x.f + x.j + (long) x.d + x.b + x.c + x.v;
+  }
+
+  private static void statics() {
+    expect(staticInt == 1);
+    expect(staticFloat == 2.5f);
+    expect(staticLong == 1L << 40);
+    expect(staticDouble == 3.25);
+    expect(staticObject.equals("static"));
+    expect(staticShort == 7);
+    expect(staticVolatile == 8);
+    // another class's static, which is never quickened:
+    expect(Other.count == 42);
+    expect(Initializing.copy == 15);
+    expect(Initializing.twice() == 10);
+  }
+
+  private static int call(Base b, int x) {
+    return b.get(x);
+  }
+
+  private static long callMix(Base b, long a) {
+    return b.mix(a, 2.0, b, 3);
+  }
+
+  private static void calls() {
+    Base[] all = { new Base(), new Derived(), new MoreDerived() };
+
+    for (int i = 0; i < 1000; ++i) {
+      // the same quickened site with receivers of several classes:
+      expect(call(all[0], i) == i);
+      expect(call(all[1], i) == i * 2);
+      expect(call(all[2], i) == i * 2);
+
+      // a footprint of several words, to find the receiver below them:
+      expect(callMix(all[0], i) == i + 6);
+      expect(callMix(all[1], i) == i + 6);
+      expect(callMix(all[2], i) == -i);
+    }
+  }
+
+  private static void nulls() {
+    Fields x = null;
+    for (int i = 0; i < 3; ++i) {
+      // run each instruction once with a receiver, so that later passes
+      // use the quick forms:
+      Fields y = (i == 0) ? new Fields() : x;
+
+      try {
+        y.i = 1;
+        expect(i == 0);
+      } catch (NullPointerException e) {
+        expect(i > 0);
+      }
+
+      try {
+        expect(y.j == 0 || y.j == 1);
+        expect(i == 0);
+      } catch (NullPointerException e) {
+        expect(i > 0);
+      }
+
+      try {
+        expect(call(i == 0 ? new Base() : null, 1) == 1);
+        expect(i == 0);
+      } catch (NullPointerException e) {
+        expect(i > 0);
+      }
+    }
+  }
+
+  private static void races() throws Exception {
+    // several threads reach the same unquickened instructions at once:
+    final Fields shared = new Fields();
+    final boolean[] failed = new boolean[1];
+    Thread[] threads = new Thread[8];
+    for (int i = 0; i < threads.length; ++i) {
+      threads[i] = new Thread() {
+          public void run() {
+            for (int j = 0; j < 10000; ++j) {
+              Fields mine = new Fields();
+              fields(mine, j);
+              if (sum(mine) != j + (long) (j + 0.5f) + (((long) j) << 33)
+                  + (long) (j + 0.25) + (byte) j + (char) j + j) {
+                failed[0] = true;
+              }
+              shared.o = mine;
+              if (call(new Derived(), j) != j * 2) {
+                failed[0] = true;
+              }
+            }
+          }
+        };
+    }
+
+    for (int i = 0; i < threads.length; ++i) {
+      threads[i].start();
+    }
+
+    for (int i = 0; i < threads.length; ++i) {
+      threads[i].join();
+    }
+
+    expect(! failed[0]);
+  }
+
+  public static void main(String[] args) throws Exception {
+    races();
+
+    Fields x = new Fields();
+    for (int i = 0; i < 1000; ++i) {
+      fields(x, i);
+      statics();
+    }
+
+    calls();
+    nulls();
+  }
+}
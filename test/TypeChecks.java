@@ -0,0 +1,172 @@
+import java.lang.ref.Reference;
+import java.lang.ref.WeakReference;
+
+public class TypeChecks {
+  private static void expect(boolean v) {
+    if (! v) throw new RuntimeException();
+  }
+
+  private static class D0 { }
+  private static class D1 extends D0 { }
+  private static class D2 extends D1 { }
+  private static class D3 extends D2 { }
+  private static class D4 extends D3 { }
+  private static class D5 extends D4 { }
+  private static class D6 extends D5 { }
+  private static class D7 extends D6 { }
+  private static class D8 extends D7 { }
+  private static class D9 extends D8 { }
+  private static class D10 extends D9 { }
+  private static class D11 extends D10 { }
+  private static class D12 extends D11 { }
+
+  private static class E3 extends D2 { }
+  private static class E4 extends E3 { }
+
+  private static class MyIndexException
+    extends ArrayIndexOutOfBoundsException
+    implements Runnable, Comparable<Object>
+  {
+    public void run() { }
+    public int compareTo(Object o) { return 0; }
+  }
+
+  private static class Task implements Runnable {
+    public void run() { }
+  }
+
+  private static int depthOf(Object o) {
+    if (o instanceof D12) return 12;
+    if (o instanceof D11) return 11;
+    if (o instanceof D10) return 10;
+    if (o instanceof D9) return 9;
+    if (o instanceof D8) return 8;
+    if (o instanceof D7) return 7;
+    if (o instanceof D6) return 6;
+    if (o instanceof D5) return 5;
+    if (o instanceof D4) return 4;
+    if (o instanceof D3) return 3;
+    if (o instanceof D2) return 2;
+    if (o instanceof D1) return 1;
+    if (o instanceof D0) return 0;
+    return -1;
+  }
+
+  private static boolean castsToD7(Object o) {
+    try {
+      D7 d = (D7) o;
+      return true;
+    } catch (ClassCastException e) {
+      return false;
+    }
+  }
+
+  private static boolean castsToE3(Object o) {
+    try {
+      E3 e = (E3) o;
+      return true;
+    } catch (ClassCastException e) {
+      return false;
+    }
+  }
+
+  private static void deepHierarchy() {
+    Object[] objects = {
+      new D0(), new D1(), new D2(), new D3(), new D4(), new D5(), new D6(),
+      new D7(), new D8(), new D9(), new D10(), new D11(), new D12()
+    };
+
+    for (int i = 0; i < 10000; ++i) {
+      for (int j = 0; j < objects.length; ++j) {
+        expect(depthOf(objects[j]) == j);
+        expect(castsToD7(objects[j]) == (j >= 7));
+        expect(castsToE3(objects[j]) == false);
+      }
+
+      // a display entry at the right depth, but for a sibling:
+      expect(! (new E4() instanceof D4));
+      expect(! (new D4() instanceof E4));
+      expect(new E4() instanceof D2);
+      expect(castsToE3(new E4()));
+
+      // null passes any cast and is an instance of nothing:
+      expect(castsToD7(null));
+      expect(depthOf(null) == -1);
+
+      // classes and arrays with no display of their own:
+      expect(depthOf("foo") == -1);
+      expect(depthOf(new D12[0]) == -1);
+      expect(! castsToD7(new int[1]));
+    }
+  }
+
+  private static void bootstrapClasses() {
+    // these classes are known to the VM before their class files are
+    // loaded, so their displays are only filled in once they are:
+    Object e = new ArrayIndexOutOfBoundsException();
+    Object mine = new MyIndexException();
+    Object r = new WeakReference<Object>(e);
+
+    for (int i = 0; i < 10000; ++i) {
+      expect(e instanceof IndexOutOfBoundsException);
+      expect(e instanceof RuntimeException);
+      expect(e instanceof Throwable);
+      expect(! (e instanceof Error));
+      expect(((RuntimeException) e) == e);
+
+      expect(mine instanceof ArrayIndexOutOfBoundsException);
+      expect(mine instanceof Exception);
+      expect(! (mine instanceof NullPointerException));
+      expect(((IndexOutOfBoundsException) mine) == mine);
+
+      expect(r instanceof Reference);
+      expect(! (r instanceof Number));
+      expect(((Reference) r).get() == e);
+
+      Object n = Integer.valueOf(i);
+      expect(n instanceof Number);
+      expect(! (n instanceof Long));
+    }
+
+    try {
+      Object o = (NullPointerException) e;
+      expect(false);
+    } catch (ClassCastException expected) { }
+  }
+
+  private static int interfaces(Object o) {
+    int result = 0;
+    if (o instanceof Runnable) result |= 1;
+    if (o instanceof Comparable) result |= 2;
+    if (o instanceof CharSequence) result |= 4;
+    return result;
+  }
+
+  private static void interfaceCache() {
+    Object[] objects = {
+      new MyIndexException(), new Task(), "foo", Integer.valueOf(42),
+      new D3()
+    };
+    int[] expected = { 3, 1, 6, 2, 0 };
+
+    // alternate between interfaces so the cached one keeps changing:
+    for (int i = 0; i < 10000; ++i) {
+      for (int j = 0; j < objects.length; ++j) {
+        expect(interfaces(objects[j]) == expected[j]);
+      }
+      expect(((Runnable) objects[0]) == objects[0]);
+      expect(((Comparable) objects[0]) == objects[0]);
+    }
+
+    try {
+      Object o = (Runnable) objects[2];
+      expect(false);
+    } catch (ClassCastException e) { }
+  }
+
+  public static void main(String[] args) {
+    deepHierarchy();
+    bootstrapClasses();
+    interfaceCache();
+  }
+}
@@ -0,0 +1,134 @@
+package extra;
+
+// Times the instructions the interpreter rewrites to quick forms
+// (field access, statics of the executing class and invokevirtual),
+// along with a plain arithmetic loop as a baseline for dispatch cost.
+// Run it on an interpreter build (process=interpret) before and after
+// a change, e.g. from build/linux-x86_64-interpret:
+//
+//   ./avian -cp test extra.InterpreterBenchmark 5
+public class InterpreterBenchmark {
+  private static final int Iterations = 2000000;
+
+  private static int counter;
+  private static long total;
+
+  private static class Point {
+    public int x;
+    public int y;
+    public long weight;
+    public Point next;
+  }
+
+  private static class Shape {
+    public int area(int x) { return x; }
+  }
+
+  private static class Square extends Shape {
+    public int area(int x) { return x * x; }
+  }
+
+  private static class Circle extends Shape {
+    public int area(int x) { return 3 * x * x; }
+  }
+
+  private static int arithmetic(int n) {
+    int a = 0;
+    int b = 1;
+    for (int i = 0; i < n; ++i) {
+      int c = a + b;
+      a = b ^ i;
+      b = c & 0xFFFF;
+    }
+    return a + b;
+  }
+
+  private static int getFields(Point p, int n) {
+    int sum = 0;
+    for (int i = 0; i < n; ++i) {
+      sum += p.x + p.y + (int) p.weight;
+      p = p.next;
+    }
+    return sum;
+  }
+
+  private static void putFields(Point p, int n) {
+    for (int i = 0; i < n; ++i) {
+      p.x = i;
+      p.y = -i;
+      p.weight = i;
+      p.next = p;
+    }
+  }
+
+  private static long statics(int n) {
+    for (int i = 0; i < n; ++i) {
+      total += counter + i;
+    }
+    return total;
+  }
+
+  private static int monomorphicCalls(Shape s, int n) {
+    int sum = 0;
+    for (int i = 0; i < n; ++i) {
+      sum += s.area(i & 0xFF);
+    }
+    return sum;
+  }
+
+  private static int polymorphicCalls(Shape[] shapes, int n) {
+    int sum = 0;
+    for (int i = 0; i < n; ++i) {
+      sum += shapes[i % shapes.length].area(i & 0xFF);
+    }
+    return sum;
+  }
+
+  private static void report(String name, long start, int n) {
+    long elapsed = System.nanoTime() - start;
+    System.out.println
+      (name + ": " + (elapsed / n) + "." + ((elapsed * 10 / n) % 10)
+       + " ns per iteration");
+  }
+
+  public static void main(String[] args) {
+    int rounds = args.length > 0 ? Integer.parseInt(args[0]) : 3;
+
+    Point p = new Point();
+    p.next = p;
+    Shape[] shapes = { new Shape(), new Square(), new Circle() };
+    int sink = 0;
+
+    for (int r = 0; r < rounds; ++r) {
+      System.out.println("round " + r);
+
+      long start = System.nanoTime();
+      sink += arithmetic(Iterations);
+      report("  arithmetic", start, Iterations);
+
+      start = System.nanoTime();
+      sink += getFields(p, Iterations);
+      report("  getfield", start, Iterations);
+
+      start = System.nanoTime();
+      putFields(p, Iterations);
+      report("  putfield", start, Iterations);
+
+      start = System.nanoTime();
+      sink += (int) statics(Iterations);
+      report("  getstatic", start, Iterations);
+
+      start = System.nanoTime();
+      sink += monomorphicCalls(shapes[1], Iterations);
+      report("  invokevirtual (one class)", start, Iterations);
+
+      start = System.nanoTime();
+      sink += polymorphicCalls(shapes, Iterations);
+      report("  invokevirtual (three classes)", start, Iterations);
+    }
+
+    if (sink == 42) {
+      System.out.println();
+    }
+  }
+}
@@ -0,0 +1,100 @@
+package extra;
+
+// Times loops which keep more values live than there are registers, so
+// the register allocator must choose what to spill inside and outside
+// them.  To compare builds with and without LoopWeightedSpillCosts
+// (src/codegen/compiler/regalloc.h), run each with the JIT log enabled
+// and compare both the times printed and the size of the compiled
+// methods, e.g. from build/linux-x86_64:
+//
+//   ./avian -Davian.jit.log=jit.log -cp test extra.LoopSpillBenchmark 5
+//   grep LoopSpillBenchmark jit.log | awk -F'[, ]' \
+//     '{ s += strtonum($2) - strtonum($1) } END { print s " bytes" }'
+public class LoopSpillBenchmark {
+  private static final int Iterations = 1000000;
+
+  // eight accumulators live across an inner loop which itself needs
+  // several registers:
+  private static long nested(int[] data, int n) {
+    long a = 0, b = 1, c = 2, d = 3, e = 4, f = 5, g = 6, h = 7;
+    for (int i = 0; i < n; ++i) {
+      int x = 0;
+      for (int j = 0; j < data.length; ++j) {
+        x += data[j] * (j + i);
+      }
+      a += x; b ^= a; c += b >>> 3; d -= c;
+      e += d * 3; f ^= e; g += f >>> 5; h -= g;
+    }
+    return a + b + c + d + e + f + g + h;
+  }
+
+  // values used only after the loop, which are better spilled than
+  // the loop's own temporaries:
+  private static long afterLoop(int[] data, int n) {
+    long p = n, q = n * 2, r = n * 3, s = n * 4, t = n * 5;
+    long sum = 0;
+    for (int i = 0; i < n; ++i) {
+      int v = data[i % data.length];
+      int w = data[(i + 1) % data.length];
+      sum += (v * w) ^ (v + i) ^ (w - i);
+    }
+    return sum + p + q + r + s + t;
+  }
+
+  // a loop with several continue statements, i.e. several backward
+  // branches to the same header:
+  private static long continues(int[] data, int n) {
+    long sum = 0, odd = 0, big = 0, other = 0;
+    for (int i = 0; i < n; ++i) {
+      int v = data[i % data.length] + i;
+      if ((v & 1) != 0) {
+        odd += v;
+        continue;
+      }
+      if (v > 1000) {
+        big += v;
+        continue;
+      }
+      other += v;
+      sum += odd + big + other;
+    }
+    return sum;
+  }
+
+  private static void report(String name, long start, int n) {
+    long elapsed = System.nanoTime() - start;
+    System.out.println
+      (name + ": " + (elapsed / n) + "." + ((elapsed * 10 / n) % 10)
+       + " ns per iteration");
+  }
+
+  public static void main(String[] args) {
+    int rounds = args.length > 0 ? Integer.parseInt(args[0]) : 3;
+
+    int[] data = new int[16];
+    for (int i = 0; i < data.length; ++i) {
+      data[i] = i * 37 + 11;
+    }
+
+    long sink = 0;
+    for (int r = 0; r < rounds; ++r) {
+      System.out.println("round " + r);
+
+      long start = System.nanoTime();
+      sink += nested(data, Iterations / data.length);
+      report("  nested", start, Iterations / data.length);
+
+      start = System.nanoTime();
+      sink += afterLoop(data, Iterations);
+      report("  after loop", start, Iterations);
+
+      start = System.nanoTime();
+      sink += continues(data, Iterations);
+      report("  continues", start, Iterations);
+    }
+
+    if (sink == 42) {
+      System.out.println();
+    }
+  }
+}
@@ -0,0 +1,67 @@
+package extra;
+
+// Times throwing an exception through a chain of frames to a handler
+// at the bottom, for several stack depths.  Each intermediate frame
+// either has no handlers at all or has a try block which does not
+// cover the call, so the runtime must rule it out before moving on.
+// Prints the time per throw, e.g. from build/linux-x86_64:
+//
+//   ./avian -cp test extra.UnwindBenchmark 5
+public class UnwindBenchmark {
+  private static final int[] Depths = { 1, 10, 100, 1000 };
+  private static final int Throws = 20000;
+
+  private static final RuntimeException exception = new RuntimeException();
+
+  private static int plain(int depth) {
+    if (depth == 0) {
+      throw exception;
+    }
+    return plain(depth - 1) + 1;
+  }
+
+  private static int guarded(int depth) {
+    if (depth == 0) {
+      throw exception;
+    }
+
+    int result = guarded(depth - 1);
+
+    try {
+      result += Integer.parseInt("1");
+    } catch (NumberFormatException e) {
+      result = 0;
+    }
+
+    return result;
+  }
+
+  private static long measure(int depth, boolean withHandlers) {
+    long start = System.nanoTime();
+    for (int i = 0; i < Throws; ++i) {
+      try {
+        if (withHandlers) {
+          guarded(depth);
+        } else {
+          plain(depth);
+        }
+      } catch (RuntimeException e) { }
+    }
+    return (System.nanoTime() - start) / Throws;
+  }
+
+  public static void main(String[] args) {
+    int rounds = args.length > 0 ? Integer.parseInt(args[0]) : 3;
+
+    for (int r = 0; r < rounds; ++r) {
+      System.out.println("round " + r);
+
+      for (int i = 0; i < Depths.length; ++i) {
+        System.out.println
+          ("  depth " + Depths[i] + ": "
+           + measure(Depths[i], false) + " ns per throw without handlers, "
+           + measure(Depths[i], true) + " ns per throw with handlers");
+      }
+    }
+  }
+}
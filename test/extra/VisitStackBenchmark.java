@@ -0,0 +1,98 @@
+package extra;
+
+// Times full collections while other threads sit parked at the bottom
+// of deep stacks, so that the cost is dominated by visiting compiled
+// frames and finding each call site's map of live references.  Prints
+// the time per collection for each combination of thread count and
+// stack depth, e.g. from build/linux-x86_64:
+//
+//   ./avian -cp test extra.VisitStackBenchmark 5
+public class VisitStackBenchmark {
+  private static final int[] ThreadCounts = { 1, 4, 16 };
+  private static final int[] Depths = { 10, 100, 1000 };
+  private static final int Collections = 20;
+
+  private static final Object lock = new Object();
+  private static int ready;
+  private static boolean done;
+
+  // keeps a few references live across each call so the frames have
+  // nonempty maps to visit:
+  private static int recurse(int depth, Object a, Object b) {
+    if (depth == 0) {
+      synchronized (lock) {
+        ++ ready;
+        lock.notifyAll();
+        while (! done) {
+          try {
+            lock.wait();
+          } catch (InterruptedException e) { }
+        }
+      }
+      return 0;
+    } else {
+      Object c = new Object();
+      int result = recurse(depth - 1, b, c);
+      return result + (a == null ? 0 : 1) + (c.hashCode() & 1);
+    }
+  }
+
+  private static long measure(int threadCount, final int depth)
+    throws Exception
+  {
+    synchronized (lock) {
+      ready = 0;
+      done = false;
+    }
+
+    Thread[] threads = new Thread[threadCount];
+    for (int i = 0; i < threadCount; ++i) {
+      threads[i] = new Thread() {
+          public void run() {
+            recurse(depth, this, null);
+          }
+        };
+      threads[i].start();
+    }
+
+    synchronized (lock) {
+      while (ready < threadCount) {
+        lock.wait();
+      }
+    }
+
+    long start = System.nanoTime();
+    for (int i = 0; i < Collections; ++i) {
+      System.gc();
+    }
+    long elapsed = System.nanoTime() - start;
+
+    synchronized (lock) {
+      done = true;
+      lock.notifyAll();
+    }
+
+    for (int i = 0; i < threadCount; ++i) {
+      threads[i].join();
+    }
+
+    return elapsed / Collections;
+  }
+
+  public static void main(String[] args) throws Exception {
+    int rounds = args.length > 0 ? Integer.parseInt(args[0]) : 3;
+
+    for (int r = 0; r < rounds; ++r) {
+      System.out.println("round " + r);
+
+      for (int i = 0; i < ThreadCounts.length; ++i) {
+        for (int j = 0; j < Depths.length; ++j) {
+          long nanos = measure(ThreadCounts[i], Depths[j]);
+          System.out.println
+            ("  " + ThreadCounts[i] + " threads, depth " + Depths[j] + ": "
+             + (nanos / 1000) + " us per collection");
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,481 @@
+/* Copyright (c) 2008-2015, Avian Contributors
+
+   Permission to use, copy, modify, and/or distribute this software
+   for any purpose with or without fee is hereby granted, provided
+   that the above copyright notice and this permission notice appear
+   in all copies.
+
+   There is NO WARRANTY for this software.  See license.txt for
+   details. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "avian/common.h"
+#include <avian/heap/heap.h>
+#include <avian/system/system.h>
+
+#include "test-harness.h"
+
+using namespace vm;
+
+namespace {
+
+// A toy object model: the first word of each object points to a
+// statically allocated Type, the next Type::references words hold
+// references, and the last word holds an id which lets us check the
+// shape of the object graph after each collection.
+
+class Type {
+ public:
+  unsigned size;
+  unsigned references;
+};
+
+const Type Types[] = {{3, 1}, {5, 3}, {8, 2}, {130, 128}};
+const unsigned TypeCount = sizeof(Types) / sizeof(Type);
+
+const unsigned ChunkSizeInWords = 8 * 1024;
+const unsigned MaxChunks = 4096;
+const unsigned MaxObjects = 256 * 1024;
+const unsigned MaxReferences = 128;
+const unsigned RootCount = 64;
+
+class Graph : public Heap::Client {
+ public:
+  Graph(System* s, unsigned collectorThreads, bool compact)
+      : s(s),
+        heap(makeHeap(s, 256 * 1024 * 1024, collectorThreads, compact)),
+        chunkCount(0),
+        chunkIndex(ChunkSizeInWords),
+        footprint(0),
+        objectCount(0),
+        seed(42),
+        types(static_cast<unsigned*>(malloc(MaxObjects * sizeof(unsigned)))),
+        references(static_cast<int*>(
+            malloc(MaxObjects * MaxReferences * sizeof(int)))),
+        marks(static_cast<uint8_t*>(malloc(MaxObjects))),
+        reachable(static_cast<void**>(malloc(MaxObjects * sizeof(void*)))),
+        reachableCount(0)
+  {
+    heap->setClient(this);
+    memset(roots, 0, sizeof(roots));
+  }
+
+  ~Graph()
+  {
+    freeChunks();
+    heap->dispose();
+    free(types);
+    free(references);
+    free(marks);
+    free(reachable);
+  }
+
+  unsigned random(unsigned limit)
+  {
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 8) % limit;
+  }
+
+  static const Type* typeOf(void* o)
+  {
+    return static_cast<const Type*>(static_cast<void**>(o)[0]);
+  }
+
+  static unsigned idOf(void* o)
+  {
+    return static_cast<uintptr_t*>(o)[typeOf(o)->size - 1];
+  }
+
+  static void** referencesOf(void* o)
+  {
+    return static_cast<void**>(o) + 1;
+  }
+
+  void* make()
+  {
+    unsigned type = random(8) == 0 ? random(TypeCount) : random(TypeCount - 1);
+    unsigned size = Types[type].size;
+
+    if (chunkIndex + size > ChunkSizeInWords) {
+      expect(s, chunkCount < MaxChunks);
+      chunks[chunkCount++] = static_cast<uintptr_t*>(
+          heap->allocate(ChunkSizeInWords * BytesPerWord));
+      chunkIndex = 0;
+    }
+
+    uintptr_t* o = chunks[chunkCount - 1] + chunkIndex;
+    chunkIndex += size;
+    footprint += size;
+
+    expect(s, objectCount < MaxObjects);
+    unsigned id = objectCount++;
+
+    memset(o, 0, size * BytesPerWord);
+    o[0] = reinterpret_cast<uintptr_t>(Types + type);
+    o[size - 1] = id;
+
+    types[id] = type;
+    for (unsigned i = 0; i < MaxReferences; ++i) {
+      references[(id * MaxReferences) + i] = -1;
+    }
+
+    return o;
+  }
+
+  void set(void* o, unsigned index, void* value)
+  {
+    referencesOf(o)[index] = value;
+    references[(idOf(o) * MaxReferences) + index] = value ? idOf(value) : -1;
+    heap->mark(o, index + 1, 1);
+  }
+
+  void freeChunks()
+  {
+    for (unsigned i = 0; i < chunkCount; ++i) {
+      heap->free(chunks[i], ChunkSizeInWords * BytesPerWord);
+    }
+    chunkCount = 0;
+    chunkIndex = ChunkSizeInWords;
+    footprint = 0;
+  }
+
+  void collect(Heap::CollectionType type)
+  {
+    heap->collect(type, footprint, 0);
+    freeChunks();
+  }
+
+  // allocate some new objects, some garbage, and make existing
+  // objects point to them
+  void mutate(unsigned count)
+  {
+    for (unsigned i = 0; i < count; ++i) {
+      void* o = make();
+      unsigned n = typeOf(o)->references;
+      for (unsigned j = 0; j < n; ++j) {
+        if (reachableCount and random(2)) {
+          set(o, j, reachable[random(reachableCount)]);
+        }
+      }
+
+      if (random(4) == 0) {
+        roots[random(RootCount)] = o;
+      } else if (reachableCount and random(2)) {
+        void* target = reachable[random(reachableCount)];
+        set(target, random(typeOf(target)->references), o);
+      }
+    }
+  }
+
+  // walk the graph from the roots, checking each object against what
+  // we expect, and return whether everything matched
+  bool verify()
+  {
+    memset(marks, 0, objectCount);
+    reachableCount = 0;
+
+    bool ok = true;
+    for (unsigned i = 0; i < RootCount; ++i) {
+      if (roots[i] and not marks[idOf(roots[i])]) {
+        marks[idOf(roots[i])] = 1;
+        reachable[reachableCount++] = roots[i];
+      }
+    }
+
+    for (unsigned i = 0; i < reachableCount; ++i) {
+      void* o = reachable[i];
+      unsigned id = idOf(o);
+      if (id >= objectCount or typeOf(o) != Types + types[id]) {
+        return false;
+      }
+
+      for (unsigned j = 0; j < typeOf(o)->references; ++j) {
+        void* p = referencesOf(o)[j];
+        int expected = references[(id * MaxReferences) + j];
+        if (p == 0) {
+          ok = ok and expected == -1;
+        } else if (idOf(p) != static_cast<unsigned>(expected)) {
+          ok = false;
+        } else if (not marks[expected]) {
+          marks[expected] = 1;
+          reachable[reachableCount++] = p;
+        }
+      }
+    }
+
+    return ok;
+  }
+
+  virtual void collect(void*, Heap::CollectionType)
+  {
+    abort(s);
+  }
+
+  virtual void visitRoots(Heap::Visitor* v)
+  {
+    for (unsigned i = 0; i < RootCount; ++i) {
+      v->visit(roots + i);
+    }
+    heap->postVisit();
+  }
+
+  virtual bool isFixed(void*)
+  {
+    return false;
+  }
+
+  virtual unsigned sizeInWords(void* p)
+  {
+    return typeOf(heap->follow(maskAlignedPointer(p)))->size;
+  }
+
+  virtual unsigned copiedSizeInWords(void* p)
+  {
+    return sizeInWords(p);
+  }
+
+  virtual void copy(void* src, void* dst)
+  {
+    src = heap->follow(maskAlignedPointer(src));
+    memcpy(dst, src, typeOf(src)->size * BytesPerWord);
+  }
+
+  virtual void updateRoots(Heap::Visitor* v)
+  {
+    for (unsigned i = 0; i < RootCount; ++i) {
+      v->visit(roots + i);
+    }
+  }
+
+  virtual void move(void* src, void* dst, unsigned sizeInWords)
+  {
+    memmove(dst, src, sizeInWords * BytesPerWord);
+  }
+
+  virtual void walk(void* p, Heap::Walker* w)
+  {
+    void* o = heap->follow(maskAlignedPointer(p));
+    for (unsigned i = 0; i < typeOf(o)->references; ++i) {
+      if (not w->visit(i + 1)) {
+        break;
+      }
+    }
+  }
+
+  System* s;
+  Heap* heap;
+  uintptr_t* chunks[MaxChunks];
+  unsigned chunkCount;
+  unsigned chunkIndex;
+  unsigned footprint;
+  unsigned objectCount;
+  unsigned seed;
+  unsigned* types;
+  int* references;
+  uint8_t* marks;
+  void** reachable;
+  unsigned reachableCount;
+  void* roots[RootCount];
+};
+
+bool exercise(System* s, unsigned collectorThreads, bool compact = false)
+{
+  Graph g(s, collectorThreads, compact);
+
+  bool ok = true;
+  for (unsigned i = 0; i < 24 and ok; ++i) {
+    g.mutate(4000);
+    ok = g.verify();
+
+    g.collect(i % 6 == 5 ? Heap::MajorCollection : Heap::MinorCollection);
+    ok = ok and g.verify();
+  }
+
+  return ok and g.heap->collectionCount() == 24
+         and g.heap->pauseTime(50) <= g.heap->pauseTime(99)
+         and g.heap->pauseTime(99) <= g.heap->pauseTime(100);
+}
+
+// A client whose objects are all fixed: each has a header word, one
+// reference, and an id.
+class FixedGraph : public Heap::Client {
+ public:
+  static const unsigned Size = 3;
+
+  FixedGraph(System* s)
+      : s(s), heap(makeHeap(s, 256 * 1024 * 1024)), objectCount(0), seed(42)
+  {
+    heap->setClient(this);
+    memset(roots, 0, sizeof(roots));
+  }
+
+  ~FixedGraph()
+  {
+    heap->disposeFixies();
+    heap->dispose();
+  }
+
+  unsigned random(unsigned limit)
+  {
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 8) % limit;
+  }
+
+  void* make(void* next)
+  {
+    uintptr_t* o
+        = static_cast<uintptr_t*>(heap->allocateFixed(heap, Size, true));
+    o[0] = 0;
+    o[1] = reinterpret_cast<uintptr_t>(next);
+    o[2] = objectCount++;
+    return o;
+  }
+
+  // allocate a batch of chains, some of which we keep in roots
+  void mutate(unsigned count)
+  {
+    void* previous = 0;
+    for (unsigned i = 0; i < count; ++i) {
+      void* o = make(random(4) ? previous : 0);
+      if (random(64) == 0) {
+        roots[random(RootCount)] = o;
+      }
+      previous = o;
+    }
+  }
+
+  // check that every id is smaller than the one before it along each
+  // chain, which catches both reused and overwritten objects
+  bool verify()
+  {
+    for (unsigned i = 0; i < RootCount; ++i) {
+      for (uintptr_t* o = static_cast<uintptr_t*>(roots[i]); o;
+           o = reinterpret_cast<uintptr_t*>(o[1])) {
+        uintptr_t* next = reinterpret_cast<uintptr_t*>(o[1]);
+        if (o[2] >= objectCount or (next and next[2] >= o[2])) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  unsigned footprint()
+  {
+    return heap->limit() - heap->remaining();
+  }
+
+  virtual void collect(void*, Heap::CollectionType)
+  {
+    abort(s);
+  }
+
+  virtual void visitRoots(Heap::Visitor* v)
+  {
+    for (unsigned i = 0; i < RootCount; ++i) {
+      v->visit(roots + i);
+    }
+    heap->postVisit();
+  }
+
+  virtual void updateRoots(Heap::Visitor* v)
+  {
+    for (unsigned i = 0; i < RootCount; ++i) {
+      v->visit(roots + i);
+    }
+  }
+
+  virtual bool isFixed(void*)
+  {
+    return true;
+  }
+
+  virtual unsigned sizeInWords(void*)
+  {
+    return Size;
+  }
+
+  virtual unsigned copiedSizeInWords(void*)
+  {
+    return Size;
+  }
+
+  virtual void copy(void*, void*)
+  {
+    abort(s);
+  }
+
+  virtual void move(void*, void*, unsigned)
+  {
+    abort(s);
+  }
+
+  virtual void walk(void*, Heap::Walker* w)
+  {
+    w->visit(1);
+  }
+
+  System* s;
+  Heap* heap;
+  unsigned objectCount;
+  unsigned seed;
+  void* roots[RootCount];
+};
+
+}  // namespace
+
+TEST(SerialCollection)
+{
+  System* s = makeSystem();
+  assertTrue(exercise(s, 1));
+  s->dispose();
+}
+
+TEST(ParallelCollection)
+{
+  System* s = makeSystem();
+  assertTrue(exercise(s, 4));
+  s->dispose();
+}
+
+TEST(CompactingCollection)
+{
+  System* s = makeSystem();
+  assertTrue(exercise(s, 1, true));
+  s->dispose();
+}
+
+TEST(FixedAllocation)
+{
+  System* s = makeSystem();
+
+  {
+    FixedGraph g(s);
+
+    bool ok = true;
+    unsigned footprint = 0;
+    for (unsigned i = 0; i < 12 and ok; ++i) {
+      g.mutate(4000);
+      g.heap->collect(
+          i % 3 == 2 ? Heap::MajorCollection : Heap::MinorCollection, 0, 0);
+      ok = g.verify();
+
+      if (i % 3 == 2) {
+        // the space used by fixies which died since the last major
+        // collection should have been reused or released:
+        if (footprint) {
+          ok = ok and g.footprint() <= footprint;
+        } else {
+          footprint = g.footprint();
+        }
+      }
+    }
+
+    assertTrue(ok);
+  }
+
+  s->dispose();
+}